@@ -5,6 +5,9 @@
 [ORG 0x7C00]
 
 KERNEL_OFFSET equ 0x1000     ; Memory offset where we'll load the kernel
+INITRD_SEGMENT equ 0x4000    ; Initramfs load segment (physical 0x40000)
+INITRD_MAX_SECTORS equ 512   ; Initramfs size limit (256KB, up to 0x80000)
+BOOT_INFO     equ 0x0500     ; Boot info handed to the kernel (initrd size)
 
 ; BIOS sets boot drive in dl
 mov [BOOT_DRIVE], dl
@@ -20,6 +23,9 @@ call print_string
 ; Load kernel from disk
 call load_kernel
 
+; Load initramfs archive (if one was appended to the image)
+call load_initrd
+
 ; Switch to 32-bit protected mode
 call switch_to_pm
 
@@ -78,6 +84,68 @@ disk_load:
     popa
     ret
 
+; ============================================
+; Load initramfs from disk (INT 13h extensions)
+; ============================================
+load_initrd:
+    mov dword [BOOT_INFO], 0 ; No initramfs unless fully loaded
+
+    mov cx, [INITRD_SECTORS] ; Patched in by tools/mkinitrd.sh
+    test cx, cx
+    jz .done
+    cmp cx, INITRD_MAX_SECTORS
+    ja .done
+
+    mov si, MSG_LOAD_INITRD
+    call print_string
+
+    mov word [dap_segment], INITRD_SEGMENT
+    mov eax, [INITRD_LBA]
+    mov [dap_lba], eax
+
+.next_chunk:
+    mov ax, cx               ; Read at most 64 sectors (32KB) per call
+    cmp ax, 64
+    jbe .read
+    mov ax, 64
+.read:
+    mov [dap_count], ax
+    push cx
+    mov si, dap
+    mov ah, 0x42             ; BIOS extended read
+    mov dl, [BOOT_DRIVE]
+    int 0x13
+    pop cx
+    jc .error
+
+    mov ax, [dap_count]
+    sub cx, ax
+    movzx eax, ax
+    add [dap_lba], eax
+    shl ax, 5                ; Sectors to paragraphs (512 / 16)
+    add [dap_segment], ax
+    test cx, cx
+    jnz .next_chunk
+
+    movzx eax, word [INITRD_SECTORS]
+    shl eax, 9               ; Sectors to bytes
+    mov [BOOT_INFO], eax
+.done:
+    ret
+
+.error:
+    mov si, MSG_INITRD_ERROR ; Not fatal: boot with an empty filesystem
+    call print_string
+    ret
+
+; Disk address packet for INT 13h AH=42h
+dap:
+    db 0x10, 0               ; Packet size, reserved
+dap_count:   dw 0            ; Sectors to read
+dap_offset:  dw 0            ; Destination offset
+dap_segment: dw 0            ; Destination segment
+dap_lba:     dd 0, 0         ; Starting LBA (64-bit)
+
 disk_error:
     mov si, MSG_DISK_ERROR
     call print_string
@@ -164,9 +232,16 @@ MSG_BOOT:         db "NightOS Bootloader v0.1", 13, 10, 0
 MSG_LOAD_KERNEL:  db "Loading kernel...", 13, 10, 0
 MSG_DISK_ERROR:   db "Disk read error!", 0
 MSG_SECTORS_ERROR: db "Sector count error!", 0
+MSG_LOAD_INITRD:  db "Loading initramfs...", 13, 10, 0
+MSG_INITRD_ERROR: db "Initramfs read error!", 13, 10, 0
 
 ; ============================================
 ; Boot sector padding and signature
 ; ============================================
-times 510-($-$$) db 0
+times 504-($-$$) db 0
+
+; Initramfs location, patched by tools/mkinitrd.sh (offsets 504 and 508)
+INITRD_LBA:       dd 0
+INITRD_SECTORS:   dw 0
+
 dw 0xAA55
@@ -84,6 +84,9 @@ if [ $REMAINDER -ne 0 ]; then
     dd if=/dev/zero bs=1 count=$PADDING >> $BUILD_DIR/nightos.img 2>/dev/null
 fi
 
+echo "Packing initramfs..."
+sh tools/mkinitrd.sh $BUILD_DIR/nightos.img initrd
+
 echo
 echo -e "${GREEN}============================================${NC}"
 echo -e "${GREEN} Build successful!${NC}"
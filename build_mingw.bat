@@ -65,6 +65,30 @@ if %ERRORLEVEL% neq 0 (
     exit /b 1
 )
 
+%ASM% -f elf32 -DMINGW %KERNEL_DIR%\switch.asm -o %BUILD_DIR%\switch.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Context switch assembly failed!
+    exit /b 1
+)
+
+%ASM% -f elf32 -DMINGW %KERNEL_DIR%\usercode.asm -o %BUILD_DIR%\usercode.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Built-in program assembly failed!
+    exit /b 1
+)
+
+%ASM% -f elf32 -DMINGW %KERNEL_DIR%\uaccess.asm -o %BUILD_DIR%\uaccess_asm.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: User access assembly failed!
+    exit /b 1
+)
+
+%ASM% -f elf32 -DMINGW %KERNEL_DIR%\ap_boot.asm -o %BUILD_DIR%\ap_boot.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: AP start-up assembly failed!
+    exit /b 1
+)
+
 echo [4/9] Compiling kernel...
 %CC% %CFLAGS% %KERNEL_DIR%\kernel.c -o %BUILD_DIR%\kernel.o
 if %ERRORLEVEL% neq 0 (
@@ -108,6 +132,102 @@ if %ERRORLEVEL% neq 0 (
     exit /b 1
 )
 
+%CC% %CFLAGS% %KERNEL_DIR%\ioring.c -o %BUILD_DIR%\ioring.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: I/O ring compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\futex.c -o %BUILD_DIR%\futex.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Futex compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\fpu.c -o %BUILD_DIR%\fpu.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: FPU compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\workqueue.c -o %BUILD_DIR%\workqueue.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Work queue compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\fat32.c -o %BUILD_DIR%\fat32.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: FAT32 compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\gdt.c -o %BUILD_DIR%\gdt.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: GDT compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\paging.c -o %BUILD_DIR%\paging.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Paging compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\stackpool.c -o %BUILD_DIR%\stackpool.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Stack pool compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\vmm.c -o %BUILD_DIR%\vmm.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Virtual memory compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\elf.c -o %BUILD_DIR%\elf.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: ELF loader compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\exec.c -o %BUILD_DIR%\exec.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Exec compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\vdso.c -o %BUILD_DIR%\vdso.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: vDSO compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\uaccess.c -o %BUILD_DIR%\uaccess.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: User access compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\pipe.c -o %BUILD_DIR%\pipe.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Pipe compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\shm.c -o %BUILD_DIR%\shm.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Shared memory compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %KERNEL_DIR%\smp.c -o %BUILD_DIR%\smp.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: SMP compilation failed!
+    exit /b 1
+)
+
 echo [5/9] Compiling drivers...
 %CC% %CFLAGS% %DRIVERS_DIR%\vga.c -o %BUILD_DIR%\vga.o
 if %ERRORLEVEL% neq 0 (
@@ -139,6 +259,18 @@ if %ERRORLEVEL% neq 0 (
     exit /b 1
 )
 
+%CC% %CFLAGS% %DRIVERS_DIR%\ata.c -o %BUILD_DIR%\ata.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: ATA driver compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %DRIVERS_DIR%\apic.c -o %BUILD_DIR%\apic.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Local APIC compilation failed!
+    exit /b 1
+)
+
 echo [6/9] Compiling libraries...
 %CC% %CFLAGS% %LIB_DIR%\string.c -o %BUILD_DIR%\string.o
 if %ERRORLEVEL% neq 0 (
@@ -158,8 +290,24 @@ if %ERRORLEVEL% neq 0 (
     exit /b 1
 )
 
+%CC% %CFLAGS% %LIB_DIR%\sync.c -o %BUILD_DIR%\sync.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Sync compilation failed!
+    exit /b 1
+)
+
+%CC% %CFLAGS% %LIB_DIR%\rbtree.c -o %BUILD_DIR%\rbtree.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Red-black tree compilation failed!
+    exit /b 1
+)
+
 echo [7/9] Linking kernel...
-%LD% -m i386pe -e _start -Ttext 0x1000 -o %BUILD_DIR%\kernel.pe %BUILD_DIR%\kernel_entry.o %BUILD_DIR%\isr.o %BUILD_DIR%\kernel.o %BUILD_DIR%\shell.o %BUILD_DIR%\idt.o %BUILD_DIR%\fs.o %BUILD_DIR%\process.o %BUILD_DIR%\syscall.o %BUILD_DIR%\gui.o %BUILD_DIR%\vga.o %BUILD_DIR%\keyboard.o %BUILD_DIR%\pic.o %BUILD_DIR%\timer.o %BUILD_DIR%\rtc.o %BUILD_DIR%\string.o %BUILD_DIR%\memory.o %BUILD_DIR%\tui.o 2>nul
+%LD% -m i386pe -e _start -Ttext 0x1000 -o %BUILD_DIR%\kernel.pe %BUILD_DIR%\kernel_entry.o %BUILD_DIR%\isr.o %BUILD_DIR%\switch.o %BUILD_DIR%\ap_boot.o %BUILD_DIR%\usercode.o %BUILD_DIR%\uaccess_asm.o %BUILD_DIR%\kernel.o %BUILD_DIR%\shell.o %BUILD_DIR%\idt.o %BUILD_DIR%\fs.o %BUILD_DIR%\process.o %BUILD_DIR%\syscall.o %BUILD_DIR%\gui.o %BUILD_DIR%\ioring.o %BUILD_DIR%\futex.o %BUILD_DIR%\fpu.o %BUILD_DIR%\workqueue.o %BUILD_DIR%\fat32.o %BUILD_DIR%\gdt.o %BUILD_DIR%\paging.o %BUILD_DIR%\stackpool.o %BUILD_DIR%\vmm.o %BUILD_DIR%\elf.o %BUILD_DIR%\exec.o %BUILD_DIR%\vdso.o %BUILD_DIR%\uaccess.o %BUILD_DIR%\pipe.o %BUILD_DIR%\shm.o %BUILD_DIR%\smp.o %BUILD_DIR%\vga.o %BUILD_DIR%\keyboard.o %BUILD_DIR%\pic.o %BUILD_DIR%\timer.o %BUILD_DIR%\rtc.o %BUILD_DIR%\ata.o %BUILD_DIR%\apic.o %BUILD_DIR%\string.o %BUILD_DIR%\memory.o %BUILD_DIR%\tui.o %BUILD_DIR%\sync.o %BUILD_DIR%\rbtree.o
+if %ERRORLEVEL% neq 0 (
+    echo ERROR: Kernel link failed!
+    exit /b 1
+)
 
 REM Convert PE to raw binary
 echo [8/9] Converting to binary format...
@@ -176,6 +324,22 @@ if %ERRORLEVEL% neq 0 (
     exit /b 1
 )
 
+REM Append the initramfs and patch its location into the boot sector
+REM (tools\mkinitrd.sh needs sh and tar, as shipped with MSYS/Git for Windows)
+if exist initrd (
+    where sh >nul 2>&1
+    if !ERRORLEVEL! neq 0 (
+        echo ERROR: sh not found; it is needed to pack initrd\ into the image
+        exit /b 1
+    )
+    echo Packing initramfs...
+    sh tools/mkinitrd.sh %BUILD_DIR%/nightos.img initrd
+    if !ERRORLEVEL! neq 0 (
+        echo ERROR: Initramfs packing failed!
+        exit /b 1
+    )
+)
+
 echo.
 echo ============================================
 echo  Build successful!
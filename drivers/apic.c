@@ -0,0 +1,112 @@
+/*
+ * NightOS - Local APIC Implementation
+ * 
+ * The 8259 PIC keeps delivering legacy IRQs to the bootstrap CPU;
+ * the local APIC is used for IPIs during SMP bring-up and for the
+ * periodic timer on every other CPU.
+ */
+
+#include "../include/apic.h"
+#include "../include/io.h"
+#include "../include/timer.h"
+
+/* MMIO window shared by every CPU (each sees its own APIC there) */
+static volatile uint32_t* lapic_base = NULL;
+
+/* ========== Register Access ========== */
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic_base[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic_base[reg / 4] = value;
+    (void)lapic_base[LAPIC_ID / 4];     /* Read back to post the write */
+}
+
+/* Send an IPI and wait for the APIC to accept it */
+static void lapic_send_ipi(uint32_t apic_id, uint32_t command) {
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile("pause");
+    }
+}
+
+/* ========== Public Interface ========== */
+
+/* Map the APIC (base from ACPI, 0 for the MSR value) and enable it on this CPU */
+void lapic_init(uint32_t base) {
+    if (!lapic_base) {
+        if (!base) {
+            base = (uint32_t)rdmsr(MSR_APIC_BASE) & APIC_BASE_ADDR_MASK;
+        }
+        lapic_base = (volatile uint32_t*)(base ? base : APIC_DEFAULT_BASE);
+    }
+    
+    /* Globally enable, then software-enable with the spurious vector */
+    wrmsr(MSR_APIC_BASE, rdmsr(MSR_APIC_BASE) | APIC_BASE_ENABLE);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+}
+
+/* True once lapic_init found an APIC */
+bool lapic_present(void) {
+    return lapic_base != NULL;
+}
+
+/* APIC ID of the calling CPU */
+uint32_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+/* Acknowledge the interrupt being serviced */
+void lapic_eoi(void) {
+    lapic_base[LAPIC_EOI / 4] = 0;
+}
+
+/* Put an application processor into wait-for-SIPI */
+void lapic_send_init(uint32_t apic_id) {
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL);
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+}
+
+/* Start an AP in real mode at vector_page * 4KB */
+void lapic_send_startup(uint32_t apic_id, uint8_t vector_page) {
+    lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | vector_page);
+}
+
+/* Measure the APIC timer against the PIT; returns counts per PIT tick */
+uint32_t lapic_timer_calibrate(void) {
+    const uint32_t sample_ticks = 10;
+    
+    /* Start on a tick boundary */
+    uint32_t start = timer_get_ticks();
+    while (timer_get_ticks() == start) {
+        __asm__ volatile("pause");
+    }
+    
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+    
+    start = timer_get_ticks();
+    while (timer_get_ticks() - start < sample_ticks) {
+        __asm__ volatile("pause");
+    }
+    
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+    
+    return elapsed / sample_ticks;
+}
+
+/* Run the APIC timer periodically at counts per interrupt */
+void lapic_timer_start(uint32_t counts) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INITIAL, counts);
+}
@@ -0,0 +1,149 @@
+/*
+ * NightOS - ATA Disk Driver Implementation
+ * 
+ * Polled PIO transfers on the primary IDE channel (LBA28)
+ */
+
+#include "../include/ata.h"
+#include "../include/io.h"
+
+/* Drive information from IDENTIFY */
+static bool drive_present[2] = {false, false};
+static uint32_t drive_sectors[2] = {0, 0};
+
+/* 400ns delay: four reads of the alternate status register */
+static void ata_delay(void) {
+    for (int i = 0; i < 4; i++) {
+        inb(ATA_PRIMARY_CTRL);
+    }
+}
+
+/* Wait until BSY clears; returns final status */
+static uint8_t ata_wait_ready(void) {
+    uint8_t status;
+    uint32_t timeout = 1000000;
+    
+    do {
+        status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    } while ((status & ATA_SR_BSY) && --timeout);
+    
+    return status;
+}
+
+/* Wait for DRQ (data ready); returns 0 or negative on error */
+static int ata_wait_drq(void) {
+    uint8_t status = ata_wait_ready();
+    
+    if (status & (ATA_SR_ERR | ATA_SR_DF)) return -1;
+    if (!(status & ATA_SR_DRQ)) return -2;
+    return 0;
+}
+
+/* Select drive and program LBA/sector count */
+static void ata_setup(uint8_t drive, uint32_t lba, uint8_t count) {
+    outb(ATA_PRIMARY_IO + ATA_REG_DRIVE, 0xE0 | (drive << 4) | ((lba >> 24) & 0x0F));
+    ata_delay();
+    outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT, count);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA0, (uint8_t)lba);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA1, (uint8_t)(lba >> 8));
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA2, (uint8_t)(lba >> 16));
+}
+
+/* Send IDENTIFY to a drive */
+static void ata_identify(uint8_t drive) {
+    uint16_t id[256];
+    
+    outb(ATA_PRIMARY_IO + ATA_REG_DRIVE, 0xA0 | (drive << 4));
+    ata_delay();
+    outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA0, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA1, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA2, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    
+    uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    if (status == 0 || status == 0xFF) return;  /* No drive */
+    
+    ata_wait_ready();
+    
+    /* ATAPI and SATA devices set the signature bytes; skip them */
+    if (inb(ATA_PRIMARY_IO + ATA_REG_LBA1) || inb(ATA_PRIMARY_IO + ATA_REG_LBA2)) return;
+    
+    if (ata_wait_drq() < 0) return;
+    
+    for (int i = 0; i < 256; i++) {
+        id[i] = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
+    }
+    
+    drive_present[drive] = true;
+    drive_sectors[drive] = id[60] | ((uint32_t)id[61] << 16);  /* LBA28 sectors */
+}
+
+/* Probe drives on the primary channel */
+void ata_init(void) {
+    /* Polled I/O only: disable drive interrupts (nIEN) */
+    outb(ATA_PRIMARY_CTRL, 0x02);
+    
+    ata_identify(ATA_DRIVE_MASTER);
+    ata_identify(ATA_DRIVE_SLAVE);
+}
+
+/* Check if a drive answered IDENTIFY */
+bool ata_present(uint8_t drive) {
+    return drive < 2 && drive_present[drive];
+}
+
+/* Get drive size in sectors */
+uint32_t ata_sectors(uint8_t drive) {
+    return ata_present(drive) ? drive_sectors[drive] : 0;
+}
+
+/* Read sectors */
+int ata_read_sectors(uint8_t drive, uint32_t lba, uint8_t count, void* buffer) {
+    if (!ata_present(drive)) return -1;
+    
+    uint16_t* buf = (uint16_t*)buffer;
+    int sectors = count ? count : 256;
+    
+    ata_wait_ready();
+    ata_setup(drive, lba, count);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_READ_PIO);
+    
+    for (int s = 0; s < sectors; s++) {
+        ata_delay();
+        if (ata_wait_drq() < 0) return -2;
+        
+        for (int i = 0; i < ATA_SECTOR_SIZE / 2; i++) {
+            *buf++ = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
+        }
+    }
+    
+    return 0;
+}
+
+/* Write sectors */
+int ata_write_sectors(uint8_t drive, uint32_t lba, uint8_t count, const void* buffer) {
+    if (!ata_present(drive)) return -1;
+    
+    const uint16_t* buf = (const uint16_t*)buffer;
+    int sectors = count ? count : 256;
+    
+    ata_wait_ready();
+    ata_setup(drive, lba, count);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_WRITE_PIO);
+    
+    for (int s = 0; s < sectors; s++) {
+        ata_delay();
+        if (ata_wait_drq() < 0) return -2;
+        
+        for (int i = 0; i < ATA_SECTOR_SIZE / 2; i++) {
+            outw(ATA_PRIMARY_IO + ATA_REG_DATA, *buf++);
+        }
+    }
+    
+    /* Make sure the data reaches the disk */
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_CACHE_FLUSH);
+    ata_wait_ready();
+    
+    return 0;
+}
@@ -1,11 +1,16 @@
 /*
  * NightOS - Keyboard Driver Implementation
  * 
- * PS/2 keyboard driver with scan code set 1 translation
+ * PS/2 keyboard driver with scan code set 1 translation. IRQ1 queues
+ * scancodes in a ring and wakes readers, which sleep while it is empty.
  */
 
 #include "../include/keyboard.h"
+#include "../include/config.h"
+#include "../include/idt.h"
 #include "../include/io.h"
+#include "../include/sync.h"
+#include "../include/wait.h"
 
 /* US keyboard layout - lowercase */
 static const char scancode_to_char[] = {
@@ -37,6 +42,43 @@ static const char scancode_to_char_shift[] = {
 /* Current key state */
 static key_state_t key_state = {false, false, false, false};
 
+/* Scancodes received but not yet read; full when head + 1 == tail */
+static uint8_t scancode_buffer[KEYBOARD_BUFFER_SIZE];
+static volatile uint32_t buffer_head = 0;
+static volatile uint32_t buffer_tail = 0;
+static spinlock_t buffer_lock;
+
+/* Readers sleeping for a key */
+static wait_queue_t keyboard_wait;
+
+/* IRQ1: queue the scancode (dropped if the buffer is full) and wake readers */
+static void keyboard_callback(registers_t* regs) {
+    UNUSED(regs);
+    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+    
+    spin_lock(&buffer_lock);
+    uint32_t next = (buffer_head + 1) % KEYBOARD_BUFFER_SIZE;
+    if (next != buffer_tail) {
+        scancode_buffer[buffer_head] = scancode;
+        buffer_head = next;
+    }
+    spin_unlock(&buffer_lock);
+    
+    wake_up(&keyboard_wait);
+}
+
+/* Take the oldest queued scancode, if any */
+static bool buffer_pop(uint8_t* scancode) {
+    uint32_t flags = spin_lock_irqsave(&buffer_lock);
+    bool found = buffer_tail != buffer_head;
+    if (found) {
+        *scancode = scancode_buffer[buffer_tail];
+        buffer_tail = (buffer_tail + 1) % KEYBOARD_BUFFER_SIZE;
+    }
+    spin_unlock_irqrestore(&buffer_lock, flags);
+    return found;
+}
+
 /* Initialize keyboard driver */
 void keyboard_init(void) {
     /* Clear keyboard buffer */
@@ -48,17 +90,22 @@ void keyboard_init(void) {
     key_state.ctrl = false;
     key_state.alt = false;
     key_state.caps_lock = false;
+    
+    spin_lock_init(&buffer_lock, "keyboard");
+    wait_queue_init(&keyboard_wait);
+    register_interrupt_handler(IRQ1, keyboard_callback);
 }
 
-/* Read raw scancode */
+/* Read raw scancode, sleeping until one arrives */
 uint8_t keyboard_read_scancode(void) {
-    while (!(inb(KEYBOARD_STATUS_PORT) & 0x01));
-    return inb(KEYBOARD_DATA_PORT);
+    uint8_t scancode;
+    wait_event(keyboard_wait, buffer_pop(&scancode));
+    return scancode;
 }
 
 /* Check if key is available */
 bool keyboard_has_key(void) {
-    return (inb(KEYBOARD_STATUS_PORT) & 0x01) != 0;
+    return buffer_tail != buffer_head;
 }
 
 /* Get current key state */
@@ -129,9 +176,9 @@ char keyboard_getchar(void) {
 
 /* Get character (non-blocking) */
 char keyboard_getchar_nonblock(void) {
-    if (!keyboard_has_key()) {
+    uint8_t scancode;
+    if (!buffer_pop(&scancode)) {
         return 0;
     }
-    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
     return process_scancode(scancode);
 }
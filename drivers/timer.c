@@ -8,6 +8,8 @@
 #include "../include/idt.h"
 #include "../include/io.h"
 #include "../include/vga.h"
+#include "../include/process.h"
+#include "../include/workqueue.h"
 
 /* Global tick counter */
 static volatile uint32_t timer_ticks = 0;
@@ -17,6 +19,12 @@ static uint32_t timer_freq = TIMER_FREQUENCY;
 static void timer_callback(registers_t* regs) {
     UNUSED(regs);
     timer_ticks++;
+    
+    /* Release delayed work whose time has come */
+    workqueue_tick(timer_ticks);
+    
+    /* May switch to another process before returning */
+    scheduler_tick();
 }
 
 /* Initialize the PIT */
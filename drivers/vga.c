@@ -192,7 +192,7 @@ void vga_puts_color(const char* str, uint8_t color) {
     }
 }
 
-/* Simple printf implementation */
+/* Simple printf implementation: %d %i %u %x %s %c, with width and '-' or '0' */
 void vga_printf(const char* format, ...) {
     char buffer[32];
     __builtin_va_list args;
@@ -201,43 +201,56 @@ void vga_printf(const char* format, ...) {
     while (*format) {
         if (*format == '%') {
             format++;
+            
+            bool left = false;
+            char pad = ' ';
+            int width = 0;
+            for (; *format == '-' || *format == '0'; format++) {
+                if (*format == '-') left = true; else pad = '0';
+            }
+            while (*format >= '0' && *format <= '9') {
+                width = width * 10 + (*format++ - '0');
+            }
+            if (!*format) break;
+            
+            const char* out = buffer;
             switch (*format) {
                 case 'd':
-                case 'i': {
-                    int val = __builtin_va_arg(args, int);
-                    itoa(val, buffer, 10);
-                    vga_puts(buffer);
+                case 'i':
+                    itoa(__builtin_va_arg(args, int), buffer, 10);
                     break;
-                }
-                case 'u': {
-                    uint32_t val = __builtin_va_arg(args, uint32_t);
-                    utoa(val, buffer, 10);
-                    vga_puts(buffer);
+                case 'u':
+                    utoa(__builtin_va_arg(args, uint32_t), buffer, 10);
                     break;
-                }
-                case 'x': {
-                    uint32_t val = __builtin_va_arg(args, uint32_t);
-                    utoa(val, buffer, 16);
-                    vga_puts(buffer);
+                case 'x':
+                    utoa(__builtin_va_arg(args, uint32_t), buffer, 16);
                     break;
-                }
-                case 's': {
-                    char* str = __builtin_va_arg(args, char*);
-                    vga_puts(str ? str : "(null)");
+                case 's':
+                    out = __builtin_va_arg(args, char*);
+                    if (!out) out = "(null)";
                     break;
-                }
-                case 'c': {
-                    char c = (char)__builtin_va_arg(args, int);
-                    vga_putchar(c);
+                case 'c':
+                    buffer[0] = (char)__builtin_va_arg(args, int);
+                    buffer[1] = '\0';
                     break;
-                }
                 case '%':
-                    vga_putchar('%');
+                    buffer[0] = '%';
+                    buffer[1] = '\0';
                     break;
                 default:
                     vga_putchar('%');
                     vga_putchar(*format);
-                    break;
+                    format++;
+                    continue;
+            }
+            
+            int len = (int)strlen(out);
+            if (!left) {
+                for (int i = len; i < width; i++) vga_putchar(pad);
+            }
+            vga_puts(out);
+            if (left) {
+                for (int i = len; i < width; i++) vga_putchar(' ');
             }
         } else {
             vga_putchar(*format);
@@ -0,0 +1,74 @@
+/*
+ * NightOS - Local APIC
+ * 
+ * Per-CPU interrupt controller: EOI, inter-processor interrupts
+ * and the timer that drives scheduling on application processors
+ */
+
+#ifndef APIC_H
+#define APIC_H
+
+#include "types.h"
+
+/* IA32_APIC_BASE MSR */
+#define MSR_APIC_BASE           0x1B
+#define APIC_BASE_ENABLE        0x800
+#define APIC_BASE_ADDR_MASK     0xFFFFF000
+#define APIC_DEFAULT_BASE       0xFEE00000
+
+/* Register offsets from the APIC base */
+#define LAPIC_ID                0x020
+#define LAPIC_VERSION           0x030
+#define LAPIC_TPR               0x080   /* Task priority */
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0   /* Spurious interrupt vector */
+#define LAPIC_ESR               0x280   /* Error status */
+#define LAPIC_ICR_LOW           0x300   /* Interrupt command */
+#define LAPIC_ICR_HIGH          0x310
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_TIMER_INITIAL     0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+
+/* SVR bits */
+#define LAPIC_SVR_ENABLE        0x100
+
+/* ICR delivery modes and flags */
+#define LAPIC_ICR_INIT          0x00000500
+#define LAPIC_ICR_STARTUP       0x00000600
+#define LAPIC_ICR_PENDING       0x00001000  /* Delivery status */
+#define LAPIC_ICR_ASSERT        0x00004000
+#define LAPIC_ICR_LEVEL         0x00008000
+
+/* LVT timer bits */
+#define LAPIC_TIMER_PERIODIC    0x00020000
+#define LAPIC_LVT_MASKED        0x00010000
+#define LAPIC_TIMER_DIV_16      0x3
+
+/* Interrupt vectors owned by the local APIC */
+#define LAPIC_TIMER_VECTOR      48
+#define LAPIC_SPURIOUS_VECTOR   0xFF
+
+/* Map the APIC (base from ACPI, 0 for the MSR value) and enable it on this CPU */
+void lapic_init(uint32_t base);
+
+/* True once lapic_init found an APIC */
+bool lapic_present(void);
+
+/* APIC ID of the calling CPU */
+uint32_t lapic_id(void);
+
+/* Acknowledge the interrupt being serviced */
+void lapic_eoi(void);
+
+/* Wake an application processor: INIT, then two STARTUP IPIs */
+void lapic_send_init(uint32_t apic_id);
+void lapic_send_startup(uint32_t apic_id, uint8_t vector_page);
+
+/* Measure the APIC timer against the PIT; returns counts per PIT tick */
+uint32_t lapic_timer_calibrate(void);
+
+/* Run the APIC timer periodically at counts per interrupt */
+void lapic_timer_start(uint32_t counts);
+
+#endif /* APIC_H */
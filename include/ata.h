@@ -0,0 +1,59 @@
+/*
+ * NightOS - ATA Disk Driver
+ * 
+ * PIO-mode driver for the primary IDE channel
+ */
+
+#ifndef ATA_H
+#define ATA_H
+
+#include "types.h"
+
+/* Primary channel I/O ports */
+#define ATA_PRIMARY_IO      0x1F0
+#define ATA_PRIMARY_CTRL    0x3F6
+
+/* Register offsets from the I/O base */
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_SECCOUNT    2
+#define ATA_REG_LBA0        3
+#define ATA_REG_LBA1        4
+#define ATA_REG_LBA2        5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_COMMAND     7
+#define ATA_REG_STATUS      7
+
+/* Commands */
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_WRITE_PIO   0x30
+#define ATA_CMD_CACHE_FLUSH 0xE7
+#define ATA_CMD_IDENTIFY    0xEC
+
+/* Status bits */
+#define ATA_SR_BSY          0x80
+#define ATA_SR_DRDY         0x40
+#define ATA_SR_DF           0x20
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_ERR          0x01
+
+/* Drives on the primary channel */
+#define ATA_DRIVE_MASTER    0   /* Boot disk */
+#define ATA_DRIVE_SLAVE     1   /* Second QEMU disk (-hdb) */
+
+#define ATA_SECTOR_SIZE     512
+
+/* Probe drives on the primary channel */
+void ata_init(void);
+
+/* Check if a drive answered IDENTIFY */
+bool ata_present(uint8_t drive);
+
+/* Get drive size in sectors */
+uint32_t ata_sectors(uint8_t drive);
+
+/* Sector I/O (LBA28); return 0 on success, negative on error */
+int ata_read_sectors(uint8_t drive, uint32_t lba, uint8_t count, void* buffer);
+int ata_write_sectors(uint8_t drive, uint32_t lba, uint8_t count, const void* buffer);
+
+#endif /* ATA_H */
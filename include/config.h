@@ -17,6 +17,24 @@
 #define KERNEL_HEAP_SIZE  0x100000    /* 1MB heap */
 #define KERNEL_STACK_SIZE 0x4000      /* 16KB stack */
 
+/* Initramfs (loaded by the bootloader, see boot/boot.asm) */
+#define INITRD_ADDR       0x40000     /* Archive load address */
+#define INITRD_MAX_SIZE   0x40000     /* 256KB limit */
+#define BOOT_INFO_ADDR    0x500       /* Bootloader writes initrd size here */
+
+/* SMP start-up page for application processors (see kernel/ap_boot.asm) */
+#define AP_TRAMPOLINE_ADDR 0x80000    /* Just past the initrd, 4KB aligned */
+
+/* Process stacks: a 4KB-paged region with an unmapped guard page below each stack */
+#define STACK_POOL_BASE    0x400000   /* 4MB, above the heap's 4MB page */
+#define STACK_POOL_SIZE    0x400000   /* 4MB: 512 guarded 4KB stacks */
+#define STACK_POOL_RESERVE 8          /* Free stacks kept painted and ready */
+
+/* Frames backing program address spaces (see kernel/vmm.c) */
+#define FRAME_POOL_BASE    0x800000   /* 8MB, just past the stack pool */
+#define FRAME_POOL_SIZE    0x800000   /* 8MB: 2048 reference-counted frames */
+#define USER_STACK_SIZE    0x10000    /* 64KB, filled in as it is touched */
+
 /* VGA Configuration */
 #define VGA_WIDTH  80
 #define VGA_HEIGHT 25
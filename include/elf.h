@@ -0,0 +1,80 @@
+/*
+ * NightOS - ELF Executables
+ * 
+ * ELF32 i386 program loading. Segments are not read at exec time:
+ * each becomes an area of the new address space whose pages are read
+ * from the file when first touched.
+ */
+
+#ifndef ELF_H
+#define ELF_H
+
+#include "types.h"
+
+struct mm;
+
+/* e_ident */
+#define ELF_MAGIC           0x464C457F  /* "\x7FELF", little-endian */
+#define ELF_CLASS_32        1
+#define ELF_DATA_LSB        1
+
+#define ELF_TYPE_EXEC       2
+#define ELF_MACHINE_386     3
+#define ELF_VERSION_CURRENT 1
+
+/* Program headers */
+#define ELF_PT_LOAD         1
+#define ELF_PF_X            0x1
+#define ELF_PF_W            0x2
+#define ELF_PF_R            0x4
+#define ELF_MAX_PHDRS       16
+
+/* File header */
+typedef struct {
+    uint8_t  ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf32_ehdr_t;
+
+/* Program header */
+typedef struct {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) elf32_phdr_t;
+
+/* An executable kept open while any address space maps it */
+typedef struct exec_image {
+    int handle;                         /* fs handle */
+    volatile uint32_t refs;             /* One per area backed by it */
+} exec_image_t;
+
+/* Set up the loader */
+void elf_init(void);
+
+/* Add path's loadable segments to mm as file-backed areas */
+int elf_load(struct mm* mm, const char* path, uint32_t* entry);
+
+void image_get(exec_image_t* image);
+void image_put(exec_image_t* image);
+
+/* Read part of an image's file (process context; may sleep) */
+int image_read(exec_image_t* image, uint32_t offset, void* buffer, uint32_t size);
+
+#endif /* ELF_H */
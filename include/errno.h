@@ -0,0 +1,24 @@
+/*
+ * NightOS - Error Numbers
+ * 
+ * Negated in kernel and system call return values (Linux numbering)
+ */
+
+#ifndef ERRNO_H
+#define ERRNO_H
+
+#define ENOENT          2       /* No such file */
+#define EIO             5       /* I/O error */
+#define ENOEXEC         8       /* Not a valid executable */
+#define EBADF           9       /* Bad file descriptor */
+#define ECHILD          10      /* No child to wait for */
+#define EAGAIN          11      /* Try again (value changed, would block) */
+#define ENOMEM          12      /* Out of memory */
+#define EFAULT          14      /* Bad address */
+#define EINVAL          22      /* Invalid argument */
+#define ENFILE          23      /* File table full */
+#define EPIPE           32      /* Pipe has no reader */
+#define ENOSYS          38      /* No such system call */
+#define ETIMEDOUT       110     /* Timed out */
+
+#endif /* ERRNO_H */
@@ -0,0 +1,113 @@
+/*
+ * NightOS - FAT32 Filesystem Driver
+ * 
+ * Read/write access to a FAT32 volume on an ATA disk. Files appear in
+ * the fs_* namespace under the "fat/" prefix (see kernel/fs.c).
+ */
+
+#ifndef FAT32_H
+#define FAT32_H
+
+#include "types.h"
+#include "fs.h"
+
+/* Driver limits */
+#define FAT32_MAX_DENTRIES      128     /* Root directory entries indexed */
+#define FAT32_MAX_OPEN          8       /* Open files */
+#define FAT32_CACHE_SECTORS     8       /* Cached FAT sectors */
+#define FAT32_WRITEBACK_MS      1000    /* Delay before dirty FAT sectors are written */
+#define FAT32_MAX_NAME          (FS_MAX_FILENAME - 4)   /* Leaves room for "fat/" */
+
+/* FAT entry values */
+#define FAT32_FREE              0x00000000
+#define FAT32_EOC               0x0FFFFFF8  /* >= means end of chain */
+#define FAT32_MASK              0x0FFFFFFF
+
+/* Directory entry attributes */
+#define FAT32_ATTR_READ_ONLY    0x01
+#define FAT32_ATTR_HIDDEN       0x02
+#define FAT32_ATTR_SYSTEM       0x04
+#define FAT32_ATTR_VOLUME_ID    0x08
+#define FAT32_ATTR_DIRECTORY    0x10
+#define FAT32_ATTR_ARCHIVE      0x20
+#define FAT32_ATTR_LFN          0x0F
+
+/* BIOS parameter block (FAT32 layout) */
+typedef struct {
+    uint8_t  jump[3];
+    char     oem[8];
+    uint16_t bytes_per_sector;
+    uint8_t  sectors_per_cluster;
+    uint16_t reserved_sectors;
+    uint8_t  num_fats;
+    uint16_t root_entries;          /* 0 on FAT32 */
+    uint16_t total_sectors_16;
+    uint8_t  media;
+    uint16_t fat_size_16;           /* 0 on FAT32 */
+    uint16_t sectors_per_track;
+    uint16_t num_heads;
+    uint32_t hidden_sectors;
+    uint32_t total_sectors_32;
+    uint32_t fat_size_32;
+    uint16_t ext_flags;
+    uint16_t fs_version;
+    uint32_t root_cluster;
+    uint16_t fs_info;
+    uint16_t backup_boot;
+    uint8_t  reserved[12];
+    uint8_t  drive_number;
+    uint8_t  reserved1;
+    uint8_t  boot_signature;
+    uint32_t volume_id;
+    char     volume_label[11];
+    char     fs_type[8];
+} __attribute__((packed)) fat32_bpb_t;
+
+/* Short (8.3) directory entry */
+typedef struct {
+    char     name[11];
+    uint8_t  attr;
+    uint8_t  nt_reserved;           /* 0x08 base lowercase, 0x10 ext lowercase */
+    uint8_t  create_tenth;
+    uint16_t create_time;
+    uint16_t create_date;
+    uint16_t access_date;
+    uint16_t cluster_high;
+    uint16_t write_time;
+    uint16_t write_date;
+    uint16_t cluster_low;
+    uint32_t size;
+} __attribute__((packed)) fat32_dirent_t;
+
+/* Long file name directory entry */
+typedef struct {
+    uint8_t  order;                 /* Sequence number, 0x40 = last */
+    uint16_t name1[5];
+    uint8_t  attr;                  /* Always FAT32_ATTR_LFN */
+    uint8_t  type;
+    uint8_t  checksum;              /* Of the matching short name */
+    uint16_t name2[6];
+    uint16_t cluster;
+    uint16_t name3[2];
+} __attribute__((packed)) fat32_lfn_t;
+
+/* Mount the FAT32 volume on an ATA drive */
+int fat32_mount(uint8_t drive);
+bool fat32_mounted(void);
+
+/* Directory (names are relative to the "fat/" prefix) */
+int fat32_count(void);
+int fat32_dentry(int index, fs_dirent_t* entry);
+bool fat32_exists(const char* name);
+uint32_t fat32_size(const char* name);
+int fat32_create(const char* name);
+int fat32_delete(const char* name);
+
+/* File I/O */
+int fat32_open(const char* name, uint8_t mode);
+void fat32_close(int handle);
+int fat32_read(int handle, void* buffer, uint32_t size);
+int fat32_write(int handle, const void* buffer, uint32_t size);
+int fat32_seek(int handle, uint32_t position);
+
+#endif /* FAT32_H */
@@ -0,0 +1,48 @@
+/*
+ * NightOS - Lazy FPU/SSE Context Switching
+ * 
+ * FPU state is saved and restored only for processes that use it
+ */
+
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+#include "process.h"
+
+/* FXSAVE/FXRSTOR area (FNSAVE needs only 108 bytes of it) */
+#define FPU_STATE_SIZE      512
+#define FPU_STATE_ALIGN     16
+
+/* CR0 and CR4 bits */
+#define CR0_MP              0x00000002  /* Monitor coprocessor */
+#define CR0_EM              0x00000004  /* Emulate FPU */
+#define CR0_TS              0x00000008  /* Task switched */
+#define CR0_NE              0x00000020  /* Native FPU errors */
+#define CR4_OSFXSR          0x00000200  /* FXSAVE/FXRSTOR and SSE */
+#define CR4_OSXMMEXCPT      0x00000400  /* Unmasked SSE exceptions */
+
+/* CPUID feature bits (EDX of leaf 1) */
+#define CPUID_EDX_FPU       0x00000001
+#define CPUID_EDX_FXSR      0x01000000
+#define CPUID_EDX_SSE       0x02000000
+
+/* Enable the FPU, SSE if present, and install the #NM handler */
+void fpu_init(void);
+
+/* Same CPU setup on an application processor */
+void fpu_init_cpu(void);
+
+/* Called on every context switch: save prev if it used the FPU, trap next's first use */
+void fpu_switch(process_t* prev, process_t* next);
+
+/* Give a forked child a copy of the parent's (current) FPU state; false if out of memory */
+bool fpu_fork(process_t* parent, process_t* child);
+
+/* Forget a process's FPU state (exit/kill) */
+void fpu_release(process_t* proc);
+
+/* Process holding this CPU's FPU registers, if any */
+process_t* fpu_owner(void);
+
+#endif /* FPU_H */
@@ -14,6 +14,9 @@
 #define FS_MAX_FILENAME     32
 #define FS_MAX_FILESIZE     4096
 #define FS_BLOCK_SIZE       512
+#define FS_FILE_BLOCKS      (FS_MAX_FILESIZE / FS_BLOCK_SIZE)
+#define FS_MAX_BLOCKS       (FS_MAX_FILES * FS_FILE_BLOCKS * 2)  /* Live + snapshot */
+#define FS_FAT_PREFIX       "fat/"  /* Names routed to the FAT32 volume */
 
 /* File types */
 #define FS_TYPE_FREE        0
@@ -34,7 +37,7 @@ typedef struct {
     uint32_t size;
     uint32_t created;       /* Timestamp */
     uint32_t modified;      /* Timestamp */
-    uint8_t* data;          /* Pointer to file data */
+    uint16_t blocks[FS_FILE_BLOCKS];  /* Shared data blocks, 0 = hole */
 } fs_file_t;
 
 /* Directory entry for listing */
@@ -44,17 +47,28 @@ typedef struct {
     uint32_t size;
 } fs_dirent_t;
 
+/* Directory cursor for fs_readdir */
+typedef struct {
+    int slot;               /* Next slot to examine */
+    uint32_t generation;    /* fs_generation() when the cursor was opened */
+    bool changed;           /* The filesystem changed mid-walk: entries may be missed or repeated */
+} fs_dir_t;
+
 /* File handle for open files */
 typedef struct {
     fs_file_t* file;
     uint32_t position;      /* Current read/write position */
     uint8_t mode;           /* Open mode (read/write) */
     bool in_use;
+    int fat_handle;         /* FAT32 handle, or -1 for RAM files */
 } fs_handle_t;
 
 /* Initialize filesystem */
 void fs_init(void);
 
+/* Index a ustar archive in place (data is not copied) */
+int fs_load_initrd(const uint8_t* archive, uint32_t size);
+
 /* File operations */
 int fs_create(const char* name, uint8_t type);
 int fs_delete(const char* name);
@@ -72,10 +86,27 @@ uint32_t fs_size(const char* name);
 /* Directory operations */
 int fs_list(fs_dirent_t* entries, int max_entries);
 int fs_count(void);
+void fs_opendir(fs_dir_t* dir);
+
+/* Next entry (1) or the end (0); sets dir->changed if a mutation raced the walk */
+int fs_readdir(fs_dir_t* dir, fs_dirent_t* entry);
+
+/* Bumped by every mutation; unchanged generation means unchanged listing */
+uint32_t fs_generation(void);
+
+/* Copy-on-write snapshot of the RAM filesystem */
+int fs_snapshot(void);
+int fs_rollback(void);
+void fs_snapshot_drop(void);
+bool fs_has_snapshot(void);
 
 /* Utility */
 void fs_format(void);
 uint32_t fs_free_space(void);
 uint32_t fs_used_space(void);
 
+/* Filesystem lock, held by every call above; FAT32 writeback takes it too */
+void fs_lock(void);
+void fs_unlock(void);
+
 #endif /* FS_H */
@@ -0,0 +1,60 @@
+/*
+ * NightOS - Fast User-Space Mutexes
+ * 
+ * Sleep and wake on a 32-bit word in user memory, so user-space locks
+ * trap only when contended
+ */
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "types.h"
+#include "syscall.h"
+
+/* Hashed wait queues; waiters on different words may share a bucket */
+#define FUTEX_HASH_BITS     6
+#define FUTEX_HASH_BUCKETS  (1 << FUTEX_HASH_BITS)
+
+/* SYS_FUTEX operations */
+#define FUTEX_WAIT          0       /* Sleep if *addr == val (timeout in ms, 0 = none) */
+#define FUTEX_WAKE          1       /* Wake up to val waiters on addr */
+
+/* Initialize the bucket table */
+void futex_init(void);
+
+/* 0 when woken, -EAGAIN if *addr != expected, -ETIMEDOUT, -EINVAL, -EFAULT */
+int futex_wait(volatile uint32_t* addr, uint32_t expected, uint32_t timeout_ms);
+
+/* Wake up to nr waiters on addr; returns how many woke */
+int futex_wake(volatile uint32_t* addr, uint32_t nr);
+
+/* ========== User-Space Mutex ========== */
+
+/* 0 = unlocked, 1 = locked, 2 = locked and someone may be asleep */
+typedef struct {
+    volatile uint32_t state;
+} umutex_t;
+
+#define UMUTEX_INIT     { 0 }
+
+/* Uncontended lock and unlock are one atomic each, with no system call */
+static inline void umutex_lock(umutex_t* m) {
+    uint32_t c = __sync_val_compare_and_swap(&m->state, 0, 1);
+    if (c == 0) return;
+    
+    /* Mark the lock contended, then sleep until we take it that way */
+    if (c != 2) c = __sync_lock_test_and_set(&m->state, 2);
+    while (c != 0) {
+        sys_futex(&m->state, FUTEX_WAIT, 2, 0);
+        c = __sync_lock_test_and_set(&m->state, 2);
+    }
+}
+
+static inline void umutex_unlock(umutex_t* m) {
+    if (__sync_fetch_and_sub(&m->state, 1) != 1) {
+        m->state = 0;
+        sys_futex(&m->state, FUTEX_WAKE, 1, 0);
+    }
+}
+
+#endif /* FUTEX_H */
@@ -0,0 +1,77 @@
+/*
+ * NightOS - Global Descriptor Table
+ * 
+ * Each CPU gets its own GDT so it can have its own TSS and a %gs
+ * segment based at its per-CPU data, plus flat ring 3 segments for
+ * programs
+ */
+
+#ifndef GDT_H
+#define GDT_H
+
+#include "types.h"
+
+/* Selectors (the first three match the bootloader's flat GDT) */
+#define GDT_NULL            0x00
+#define GDT_KERNEL_CODE     0x08
+#define GDT_KERNEL_DATA     0x10
+#define GDT_USER_CODE       0x18    /* Ring 3; SYSEXIT expects it at SYSENTER_CS + 16 */
+#define GDT_USER_DATA       0x20    /* Ring 3; ... and this at SYSENTER_CS + 24 */
+#define GDT_TSS             0x28
+#define GDT_PERCPU          0x30    /* Loaded into %gs */
+#define GDT_DF_TSS          0x38    /* Double fault task */
+#define GDT_CPU_NUMBER      0x40    /* Ring 3 visible; its limit is the CPU's index */
+#define GDT_ENTRIES         9
+
+/* Selectors programs run with (RPL 3) */
+#define GDT_USER_CS         (GDT_USER_CODE | 3)
+#define GDT_USER_DS         (GDT_USER_DATA | 3)
+
+/* LSL on this gives a program the index of the CPU it runs on (see vdso.h) */
+#define GDT_USER_CPU        (GDT_CPU_NUMBER | 3)
+
+#define GDT_DF_STACK_SIZE   2048    /* Per-CPU stack of the double fault task */
+
+/* Access bytes */
+#define GDT_ACCESS_CODE     0x9A    /* Present, ring 0, code, readable */
+#define GDT_ACCESS_DATA     0x92    /* Present, ring 0, data, writable */
+#define GDT_ACCESS_USER_CODE 0xFA   /* Present, ring 3, code, readable */
+#define GDT_ACCESS_USER_DATA 0xF2   /* Present, ring 3, data, writable */
+#define GDT_ACCESS_TSS      0x89    /* Present, ring 0, available 32-bit TSS */
+
+/* Flag nibbles */
+#define GDT_FLAGS_FLAT      0xC     /* 4KB granularity, 32-bit */
+#define GDT_FLAGS_BYTE      0x4     /* Byte granularity, 32-bit */
+
+/*
+ * 32-bit Task State Segment. The main one only needs ss0:esp0 and the
+ * I/O map base; the double fault task's is a full register image.
+ */
+typedef struct {
+    uint32_t prev_tss;
+    uint32_t esp0, ss0;                 /* Stack loaded on entry to ring 0 */
+    uint32_t esp1, ss1;
+    uint32_t esp2, ss2;
+    uint32_t cr3, eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
+/* GDTR operand */
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_ptr_t;
+
+struct cpu;
+
+/* Build and load a CPU's GDT and TSS, and point %gs at its per-CPU data */
+void gdt_init_cpu(struct cpu* cpu);
+
+/* Stack the CPU switches to on entry from ring 3 */
+void gdt_set_kernel_stack(struct cpu* cpu, uint32_t esp0);
+
+#endif /* GDT_H */
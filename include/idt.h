@@ -15,6 +15,8 @@
 /* IDT gate types */
 #define IDT_GATE_INTERRUPT 0x8E  /* 32-bit Interrupt Gate */
 #define IDT_GATE_TRAP      0x8F  /* 32-bit Trap Gate */
+#define IDT_GATE_USER      0xEE  /* 32-bit Interrupt Gate that ring 3 may invoke */
+#define IDT_GATE_TASK      0x85  /* Task Gate (selector names a TSS) */
 
 /* IDT entry structure (8 bytes) */
 typedef struct {
@@ -40,6 +42,9 @@ extern const char* exception_messages[];
 /* Initialize IDT */
 void idt_init(void);
 
+/* Load the already built IDT on another CPU */
+void idt_reload(void);
+
 /* Set an IDT entry */
 void idt_set_gate(uint8_t num, uint32_t handler, uint16_t selector, uint8_t flags);
 
@@ -101,6 +106,13 @@ extern void irq13(void);
 extern void irq14(void);
 extern void irq15(void);
 
+/* Local APIC vectors (defined in assembly) */
+extern void lapic_timer_isr(void);
+extern void spurious_isr(void);
+
+/* System call vector (defined in assembly) */
+extern void isr128(void);
+
 /* IRQ numbers */
 #define IRQ0  32
 #define IRQ1  33
@@ -120,13 +132,16 @@ extern void irq15(void);
 #define IRQ15 47
 
 /* Registers structure pushed by ISR */
-typedef struct {
+typedef struct registers {
     uint32_t ds;                                     /* Data segment */
     uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax; /* Pushed by pusha */
     uint32_t int_no, err_code;                       /* Interrupt number and error code */
     uint32_t eip, cs, eflags, useresp, ss;           /* Pushed by CPU */
 } __attribute__((packed)) registers_t;
 
+/* Double fault handler, run as a separate task (see GDT_DF_TSS) */
+void double_fault_task(void);
+
 /* High-level interrupt handler type */
 typedef void (*isr_handler_t)(registers_t*);
 
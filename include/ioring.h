@@ -0,0 +1,97 @@
+/*
+ * NightOS - Asynchronous I/O Rings
+ * 
+ * Shared submission/completion queues between processes and the kernel
+ */
+
+#ifndef IORING_H
+#define IORING_H
+
+#include "types.h"
+
+/* Ring constants */
+#define IORING_ENTRIES      32                      /* Power of two */
+#define IORING_CQ_ENTRIES   (IORING_ENTRIES * 2)
+#define IORING_MAX_RINGS    8
+
+/* Rings are mapped into programs from here up (one page each) */
+#define IORING_MAP_BASE     0x70000000
+
+/* Setup flags */
+#define IORING_SETUP_SQPOLL 0x01    /* Kernel polls the SQ, no doorbell needed */
+
+/* Operations (arguments match the equivalent system call) */
+#define IORING_OP_NOP       0
+#define IORING_OP_READ      1       /* fd, addr = buffer, len = count */
+#define IORING_OP_WRITE     2       /* fd, addr = buffer, len = count */
+#define IORING_OP_OPEN      3       /* addr = path, len = flags */
+#define IORING_OP_CLOSE     4       /* fd */
+
+/* Submission queue entry */
+typedef struct {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t reserved;
+    int32_t  fd;                    /* Same numbering as sys_read/sys_write */
+    uint32_t addr;
+    uint32_t len;
+    uint32_t user_data;             /* Copied to the completion untouched */
+} io_sqe_t;
+
+/* Completion queue entry */
+typedef struct {
+    uint32_t user_data;
+    int32_t  result;                /* What the synchronous call would return */
+} io_cqe_t;
+
+/* Ring shared between a process and the kernel (fits in a page) */
+typedef struct {
+    volatile uint32_t sq_head;      /* Advanced by the kernel */
+    volatile uint32_t sq_tail;      /* Advanced by the process */
+    volatile uint32_t cq_head;      /* Advanced by the process */
+    volatile uint32_t cq_tail;      /* Advanced by the kernel */
+    uint32_t flags;                 /* IORING_SETUP_* */
+    uint32_t owner_pid;
+    uint32_t submitted;             /* Statistics */
+    uint32_t completed;
+    io_sqe_t sqes[IORING_ENTRIES];
+    io_cqe_t cqes[IORING_CQ_ENTRIES];
+} io_ring_t;
+
+/* Kernel side */
+void ioring_init(void);
+io_ring_t* ioring_setup(uint32_t flags);    /* The ring as the caller sees it, or NULL */
+int ioring_enter(io_ring_t* ring, uint32_t to_submit);
+int ioring_destroy(io_ring_t* ring);
+void ioring_release(uint32_t pid);
+void ioring_poll(void);                     /* The calling process's SQPOLL rings */
+
+/* Process side: get the next free SQE, or NULL if the SQ is full */
+static inline io_sqe_t* ioring_get_sqe(io_ring_t* ring) {
+    if (ring->sq_tail - ring->sq_head >= IORING_ENTRIES) {
+        return NULL;
+    }
+    return &ring->sqes[ring->sq_tail & (IORING_ENTRIES - 1)];
+}
+
+/* Process side: publish the SQE returned by ioring_get_sqe */
+static inline void ioring_push_sqe(io_ring_t* ring) {
+    __asm__ volatile("" ::: "memory");  /* SQE contents before the tail */
+    ring->sq_tail++;
+}
+
+/* Process side: oldest unreaped completion, or NULL if none */
+static inline io_cqe_t* ioring_peek_cqe(io_ring_t* ring) {
+    if (ring->cq_head == ring->cq_tail) {
+        return NULL;
+    }
+    __asm__ volatile("" ::: "memory");
+    return &ring->cqes[ring->cq_head & (IORING_CQ_ENTRIES - 1)];
+}
+
+/* Process side: release the completion returned by ioring_peek_cqe */
+static inline void ioring_cqe_seen(io_ring_t* ring) {
+    ring->cq_head++;
+}
+
+#endif /* IORING_H */
@@ -0,0 +1,79 @@
+/*
+ * NightOS - Paging
+ * 
+ * Identity-mapped kernel address space: 4MB pages everywhere except
+ * regions that need per-page control, which get 4KB page tables
+ */
+
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+
+#define PAGE_SIZE           0x1000
+#define PAGE_LARGE_SIZE     0x400000    /* One page directory entry */
+
+/* Page directory / table entry bits */
+#define PAGE_PRESENT        0x001
+#define PAGE_WRITE          0x002
+#define PAGE_USER           0x004
+#define PAGE_WRITETHROUGH   0x008
+#define PAGE_NOCACHE        0x010
+#define PAGE_LARGE          0x080       /* 4MB page (directory entries, CR4.PSE) */
+#define PAGE_COW            0x200       /* Software: shared until written (see vmm.c) */
+#define PAGE_FRAME_MASK     0xFFFFF000
+
+#define PAGE_TABLE_ENTRIES  1024
+#define PAGE_DIR_INDEX(a)   ((a) >> 22)
+#define PAGE_TABLE_INDEX(a) (((a) >> 12) & 0x3FF)
+
+/* Per-process region; unmapped in the kernel directory */
+#define USER_BASE           0x40000000
+#define USER_TOP            0x80000000
+
+/* Device memory (local APIC, I/O APIC, ...) is mapped uncached from here up */
+#define PAGING_MMIO_BASE    0xC0000000
+
+/* Build the kernel page directory and turn paging on for the BSP */
+void paging_init(void);
+
+/* Turn paging on for an application processor */
+void paging_init_cpu(void);
+
+/* Physical address of the kernel page directory (for CR3 and TSSes) */
+uint32_t paging_kernel_directory(void);
+
+/*
+ * Map or unmap one identity-mapped 4KB page in a 4KB-paged region.
+ * Only this CPU's TLB is flushed: callers either change pages no other
+ * CPU has used yet or can tolerate a stale entry there.
+ */
+bool paging_set_present(uint32_t virt, bool present);
+
+/* True if an access to virt would not fault */
+bool paging_is_mapped(uint32_t virt);
+
+/* Switch address spaces; also flushes every non-global TLB entry */
+static inline void load_cr3(uint32_t directory) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(directory) : "memory");
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+/* Drop one page's TLB entry on this CPU */
+static inline void invlpg(uint32_t virt) {
+    __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+/* Linear address of the last page fault */
+static inline uint32_t read_cr2(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+#endif /* PAGING_H */
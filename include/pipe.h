@@ -0,0 +1,69 @@
+/*
+ * NightOS - Pipes
+ * 
+ * One-way byte streams between processes, held as a ring of page-sized
+ * buffers. Reads and writes block; a write of whole, page-aligned pages
+ * lends the pipe the writer's frames instead of copying them.
+ */
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "types.h"
+
+#define PIPE_MAX            16          /* Pipes open at once (2 ends each fit pipe_ends) */
+#define PIPE_BUFFERS        16          /* Pages one pipe may hold */
+
+/*
+ * Pipe descriptors sit above every file descriptor: pipe n has
+ * PIPE_FD_BASE + 2n for reading and the next one up for writing.
+ * Unlike file handles they belong to the processes holding them: a
+ * forked child holds its parent's ends too, and an exiting process
+ * lets go of whatever it still holds.
+ */
+#define PIPE_FD_BASE        64
+#define PIPE_FD_END         (PIPE_FD_BASE + 2 * PIPE_MAX)
+
+/* Totals since boot */
+typedef struct {
+    uint32_t open;                      /* Pipes in use */
+    uint32_t bytes_copied;              /* Written through the kernel's pages */
+    uint32_t pages_lent;                /* Written by lending the writer's page */
+} pipe_stats_t;
+
+/* Initialize the pipe table */
+void pipe_init(void);
+
+static inline bool pipe_is_fd(uint32_t fd) {
+    return fd >= PIPE_FD_BASE && fd < PIPE_FD_END;
+}
+
+/* Open a pipe, held by the caller: fds[0] reads, fds[1] writes. 0, or -ENFILE */
+int pipe_create(int fds[2]);
+
+/*
+ * Read up to count bytes into a user buffer, sleeping until there are
+ * some. Returns the bytes read, 0 once the pipe is empty and no
+ * process holds its write end, -EBADF or -EFAULT.
+ */
+int pipe_read(uint32_t fd, void* buf, uint32_t count);
+
+/*
+ * Write count bytes from a user buffer, sleeping while the pipe is
+ * full. Returns the bytes written (short only on error), -EBADF, or
+ * -EPIPE once no process holds the read end.
+ */
+int pipe_write(uint32_t fd, const void* buf, uint32_t count);
+
+/* Let go of one end; the pipe is freed once nobody holds either */
+int pipe_close(uint32_t fd);
+
+/* A forked child holds ends (a pipe_ends mask) as well as its parent */
+void pipe_fork(uint32_t ends);
+
+/* Let go of every end in ends, for a process that is exiting */
+void pipe_release(uint32_t ends);
+
+void pipe_get_stats(pipe_stats_t* stats);
+
+#endif /* PIPE_H */
@@ -1,18 +1,30 @@
 /*
  * NightOS - Process Management
  * 
- * Simple cooperative multitasking
+ * Preemptive multitasking driven by the PIT and per-CPU APIC timers
  */
 
 #ifndef PROCESS_H
 #define PROCESS_H
 
 #include "types.h"
+#include "rbtree.h"
+#include "wait.h"
 
 /* Process constants */
-#define MAX_PROCESSES       16
+#define MAX_PROCESSES       4096    /* Upper bound on live PCBs */
+#define PCB_POOL_CHUNK      32      /* PCBs allocated per pool refill */
+#define PID_HASH_BUCKETS    64
 #define PROCESS_STACK_SIZE  4096
 #define PROCESS_NAME_LEN    32
+#define SCHED_RT_SLICE_TICKS 20     /* REALTIME round-robin slice (200ms) */
+#define SCHED_PRIORITIES    4       /* proc_priority_t levels, each with a fair weight */
+
+/* Fair class tuning */
+#define SCHED_LATENCY_MS            40      /* Period in which every fair process runs */
+#define SCHED_MIN_GRANULARITY_MS    10      /* Default shortest slice before preemption */
+#define SCHED_MAX_GRANULARITY_MS    500
+#define SCHED_NICE0_WEIGHT          1024    /* Weight of PROC_PRIORITY_NORMAL */
 
 /* Process states */
 typedef enum {
@@ -20,10 +32,15 @@ typedef enum {
     PROC_STATE_READY,
     PROC_STATE_RUNNING,
     PROC_STATE_BLOCKED,
-    PROC_STATE_ZOMBIE
+    PROC_STATE_ZOMBIE,
+    PROC_STATE_COUNT
 } proc_state_t;
 
-/* Process priority */
+/*
+ * Process priority. REALTIME processes use the round-robin class and
+ * always run before the rest, which share the CPU in the fair class in
+ * proportion to their priority's weight.
+ */
 typedef enum {
     PROC_PRIORITY_LOW = 0,
     PROC_PRIORITY_NORMAL,
@@ -31,28 +48,77 @@ typedef enum {
     PROC_PRIORITY_REALTIME
 } proc_priority_t;
 
-/* CPU context for context switching */
+/* Where a CPU's cycles go, for per-process accounting */
+typedef enum {
+    ACCT_KERNEL = 0,                    /* Kernel code on the process's behalf */
+    ACCT_USER,                          /* Ring 3 */
+    ACCT_IRQ,                           /* Hardware interrupt handlers */
+    ACCT_IDLE,                          /* An idle process waiting for work */
+    ACCT_STATES
+} acct_state_t;
+
+/* CPU context saved on a process stack by context_switch */
 typedef struct {
-    uint32_t eax, ebx, ecx, edx;
-    uint32_t esi, edi;
-    uint32_t esp, ebp;
-    uint32_t eip;
+    uint32_t edi, esi, ebx, ebp;        /* Callee-saved registers */
     uint32_t eflags;
+    uint32_t eip;                       /* Where the process resumes */
 } cpu_context_t;
 
+struct run_queue;
+struct mm;
+struct registers;
+
 /* Process Control Block (PCB) */
-typedef struct {
+typedef struct process {
     uint32_t pid;                       /* Process ID */
     char name[PROCESS_NAME_LEN];        /* Process name */
     proc_state_t state;                 /* Current state */
     proc_priority_t priority;           /* Priority level */
-    cpu_context_t context;              /* Saved CPU context */
+    cpu_context_t* context;             /* Saved CPU context (on stack) */
     uint8_t* stack;                     /* Stack pointer */
     uint32_t stack_size;                /* Stack size */
     uint32_t parent_pid;                /* Parent process ID */
     uint32_t created_time;              /* Creation timestamp */
-    uint32_t cpu_time;                  /* Total CPU time used */
+    uint32_t cpu_time;                  /* Timer ticks taken while running */
+    uint64_t cycles[ACCT_STATES];       /* TSC cycles spent in each state */
+    uint32_t acct_state;                /* State to resume accounting in */
+    uint32_t switches_voluntary;        /* Gave up the CPU (blocked, slept, exited) */
+    uint32_t switches_forced;           /* Preempted while still runnable */
     void (*entry)(void);                /* Entry point function */
+    int (*thread_fn)(void* arg);        /* Kernel thread body, if any */
+    void* thread_arg;
+    uint32_t timeslice;                 /* Ticks left in current slice (REALTIME) */
+    uint64_t vruntime;                  /* Weighted CPU time in cycles (fair class) */
+    uint64_t exec_start;                /* TSC when last charged */
+    uint32_t slice_exec;                /* Cycles run since last picked */
+    rb_node_t run_node;                 /* Fair timeline link */
+    bool on_timeline;                   /* Queued on a fair timeline */
+    struct process* run_next;           /* Run queue links (REALTIME) */
+    struct process* run_prev;
+    struct run_queue* run_queue;        /* Queue holding us, if READY */
+    uint32_t cpu;                       /* CPU whose run queue we belong to */
+    bool on_cpu;                        /* Executing (or switching out) right now */
+    bool killed;                        /* Killed while running: exits at a safe point */
+    bool detached;                      /* Nobody will wait: freed once it exits */
+    uint32_t wake_tick;                 /* Tick to wake at, if sleeping */
+    struct process* sleep_next;         /* Sleep queue link */
+    bool sleeping;                      /* On the sleep queue */
+    wait_queue_t* wait_queue;           /* Wait queue we are on, if any */
+    struct process* wait_next;          /* Wait queue links */
+    struct process* wait_prev;
+    bool wait_exclusive;                /* Woken one at a time */
+    uint64_t wait_key;                  /* Event on a shared queue, 0 for any */
+    struct process* hash_next;          /* PID hash chain / PCB free-list */
+    struct process* task_next;          /* List of all processes */
+    struct process* task_prev;
+    uint8_t* fpu_state;                 /* FPU save area, on first use */
+    uint32_t fpu_uses;                  /* #NM traps that loaded our state */
+    uint32_t fpu_cpu;                   /* CPU our state was last loaded on */
+    struct mm* mm;                      /* Program address space; NULL for kernel threads */
+    int exit_code;                      /* For the parent's wait, once a zombie */
+    struct registers* syscall_frame;    /* Frame of the system call in progress */
+    uint32_t pipe_ends;                 /* Pipe ends held: bit n for PIPE_FD_BASE + n */
+    uint32_t shm_ids;                   /* Shared memory ids open: bit n for id n */
 } process_t;
 
 /* Process information for listing */
@@ -61,6 +127,12 @@ typedef struct {
     char name[PROCESS_NAME_LEN];
     proc_state_t state;
     uint32_t cpu_time;
+    uint32_t fpu_uses;
+    uint32_t cpu;
+    uint64_t cycles[ACCT_STATES];
+    uint32_t switches_voluntary;
+    uint32_t switches_forced;
+    const uint8_t* stack;               /* For stack_high_water; NULL if none */
 } proc_info_t;
 
 /* Initialize process manager */
@@ -68,9 +140,30 @@ void process_init(void);
 
 /* Process creation/destruction */
 int process_create(const char* name, void (*entry)(void), proc_priority_t priority);
+int kthread_create(const char* name, int (*fn)(void* arg), void* arg, proc_priority_t priority);
 void process_exit(int code);
 int process_kill(uint32_t pid);
 
+/* On the way back to ring 3 from regs: exit if we were killed meanwhile */
+void process_exit_if_killed(struct registers* regs);
+
+/* Nobody will wait for pid: free it as soon as it exits, not as a zombie */
+int process_detach(uint32_t pid);
+
+/* Programs (kernel/exec.c): exec returns only on failure */
+int process_exec(const char* path, char* const argv[]);
+int process_exec_code(const char* name, const void* code, uint32_t size, char* const argv[]);
+
+/* Duplicate the caller from its system call frame; the child returns 0 */
+int process_fork(struct registers* frame);
+
+/* Reap a zombie child (any if pid is -1); returns its PID */
+int process_wait(int32_t pid, int* status);
+
+/* A forked child resumes in fork_return (kernel/isr.asm), which calls process_fork_tail */
+void fork_return(void);
+void process_fork_tail(void);
+
 /* Process control */
 void process_yield(void);
 void process_sleep(uint32_t ms);
@@ -82,10 +175,30 @@ process_t* process_current(void);
 uint32_t process_getpid(void);
 int process_list(proc_info_t* info, int max_count);
 int process_count(void);
+int process_count_state(proc_state_t state);
 
 /* Scheduler */
 void scheduler_init(void);
+void scheduler_init_cpu(uint8_t* idle_stack);
 void scheduler_tick(void);
 void schedule(void);
+void preempt_schedule(void);
+
+/* TSC cycles per millisecond, measured against the PIT (0 until known) */
+uint32_t scheduler_cycles_per_ms(void);
+
+/* CPU accounting around interrupt handlers (kernel/idt.c) */
+uint32_t acct_enter(uint32_t state, bool from_user);
+void acct_exit(uint32_t prev_state);
+
+/* Fair class minimum granularity in milliseconds */
+void scheduler_set_granularity(uint32_t ms);
+uint32_t scheduler_get_granularity(void);
+
+/* Switch stacks, and address spaces if cr3 differs, between two processes (kernel/switch.asm) */
+void context_switch(cpu_context_t** old, cpu_context_t* new_context, uint32_t cr3);
+
+/* Drop to ring 3 at entry on the user stack esp (kernel/switch.asm) */
+void exec_enter(uint32_t esp, uint32_t entry) __attribute__((noreturn));
 
 #endif /* PROCESS_H */
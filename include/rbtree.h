@@ -0,0 +1,47 @@
+/*
+ * NightOS - Red-Black Tree
+ * 
+ * Intrusive balanced binary tree: nodes are embedded in the structures
+ * they order, and the smallest node is cached for O(1) lookup
+ */
+
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include "types.h"
+
+/* Tree node, embedded in the containing structure */
+typedef struct rb_node {
+    struct rb_node* parent;
+    struct rb_node* left;
+    struct rb_node* right;
+    bool red;
+} rb_node_t;
+
+/* Tree root with its leftmost (smallest) node cached */
+typedef struct {
+    rb_node_t* root;
+    rb_node_t* leftmost;
+} rb_tree_t;
+
+/* Ordering: true if a sorts before b (equal keys insert to the right) */
+typedef bool (*rb_less_t)(const rb_node_t* a, const rb_node_t* b);
+
+/* Structure containing a node */
+#define rb_entry(node, type, member) \
+    ((type*)((uint8_t*)(node) - __builtin_offsetof(type, member)))
+
+void rb_init(rb_tree_t* tree);
+void rb_insert(rb_tree_t* tree, rb_node_t* node, rb_less_t less);
+void rb_erase(rb_tree_t* tree, rb_node_t* node);
+
+/* In-order traversal */
+rb_node_t* rb_next(const rb_node_t* node);
+rb_node_t* rb_last(const rb_tree_t* tree);
+
+/* Smallest node, or NULL if the tree is empty */
+static inline rb_node_t* rb_first(const rb_tree_t* tree) {
+    return tree->leftmost;
+}
+
+#endif /* RBTREE_H */
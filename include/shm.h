@@ -0,0 +1,72 @@
+/*
+ * NightOS - Shared Memory
+ * 
+ * Named segments of frames that any number of programs can map, so a
+ * producer and a consumer exchange data without the kernel copying it
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+#include "types.h"
+
+#define SHM_MAX_SEGMENTS    16          /* Ids fit a process's shm_ids mask */
+#define SHM_NAME_MAX        32          /* Including the NUL */
+#define SHM_MAX_PAGES       16          /* 64KB per segment */
+
+/* shm_map places segments from here up, clear of program images */
+#define SHM_MAP_BASE        0x60000000
+
+/* A segment's frames live as long as an open id or a mapping holds it */
+typedef struct shm_segment {
+    char name[SHM_NAME_MAX];
+    uint32_t pages;
+    uint32_t refs;                      /* 0: free slot */
+    uint32_t maps;                      /* Mappings among refs */
+    uint32_t frames[SHM_MAX_PAGES];
+} shm_segment_t;
+
+/* One segment, as the shell lists it */
+typedef struct {
+    char name[SHM_NAME_MAX];
+    uint32_t size;
+    uint32_t refs;
+    uint32_t maps;
+} shm_info_t;
+
+/* Initialize the segment table */
+void shm_init(void);
+
+/*
+ * Open the segment called name, creating it with size bytes (rounded
+ * up to pages, zero-filled) if there is none. size 0 opens only an
+ * existing one. The id belongs to the calling process, which holds it
+ * once however often it opens the segment. Returns the id, -ENOENT,
+ * -EINVAL if an existing one is smaller than size, -ENFILE or -ENOMEM.
+ */
+int shm_open(const char* name, uint32_t size);
+
+/* Drop an id the caller has open; mappings keep the segment alive */
+int shm_close(int id);
+
+/* Map a segment the caller has open into it, read-write; returns the address */
+int shm_map(int id);
+
+/* A forked child has ids (a shm_ids mask) open as well as its parent */
+void shm_fork(uint32_t ids);
+
+/* Drop every id in ids, for a process that is exiting */
+void shm_release_ids(uint32_t ids);
+
+/* Information on segment id; false if it is not open */
+bool shm_get_info(int id, shm_info_t* info);
+
+/* ========== Address Space Hooks ========== */
+
+void shm_get(shm_segment_t* seg);
+void shm_put(shm_segment_t* seg);
+
+/* Frame backing page index of a segment */
+uint32_t shm_frame(const shm_segment_t* seg, uint32_t index);
+
+#endif /* SHM_H */
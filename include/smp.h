@@ -0,0 +1,59 @@
+/*
+ * NightOS - Symmetric Multiprocessing
+ * 
+ * Application processor start-up and per-CPU data reached through %gs
+ */
+
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "gdt.h"
+
+#define SMP_MAX_CPUS        8
+
+/* Per-CPU data; the %gs segment of each CPU is based here */
+typedef struct cpu {
+    struct cpu* self;                   /* %gs:0, so this_cpu() is one load */
+    uint32_t id;                        /* %gs:4, index in the CPU table */
+    uint32_t apic_id;                   /* Local APIC ID */
+    volatile bool online;               /* Set by the CPU once it schedules */
+    uint8_t* boot_stack;                /* AP start-up stack, kept as its idle stack */
+    uint32_t ticks;                     /* Local timer interrupts taken */
+    uint32_t steals;                    /* Processes pulled from other CPUs */
+    volatile uint32_t preempt_count;    /* Preemption off while non-zero */
+    uint64_t gdt[GDT_ENTRIES] __attribute__((aligned(8)));
+    tss_t tss;
+    tss_t df_tss;                       /* Double faults switch to this task */
+} cpu_t;
+
+/* Per-CPU data of the calling CPU */
+static inline cpu_t* this_cpu(void) {
+    cpu_t* cpu;
+    __asm__ volatile("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+/* Index of the calling CPU (0 is the bootstrap processor) */
+static inline uint32_t smp_cpu_id(void) {
+    uint32_t id;
+    __asm__ volatile("movl %%gs:4, %0" : "=r"(id));
+    return id;
+}
+
+/* Set up the bootstrap CPU's GDT and per-CPU data (first thing at boot) */
+void smp_early_init(void);
+
+/* Find the other CPUs in the ACPI MADT and start them (timer must run) */
+void smp_init(void);
+
+/* Number of CPUs that are scheduling */
+int smp_cpu_count(void);
+
+/* CPU table entry, or NULL if that CPU is not online */
+cpu_t* smp_cpu(uint32_t id);
+
+/* C entry point of an application processor (kernel/ap_boot.asm) */
+void ap_main(cpu_t* cpu);
+
+#endif /* SMP_H */
@@ -0,0 +1,53 @@
+/*
+ * NightOS - Process Stack Pool
+ * 
+ * Recycled kernel stacks, each with an unmapped guard page below it,
+ * painted with a canary so each stack's peak use can be measured
+ */
+
+#ifndef STACKPOOL_H
+#define STACKPOOL_H
+
+#include "types.h"
+
+#define STACK_CANARY            0x57AC57AC
+#define STACK_HISTOGRAM_BUCKETS 8       /* Peak use in eighths of a stack */
+
+/* Pool statistics */
+typedef struct {
+    uint32_t slots;                     /* Guarded stacks in the region */
+    uint32_t in_use;
+    uint32_t ready;                     /* Free and already painted */
+    uint32_t dirty;                     /* Free, waiting to be measured and repainted */
+    uint32_t reserve;                   /* Ready stacks to keep */
+    uint32_t allocs;
+    uint32_t ready_hits;                /* Allocations that found a ready stack */
+    uint32_t fallbacks;                 /* Pool exhausted: kmalloc'd, no guard */
+    uint32_t peak_used;                 /* Deepest use of any freed stack, in bytes */
+    uint32_t histogram[STACK_HISTOGRAM_BUCKETS];    /* Freed stacks by peak use */
+} stack_pool_stats_t;
+
+/* Carve the stack region into guarded slots (paging must be on) */
+void stack_pool_init(void);
+
+/* A painted PROCESS_STACK_SIZE stack, or NULL if memory is exhausted */
+uint8_t* stack_alloc(void);
+
+/* Return a stack; cheap enough to call with the scheduler lock held */
+void stack_free(uint8_t* stack);
+
+/* Repaint freed stacks until the reserve is ready (idle loops) */
+void stack_pool_refill(void);
+
+/* Free stacks to keep painted and ready */
+void stack_pool_set_reserve(uint32_t reserve);
+
+/* Deepest use of a live stack so far, in bytes */
+uint32_t stack_high_water(const uint8_t* stack);
+
+/* True if addr lies in the guard page below a pool stack */
+bool stack_is_guard(uint32_t addr);
+
+void stack_pool_get_stats(stack_pool_stats_t* stats);
+
+#endif /* STACKPOOL_H */
@@ -43,4 +43,7 @@ void utoa(uint32_t value, char* str, int base);
 /* Convert string to integer */
 int atoi(const char* str);
 
+/* 64-bit by 32-bit unsigned divide (no libgcc here); remainder may be NULL */
+uint64_t udiv64(uint64_t dividend, uint32_t divisor, uint32_t* remainder);
+
 #endif /* STRING_H */
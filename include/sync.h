@@ -0,0 +1,164 @@
+/*
+ * NightOS - Synchronization Primitives
+ * 
+ * Spinlocks, ticket locks, sequence locks and preemption control,
+ * sleeping mutexes, semaphores and condition variables, with per-lock
+ * contention statistics
+ */
+
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "types.h"
+#include "smp.h"
+#include "wait.h"
+
+/* Contention statistics kept by every lock (updated while it is held) */
+typedef struct lock_stats {
+    const char* name;                   /* NULL until registered by *_init */
+    uint32_t acquisitions;
+    uint32_t contended;                 /* Acquisitions that had to wait */
+    uint64_t spins;                     /* Pause iterations spent waiting */
+    uint64_t max_hold_cycles;           /* Longest time held, in TSC cycles */
+    uint64_t acquired_at;               /* TSC when last taken */
+    struct lock_stats* next;            /* Registry of named locks */
+} lock_stats_t;
+
+/* Test-and-set spinlock */
+typedef struct {
+    volatile uint32_t locked;
+    lock_stats_t stats;
+} spinlock_t;
+
+/* FIFO ticket lock: waiters are served in arrival order */
+typedef struct {
+    volatile uint32_t next;             /* Next ticket to hand out */
+    volatile uint32_t serving;          /* Ticket that owns the lock */
+    lock_stats_t stats;
+} ticket_lock_t;
+
+/* Sequence lock: writers serialize, readers retry instead of blocking */
+typedef struct {
+    volatile uint32_t sequence;         /* Odd while a write is in progress */
+    spinlock_t lock;
+} seqlock_t;
+
+/* Sleeping lock for process context; waiters leave the CPU */
+typedef struct {
+    volatile uint32_t locked;
+    struct process* owner;
+    wait_queue_t waiters;
+    lock_stats_t stats;                 /* spins counts sleeps here */
+} mutex_t;
+
+/* Counting semaphore */
+typedef struct {
+    volatile int32_t count;
+    wait_queue_t waiters;
+} semaphore_t;
+
+/* Condition variable, used with a mutex */
+typedef struct {
+    volatile uint32_t sequence;         /* Bumped by every signal */
+    wait_queue_t waiters;
+} condvar_t;
+
+/* ========== Preemption ========== */
+
+/* Disable preemption on this CPU (nests) */
+static inline void preempt_disable(void) {
+    __asm__ volatile("incl %%gs:%c0" : : "i"(__builtin_offsetof(cpu_t, preempt_count)) : "memory");
+}
+
+/* Preemption-disable depth of this CPU */
+static inline uint32_t preempt_count(void) {
+    uint32_t count;
+    __asm__ volatile("movl %%gs:%c1, %0" : "=r"(count)
+                     : "i"(__builtin_offsetof(cpu_t, preempt_count)));
+    return count;
+}
+
+/* Re-enable preemption; reschedules if a tick asked to meanwhile */
+void preempt_enable(void);
+
+/* Re-enable preemption without the reschedule check */
+static inline void preempt_enable_no_resched(void) {
+    __asm__ volatile("decl %%gs:%c0" : : "i"(__builtin_offsetof(cpu_t, preempt_count)) : "memory");
+}
+
+/* ========== Spinlocks ========== */
+
+void spin_lock_init(spinlock_t* lock, const char* name);
+void spin_lock(spinlock_t* lock);
+bool spin_trylock(spinlock_t* lock);
+void spin_unlock(spinlock_t* lock);
+
+/* Variants that also disable interrupts, for data shared with IRQ handlers */
+uint32_t spin_lock_irqsave(spinlock_t* lock);
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags);
+
+/* ========== Ticket Locks ========== */
+
+void ticket_lock_init(ticket_lock_t* lock, const char* name);
+void ticket_lock(ticket_lock_t* lock);
+void ticket_unlock(ticket_lock_t* lock);
+uint32_t ticket_lock_irqsave(ticket_lock_t* lock);
+void ticket_unlock_irqrestore(ticket_lock_t* lock, uint32_t flags);
+
+/* ========== Sequence Locks ========== */
+
+void seqlock_init(seqlock_t* sl, const char* name);
+
+/* Writers exclude each other and IRQs on this CPU */
+uint32_t write_seqlock(seqlock_t* sl);
+void write_sequnlock(seqlock_t* sl, uint32_t flags);
+
+/* Start a read: returns the sequence to pass to read_seqretry */
+static inline uint32_t read_seqbegin(const seqlock_t* sl) {
+    uint32_t seq;
+    while ((seq = sl->sequence) & 1) {
+        __asm__ volatile("pause");
+    }
+    __asm__ volatile("" : : : "memory");
+    return seq;
+}
+
+/* True if a writer ran since read_seqbegin; the read must be redone */
+static inline bool read_seqretry(const seqlock_t* sl, uint32_t seq) {
+    __asm__ volatile("" : : : "memory");
+    return sl->sequence != seq;
+}
+
+/* ========== Mutexes ========== */
+
+/* Process context only: these may sleep */
+void mutex_init(mutex_t* mutex, const char* name);
+void mutex_lock(mutex_t* mutex);
+bool mutex_trylock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+/* ========== Semaphores ========== */
+
+void semaphore_init(semaphore_t* sem, int32_t count);
+void semaphore_down(semaphore_t* sem);
+bool semaphore_trydown(semaphore_t* sem);
+void semaphore_up(semaphore_t* sem);        /* Safe from IRQ handlers */
+
+/* ========== Condition Variables ========== */
+
+void condvar_init(condvar_t* cv);
+
+/* Drop the mutex, sleep until signalled, retake it; re-test the predicate */
+void condvar_wait(condvar_t* cv, mutex_t* mutex);
+void condvar_signal(condvar_t* cv);
+void condvar_broadcast(condvar_t* cv);
+
+/* ========== Statistics ========== */
+
+/* First registered lock; follow ->next for the rest */
+lock_stats_t* lock_stats_first(void);
+
+/* Zero every registered lock's counters */
+void lock_stats_reset(void);
+
+#endif /* SYNC_H */
@@ -8,6 +8,7 @@
 #define SYSCALL_H
 
 #include "types.h"
+#include "ioring.h"
 
 /* System call numbers */
 #define SYS_EXIT        0
@@ -26,16 +27,79 @@
 #define SYS_YIELD       13
 #define SYS_KILL        14
 #define SYS_STAT        15
+#define SYS_IORING_SETUP   16
+#define SYS_IORING_ENTER   17
+#define SYS_IORING_DESTROY 18
+#define SYS_FUTEX       19
+#define SYS_BATCH       20
+#define SYS_PIPE        21
+#define SYS_SHM_OPEN    22
+#define SYS_SHM_CLOSE   23
+#define SYS_SHM_MAP     24
+
+/* SYS_BATCH: at most this many calls per entry */
+#define BATCH_MAX           64
+
+/* SYS_BATCH flags */
+#define BATCH_STOP_ON_ERROR 0x01    /* Skip the rest after a negative result */
+
+/* One call of a batch; result is written back as the call returns */
+typedef struct {
+    uint32_t num;
+    uint32_t args[5];
+    int32_t  result;
+} syscall_req_t;
 
 /* System call interrupt number */
 #define SYSCALL_INT     0x80
 
+/* SYSENTER target MSRs, and the CPUID.1:EDX bit that says they exist */
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+#define CPUID_EDX_SEP       0x00000800
+
 /* Initialize system calls */
 void syscall_init(void);
 
+/* Point this CPU's SYSENTER MSRs at the kernel (APs; the BSP's is in syscall_init) */
+void syscall_init_cpu(void);
+
+/* True if programs may use SYSENTER instead of int 0x80 */
+bool syscall_fast_available(void);
+
 /* System call handler */
 void syscall_handler(void);
 
+/* Run a system call from kernel context (returns -1 for unknown numbers) */
+int syscall_dispatch(uint32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                     uint32_t arg4, uint32_t arg5);
+
+/* ========== Statistics ========== */
+
+/* Latency histogram: bucket b counts calls of [2^b, 2^(b+1)) TSC cycles */
+#define SYSCALL_HIST_BUCKETS 32
+
+/* Counters for one system call, kept per CPU and summed on request */
+typedef struct {
+    uint32_t calls;                     /* Completed (exit never is) */
+    uint32_t errors;                    /* Negative results */
+    uint64_t cycles;                    /* Total time inside, for the mean */
+    uint32_t histogram[SYSCALL_HIST_BUCKETS];
+} syscall_stats_t;
+
+/* Highest system call number + 1 */
+uint32_t syscall_count(void);
+
+/* Short name of a system call, or NULL if num is not one */
+const char* syscall_name(uint32_t num);
+
+/* Every CPU's counters for num added up; false if num is not a system call */
+bool syscall_get_stats(uint32_t num, syscall_stats_t* stats);
+
+/* Zero every counter, to profile one workload */
+void syscall_stats_reset(void);
+
 /* System call implementations */
 void sys_exit(int code);
 int sys_write(int fd, const void* buf, uint32_t count);
@@ -53,6 +117,23 @@ void sys_free(void* ptr);
 void sys_yield(void);
 int sys_kill(uint32_t pid, int signal);
 
+io_ring_t* sys_ioring_setup(uint32_t flags);
+int sys_ioring_enter(io_ring_t* ring, uint32_t to_submit);
+int sys_ioring_destroy(io_ring_t* ring);
+
+int sys_futex(volatile uint32_t* addr, uint32_t op, uint32_t val, uint32_t timeout_ms);
+
+/* Run count calls in one kernel entry; returns how many ran */
+int sys_batch(syscall_req_t* reqs, uint32_t count, uint32_t flags);
+
+/* fds[0] reads, fds[1] writes; read, write and close take both */
+int sys_pipe(int fds[2]);
+
+/* Named shared memory: open (creating with size bytes), close, map (NULL on failure) */
+int sys_shm_open(const char* name, uint32_t size);
+int sys_shm_close(int id);
+void* sys_shm_map(int id);
+
 /* User-space syscall wrappers (inline assembly) */
 static inline int syscall0(int num) {
     int ret;
@@ -94,4 +175,37 @@ static inline int syscall3(int num, uint32_t arg1, uint32_t arg2, uint32_t arg3)
     return ret;
 }
 
+static inline int syscall4(int num, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    int ret;
+    __asm__ volatile(
+        "int $0x80"
+        : "=a"(ret)
+        : "a"(num), "b"(arg1), "c"(arg2), "d"(arg3), "S"(arg4)
+    );
+    return ret;
+}
+
+/*
+ * The SYSENTER path takes the same registers as int 0x80, except that
+ * SYSEXIT needs ecx and edx for the return esp and eip: arg2 and arg3
+ * go on the user stack instead, where ecx points on entry
+ */
+static inline int sysenter3(int num, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    int ret;
+    __asm__ volatile(
+        "push %%edx\n\t"
+        "push %%ecx\n\t"
+        "mov %%esp, %%ecx\n\t"
+        "mov $1f, %%edx\n\t"
+        "sysenter\n"
+        "1:\n\t"
+        "pop %%ecx\n\t"
+        "pop %%edx"
+        : "=a"(ret), "+c"(arg2), "+d"(arg3)
+        : "a"(num), "b"(arg1)
+        : "memory"
+    );
+    return ret;
+}
+
 #endif /* SYSCALL_H */
@@ -0,0 +1,39 @@
+/*
+ * NightOS - User Memory Access
+ * 
+ * The way system calls read and write memory a program passed in: one
+ * range check, then a plain copy. A bad pointer inside the range is
+ * caught by the page fault handler through an exception table instead
+ * of by walking the page tables first.
+ */
+
+#ifndef UACCESS_H
+#define UACCESS_H
+
+#include "types.h"
+#include "idt.h"
+
+/* Longest path a system call takes, terminator included */
+#define USER_PATH_MAX       128
+
+/*
+ * True if [addr, addr + size) is memory the caller may hand the kernel:
+ * inside the user region for a program; anything for a kernel thread,
+ * whose "user" pointers are its own
+ */
+bool access_ok(const void* addr, uint32_t size);
+
+/* 0, or -EFAULT if any byte could not be read or written */
+int copy_from_user(void* dst, const void* src, uint32_t size);
+int copy_to_user(void* dst, const void* src, uint32_t size);
+
+/*
+ * Copy a string of at most size bytes, terminator included. Returns its
+ * length, size if it did not fit (dst is then unterminated), or -EFAULT.
+ */
+int strncpy_from_user(char* dst, const char* src, uint32_t size);
+
+/* Page fault in one of the copy routines: resume at its fixup; false if not ours */
+bool uaccess_fixup(registers_t* regs);
+
+#endif /* UACCESS_H */
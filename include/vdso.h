@@ -0,0 +1,107 @@
+/*
+ * NightOS - vDSO Data Page
+ * 
+ * One read-only page mapped into every program at VDSO_ADDR, which the
+ * kernel keeps current on each tick and context switch, so programs
+ * can read the time and their PID without a system call
+ */
+
+#ifndef VDSO_H
+#define VDSO_H
+
+#include "types.h"
+#include "config.h"
+#include "paging.h"
+#include "gdt.h"
+#include "smp.h"
+
+/* Just below the user stack; program images must end beneath it */
+#define VDSO_ADDR           (USER_TOP - USER_STACK_SIZE - PAGE_SIZE)
+
+/* What each CPU is running; rewritten by that CPU on every switch */
+typedef struct vdso_cpu {
+    volatile uint32_t switches;         /* Bumped before pid changes */
+    volatile uint32_t pid;
+} vdso_cpu_t;
+
+/* Layout of the page (an ABI: only ever append) */
+typedef struct vdso_data {
+    volatile uint32_t sequence;         /* Odd while the clock below changes */
+    uint32_t ticks;                     /* Timer ticks since boot */
+    uint32_t tick_hz;                   /* Ticks per second */
+    uint32_t tsc_per_tick;              /* TSC cycles per tick, 0 until measured */
+    uint64_t tick_tsc;                  /* TSC at the last tick */
+    vdso_cpu_t cpus[SMP_MAX_CPUS];
+} vdso_data_t;
+
+/* A consistent copy of the clock fields */
+typedef struct {
+    uint32_t ticks;
+    uint32_t tick_hz;
+    uint32_t tsc_per_tick;
+    uint64_t tick_tsc;
+} vdso_clock_t;
+
+/* ========== Kernel Side ========== */
+
+/* Allocate and clear the page (after vmm_init) */
+void vdso_init(void);
+
+/* Frame that every program maps at VDSO_ADDR */
+uint32_t vdso_frame(void);
+
+/* Publish a tick (BSP only, so the sequence needs no writer lock) */
+void vdso_tick(uint32_t ticks, uint64_t tsc, uint32_t tsc_per_tick);
+
+/* Publish the process this CPU is about to run */
+void vdso_switch(uint32_t cpu, uint32_t pid);
+
+/* ========== Program Side ========== */
+
+static inline const vdso_data_t* vdso_data(void) {
+    return (const vdso_data_t*)VDSO_ADDR;
+}
+
+/* Index of the CPU we run on (may be stale as soon as it returns) */
+static inline uint32_t vdso_getcpu(void) {
+    uint32_t cpu;
+    __asm__ volatile("lsl %1, %0" : "=r"(cpu) : "r"((uint32_t)GDT_USER_CPU));
+    return cpu;
+}
+
+/* Copy the clock, retrying while a tick rewrites it */
+static inline void vdso_read_clock(vdso_clock_t* clock) {
+    const vdso_data_t* data = vdso_data();
+    uint32_t seq;
+    do {
+        while ((seq = data->sequence) & 1) {
+            __asm__ volatile("pause");
+        }
+        __asm__ volatile("" : : : "memory");
+        clock->ticks = data->ticks;
+        clock->tick_hz = data->tick_hz;
+        clock->tsc_per_tick = data->tsc_per_tick;
+        clock->tick_tsc = data->tick_tsc;
+        __asm__ volatile("" : : : "memory");
+    } while (data->sequence != seq);
+}
+
+/*
+ * Our PID, from the slot of the CPU we are on. If that CPU switched
+ * while we read, or we moved, read again: an unchanged switch count on
+ * the same CPU means we ran there throughout.
+ */
+static inline uint32_t vdso_getpid(void) {
+    const vdso_data_t* data = vdso_data();
+    uint32_t cpu, switches, pid;
+    do {
+        cpu = vdso_getcpu();
+        switches = data->cpus[cpu].switches;
+        __asm__ volatile("" : : : "memory");
+        pid = data->cpus[cpu].pid;
+        __asm__ volatile("" : : : "memory");
+    } while (vdso_getcpu() != cpu || data->cpus[cpu].switches != switches);
+    return pid;
+}
+
+#endif /* VDSO_H */
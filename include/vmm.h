@@ -0,0 +1,125 @@
+/*
+ * NightOS - Virtual Memory
+ * 
+ * Per-process address spaces for programs: a private user region
+ * backed by reference-counted frames, filled in on first touch and
+ * shared copy-on-write across fork
+ */
+
+#ifndef VMM_H
+#define VMM_H
+
+#include "types.h"
+#include "paging.h"
+#include "idt.h"
+
+/* Area flags */
+#define VMA_READ            0x01
+#define VMA_WRITE           0x02
+#define VMA_EXEC            0x04
+#define VMA_VDSO            0x08        /* The shared vDSO page, not a private one */
+#define VMA_SHM             0x10        /* A shared memory segment: never copied on write */
+#define VMA_PINNED          0x20        /* A page the kernel shares (mm_map_frame) */
+
+struct exec_image;
+struct shm_segment;
+
+/* A page-aligned run of addresses, zero-filled or backed by an executable */
+typedef struct vm_area {
+    uint32_t start;                     /* [start, end) */
+    uint32_t end;
+    uint32_t flags;
+    struct exec_image* image;           /* NULL: zero-filled */
+    uint32_t file_vaddr;                /* File bytes cover [file_vaddr, +file_size) */
+    uint32_t file_size;
+    uint32_t file_offset;               /* ...starting at this offset in the image */
+    struct shm_segment* shm;            /* VMA_SHM: the segment mapped here */
+    struct vm_area* next;               /* Ascending order */
+} vm_area_t;
+
+/* A program's address space; changed only by the process that owns it */
+typedef struct mm {
+    uint32_t* directory;                /* Page directory (an identity-mapped frame) */
+    vm_area_t* areas;
+    uint32_t resident;                  /* Pages mapped */
+    uint32_t faults;                    /* Pages filled on first touch */
+    uint32_t cow_copies;                /* Shared pages copied on write */
+    struct mm* dead_next;               /* mm_destroy_later list */
+} mm_t;
+
+/* Frame pool statistics */
+typedef struct {
+    uint32_t total;
+    uint32_t free;
+    uint32_t shared;                    /* Held by more than one address space */
+} frame_stats_t;
+
+/* Set up the frame pool (paging must be on) */
+void vmm_init(void);
+
+/* ========== Frames ========== */
+
+/* A frame with one reference, or 0 when the pool is exhausted */
+uint32_t frame_alloc(void);
+void frame_get(uint32_t frame);
+void frame_put(uint32_t frame);
+void frame_get_stats(frame_stats_t* stats);
+
+/* ========== Address Spaces ========== */
+
+/* An empty user region over the kernel mappings, or NULL */
+mm_t* mm_create(void);
+
+/* Free everything; mm must not be loaded on any CPU */
+void mm_destroy(mm_t* mm);
+
+/*
+ * mm_destroy for callers holding spinlocks (mm_destroy may sleep): the
+ * next mm_create, which runs in process context, does the work
+ */
+void mm_destroy_later(mm_t* mm);
+
+/* Copy-on-write duplicate of the calling process's address space */
+mm_t* mm_clone(mm_t* parent);
+
+/* Add a copy of area (taking image and segment references); fails if it overlaps */
+int mm_add_area(mm_t* mm, const vm_area_t* area);
+vm_area_t* mm_find_area(mm_t* mm, uint32_t addr);
+
+/* Lowest free run of size bytes at or above from, below the vDSO; 0 if none */
+uint32_t mm_find_gap(mm_t* mm, uint32_t from, uint32_t size);
+
+/* Map the vDSO page read-only at VDSO_ADDR */
+int mm_map_vdso(mm_t* mm);
+
+/*
+ * Map frame read-write at page, where the kernel keeps using it through
+ * its identity mapping: the page is never copied on write or lent, and
+ * holds a reference on the frame until mm is destroyed
+ */
+int mm_map_frame(mm_t* mm, uint32_t page, uint32_t frame);
+
+/* Copy into mm's memory; it need not be the loaded address space */
+int mm_copy_out(mm_t* mm, uint32_t dst, const void* src, uint32_t size);
+
+/*
+ * Reference to the frame behind a page of mm, for the kernel to read
+ * later: the page becomes copy-on-write, so what the frame holds stays
+ * as it is now. 0 if the page cannot be lent (shared memory included).
+ */
+uint32_t mm_lend_page(mm_t* mm, uint32_t page);
+
+/* Page directory to load for a process (the kernel's if it has no mm) */
+static inline uint32_t mm_cr3(const mm_t* mm) {
+    return mm ? (uint32_t)mm->directory : paging_kernel_directory();
+}
+
+/*
+ * Page fault at addr: fill or copy the page if it lies in one of the
+ * current process's areas. Returns false for faults outside the user
+ * region; a bad access inside it kills the process, unless a uaccess
+ * copy made it (that copy fails with -EFAULT instead).
+ */
+bool vmm_handle_fault(registers_t* regs, uint32_t addr);
+
+#endif /* VMM_H */
@@ -0,0 +1,108 @@
+/*
+ * NightOS - Wait Queues
+ * 
+ * Lists of processes sleeping until an event. A waiter queues itself
+ * before testing its condition, so a wake_up from another CPU or an
+ * IRQ handler can never slip in between the test and the sleep.
+ */
+
+#ifndef WAIT_H
+#define WAIT_H
+
+#include "types.h"
+
+struct process;
+
+/* Waiting processes, linked through their PCBs; exclusive ones at the tail */
+typedef struct wait_queue {
+    struct process* head;
+    struct process* tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT     { NULL, NULL }
+
+void wait_queue_init(wait_queue_t* wq);
+
+/* True if anyone is waiting (a hint; take no action on it without a barrier) */
+static inline bool wait_queue_active(const wait_queue_t* wq) {
+    return wq->head != NULL;
+}
+
+/* ========== Sleeping ========== */
+
+/*
+ * Low-level protocol behind the wait_event macros: queue (and mark
+ * ourselves blocked), test, sleep if still false, repeat, finish.
+ * prepare_to_wait leaves preemption disabled so a tick can't put us to
+ * sleep before the test; the condition must not sleep itself.
+ * Exclusive waiters are woken one per wake_up; the rest all at once.
+ */
+void prepare_to_wait(wait_queue_t* wq, bool exclusive);
+void wait_schedule(void);
+
+/* Leave the queue; true if a wake_up took us off it (not a timeout) */
+bool finish_wait(wait_queue_t* wq);
+
+/* As prepare_to_wait, but the timer also wakes us at tick `deadline` */
+void prepare_to_wait_until(wait_queue_t* wq, bool exclusive, uint32_t deadline);
+
+/*
+ * Exclusive wait for one event among many sharing a queue (a hash
+ * bucket); only wake_up_key with the same nonzero key wakes us. Keys
+ * are 64 bits so a futex can name its address space as well as its
+ * address.
+ */
+void prepare_to_wait_key(wait_queue_t* wq, uint64_t key, bool timed, uint32_t deadline);
+
+/* Tick `ms` milliseconds from now, and whether a deadline has passed */
+uint32_t wait_deadline(uint32_t ms);
+bool wait_expired(uint32_t deadline);
+
+#define __wait_event(wq, condition, exclusive) \
+    do { \
+        while (1) { \
+            prepare_to_wait(&(wq), (exclusive)); \
+            if (condition) break; \
+            wait_schedule(); \
+        } \
+        finish_wait(&(wq)); \
+    } while (0)
+
+/* Sleep until condition is true; it is re-tested after every wake-up */
+#define wait_event(wq, condition)   __wait_event(wq, condition, false)
+
+/* As wait_event, but only one exclusive waiter is woken per wake_up */
+#define wait_event_exclusive(wq, condition) __wait_event(wq, condition, true)
+
+/* As wait_event with a limit; evaluates to true if condition became true */
+#define wait_event_timeout(wq, condition, ms) \
+    ({ \
+        uint32_t __deadline = wait_deadline(ms); \
+        bool __done; \
+        while (1) { \
+            prepare_to_wait_until(&(wq), false, __deadline); \
+            if ((__done = (condition))) break; \
+            if (wait_expired(__deadline)) break; \
+            wait_schedule(); \
+        } \
+        finish_wait(&(wq)); \
+        __done; \
+    })
+
+/* ========== Waking ========== */
+
+/* Wake every non-exclusive waiter and up to nr exclusive ones; returns how many woke */
+uint32_t wake_up_nr(wait_queue_t* wq, uint32_t nr);
+
+/* As wake_up_nr, but only waiters queued with this key */
+uint32_t wake_up_key(wait_queue_t* wq, uint64_t key, uint32_t nr);
+
+static inline uint32_t wake_up(wait_queue_t* wq) {
+    return wake_up_nr(wq, 1);
+}
+
+static inline uint32_t wake_up_all(wait_queue_t* wq) {
+    return wake_up_nr(wq, 0xFFFFFFFF);
+}
+
+#endif /* WAIT_H */
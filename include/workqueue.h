@@ -0,0 +1,76 @@
+/*
+ * NightOS - Kernel Work Queues
+ * 
+ * Deferred work executed by per-queue kernel worker threads
+ */
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "types.h"
+#include "process.h"
+
+/* Work queue limits */
+#define WORKQUEUE_MAX       8
+#define WORKQUEUE_NAME_LEN  16
+
+/* Work item states */
+#define WORK_IDLE           0
+#define WORK_QUEUED         1       /* Waiting for the worker */
+#define WORK_DELAYED        2       /* Waiting for its timer */
+
+struct work;
+struct workqueue;
+
+/* Work callback; receives the item so it can find its container */
+typedef void (*work_fn_t)(struct work* work);
+
+/* A unit of deferred work, usually embedded in the object it is about */
+typedef struct work {
+    work_fn_t func;
+    struct work* next;
+    struct workqueue* wq;       /* Queue it is pending on */
+    uint32_t expires;           /* Tick at which delayed work is queued */
+    uint8_t state;              /* WORK_IDLE / WORK_QUEUED / WORK_DELAYED */
+} work_t;
+
+/* A FIFO of work drained by one kernel thread */
+typedef struct workqueue {
+    char name[WORKQUEUE_NAME_LEN];
+    work_t* head;
+    work_t* tail;
+    wait_queue_t more_work;     /* The worker sleeps here while empty */
+    uint32_t worker_pid;
+    uint32_t executed;          /* Items run so far */
+    bool in_use;
+} workqueue_t;
+
+/* Prepare a work item before its first use */
+static inline void work_init(work_t* work, work_fn_t func) {
+    work->func = func;
+    work->next = NULL;
+    work->wq = NULL;
+    work->expires = 0;
+    work->state = WORK_IDLE;
+}
+
+/* Initialize work queues and start the system "events" queue */
+void workqueue_init(void);
+
+/* Create a queue with its own worker thread at the given priority */
+workqueue_t* workqueue_create(const char* name, proc_priority_t priority);
+
+/* Shared queue for short, non-urgent work (NULL before init) */
+workqueue_t* system_workqueue(void);
+
+/* Queue work; false if it is already pending */
+bool queue_work(workqueue_t* wq, work_t* work);
+bool queue_delayed_work(workqueue_t* wq, work_t* work, uint32_t delay_ms);
+
+/* Take pending work off its queue or timer; true if it was pending */
+bool cancel_work(work_t* work);
+
+/* Move expired delayed work onto its queue (timer interrupt) */
+void workqueue_tick(uint32_t now);
+
+#endif /* WORKQUEUE_H */
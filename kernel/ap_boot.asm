@@ -0,0 +1,94 @@
+; NightOS - Application Processor Start-up (Assembly)
+; Real-mode entry copied below 1MB; takes an AP to protected mode and ap_main
+
+[BITS 16]
+
+AP_TRAMPOLINE_ADDR equ 0x80000     ; Must match config.h
+
+; Linear address of a trampoline label once copied into place
+%define AP_ADDR(label) (AP_TRAMPOLINE_ADDR + (label - ap_trampoline))
+
+; Handle MinGW naming convention (underscore prefix for C symbols)
+%ifdef MINGW
+global _ap_trampoline
+global _ap_trampoline_end
+global _ap_trampoline_stack
+global _ap_trampoline_cpu
+global _ap_trampoline_entry
+%define ap_trampoline _ap_trampoline
+%define ap_trampoline_end _ap_trampoline_end
+%define ap_trampoline_stack _ap_trampoline_stack
+%define ap_trampoline_cpu _ap_trampoline_cpu
+%define ap_trampoline_entry _ap_trampoline_entry
+%else
+global ap_trampoline
+global ap_trampoline_end
+global ap_trampoline_stack
+global ap_trampoline_cpu
+global ap_trampoline_entry
+%endif
+
+; ============================================
+; STARTUP IPI lands here with CS = AP_TRAMPOLINE_ADDR >> 4, IP = 0.
+; The BSP copies ap_trampoline..ap_trampoline_end to AP_TRAMPOLINE_ADDR
+; and fills in the stack, cpu and entry slots before each start-up.
+; ============================================
+ap_trampoline:
+    cli
+    cld
+
+    ; Addressing is relative to the trampoline page
+    mov ax, cs
+    mov ds, ax
+
+    lgdt [ap_gdt_descriptor - ap_trampoline]
+
+    mov eax, cr0
+    or eax, 0x1
+    mov cr0, eax
+
+    jmp dword 0x08:AP_ADDR(ap_protected)
+
+[BITS 32]
+ap_protected:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+    mov fs, ax
+    mov gs, ax
+
+    mov esp, [AP_ADDR(ap_trampoline_stack)]
+
+    ; ap_main(cpu) sets up this CPU's own GDT and never returns
+    push dword [AP_ADDR(ap_trampoline_cpu)]
+    call [AP_ADDR(ap_trampoline_entry)]
+
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+; ============================================
+; Temporary flat GDT (replaced by the CPU's own in ap_main)
+; ============================================
+align 8
+ap_gdt:
+    dq 0x0000000000000000        ; Null
+    dq 0x00CF9A000000FFFF        ; Code: base 0, limit 4GB, ring 0
+    dq 0x00CF92000000FFFF        ; Data: base 0, limit 4GB, ring 0
+ap_gdt_end:
+
+ap_gdt_descriptor:
+    dw ap_gdt_end - ap_gdt - 1
+    dd AP_ADDR(ap_gdt)
+
+; Filled in by smp.c before each STARTUP IPI
+align 4
+ap_trampoline_stack:
+    dd 0                         ; Top of the AP's boot stack
+ap_trampoline_cpu:
+    dd 0                         ; cpu_t* handed to ap_main
+ap_trampoline_entry:
+    dd 0                         ; Address of ap_main
+ap_trampoline_end:
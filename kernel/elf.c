@@ -0,0 +1,132 @@
+/*
+ * NightOS - ELF Loader Implementation
+ * 
+ * Only the headers are read at exec time. Each PT_LOAD segment becomes
+ * an area of the new address space that remembers where its bytes lie
+ * in the file; the page fault handler reads a page's share of them when
+ * the program first touches it, and the rest of the page (.bss) is
+ * zero. The file stays open until the last area backed by it is gone.
+ */
+
+#include "../include/elf.h"
+#include "../include/vmm.h"
+#include "../include/config.h"
+#include "../include/errno.h"
+#include "../include/fs.h"
+#include "../include/memory.h"
+#include "../include/sync.h"
+#include "../include/vdso.h"
+
+/* A handle has one file position, so a seek and its read go together */
+static mutex_t exec_mutex;
+
+/* Set up the loader */
+void elf_init(void) {
+    mutex_init(&exec_mutex, "exec");
+}
+
+/* ========== Images ========== */
+
+void image_get(exec_image_t* image) {
+    __sync_fetch_and_add(&image->refs, 1);
+}
+
+void image_put(exec_image_t* image) {
+    if (__sync_sub_and_fetch(&image->refs, 1) == 0) {
+        fs_close(image->handle);
+        kfree(image);
+    }
+}
+
+/* Read part of an image's file (process context; may sleep) */
+int image_read(exec_image_t* image, uint32_t offset, void* buffer, uint32_t size) {
+    mutex_lock(&exec_mutex);
+    int result = fs_seek(image->handle, offset);
+    if (result >= 0) {
+        result = fs_read(image->handle, buffer, size);
+    }
+    mutex_unlock(&exec_mutex);
+    
+    if (result < 0) return -EIO;
+    return (uint32_t)result == size ? result : -ENOEXEC;
+}
+
+/* ========== Loading ========== */
+
+/* Check the file header describes an i386 executable we can run */
+static bool elf_valid(const elf32_ehdr_t* ehdr) {
+    return *(const uint32_t*)ehdr->ident == ELF_MAGIC &&
+           ehdr->ident[4] == ELF_CLASS_32 &&
+           ehdr->ident[5] == ELF_DATA_LSB &&
+           ehdr->type == ELF_TYPE_EXEC &&
+           ehdr->machine == ELF_MACHINE_386 &&
+           ehdr->version == ELF_VERSION_CURRENT &&
+           ehdr->phentsize == sizeof(elf32_phdr_t) &&
+           ehdr->phnum > 0 && ehdr->phnum <= ELF_MAX_PHDRS;
+}
+
+/* Turn a PT_LOAD segment into an area backed by the image */
+static int elf_map_segment(mm_t* mm, exec_image_t* image, const elf32_phdr_t* phdr) {
+    if (phdr->memsz == 0) return 0;
+    if (phdr->filesz > phdr->memsz) return -ENOEXEC;
+    
+    uint32_t start = phdr->vaddr & PAGE_FRAME_MASK;
+    uint32_t end = ALIGN(phdr->vaddr + phdr->memsz, PAGE_SIZE);
+    if (start < USER_BASE || end <= start || end > VDSO_ADDR) {
+        return -ENOEXEC;
+    }
+    
+    vm_area_t area;
+    area.start = start;
+    area.end = end;
+    area.flags = ((phdr->flags & ELF_PF_R) ? VMA_READ : 0) |
+                 ((phdr->flags & ELF_PF_W) ? VMA_WRITE : 0) |
+                 ((phdr->flags & ELF_PF_X) ? VMA_EXEC : 0);
+    area.image = phdr->filesz ? image : NULL;
+    area.file_vaddr = phdr->vaddr;
+    area.file_size = phdr->filesz;
+    area.file_offset = phdr->offset;
+    area.shm = NULL;
+    area.next = NULL;
+    
+    return mm_add_area(mm, &area);
+}
+
+/* Add path's loadable segments to mm as file-backed areas */
+int elf_load(mm_t* mm, const char* path, uint32_t* entry) {
+    int handle = fs_open(path, FS_FLAG_READ);
+    if (handle < 0) return fs_exists(path) ? -ENFILE : -ENOENT;
+    
+    exec_image_t* image = (exec_image_t*)kmalloc(sizeof(exec_image_t));
+    if (!image) {
+        fs_close(handle);
+        return -ENOMEM;
+    }
+    image->handle = handle;
+    image->refs = 1;                    /* Ours, until the areas hold theirs */
+    
+    elf32_ehdr_t ehdr;
+    int result = image_read(image, 0, &ehdr, sizeof(ehdr));
+    if (result >= 0 && !elf_valid(&ehdr)) result = -ENOEXEC;
+    
+    for (uint32_t i = 0; result >= 0 && i < ehdr.phnum; i++) {
+        elf32_phdr_t phdr;
+        result = image_read(image, ehdr.phoff + i * sizeof(phdr), &phdr, sizeof(phdr));
+        if (result >= 0 && phdr.type == ELF_PT_LOAD) {
+            result = elf_map_segment(mm, image, &phdr);
+        }
+    }
+    
+    /* Execution must start in a segment that allows it */
+    if (result >= 0) {
+        vm_area_t* area = mm_find_area(mm, ehdr.entry);
+        if (!area || !(area->flags & VMA_EXEC)) {
+            result = -ENOEXEC;
+        } else {
+            *entry = ehdr.entry;
+        }
+    }
+    
+    image_put(image);
+    return result < 0 ? result : 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * NightOS - Program Execution
+ * 
+ * exec replaces the calling process's address space with a fresh one
+ * holding an ELF program and its arguments. The new space is built
+ * completely while the old one is still loaded, so a failure leaves
+ * the caller untouched. Only then does the process move to the top of
+ * its kernel stack, switch page directories, free the old space and
+ * drop to ring 3 at the entry point, which is called like
+ * main(argc, argv) and may simply return its exit status.
+ */
+
+#include "../include/process.h"
+#include "../include/vmm.h"
+#include "../include/elf.h"
+#include "../include/gdt.h"
+#include "../include/smp.h"
+#include "../include/config.h"
+#include "../include/errno.h"
+#include "../include/string.h"
+#include "../include/syscall.h"
+#include "../include/io.h"
+#include "../include/vdso.h"
+#include "../include/uaccess.h"
+#include "../include/memory.h"
+
+#define EXEC_MAX_ARGS       16
+#define EXEC_MAX_ARG_BYTES  PAGE_SIZE       /* Argument strings, all together */
+#define EXEC_STUB_SIZE      16
+
+/* Where the entry point returns to: exit(eax), copied to the top of the stack */
+static const uint8_t exit_stub[] = {
+    0x89, 0xC3,                             /* mov ebx, eax */
+    0xB8, SYS_EXIT, 0x00, 0x00, 0x00,       /* mov eax, SYS_EXIT */
+    0xCD, SYSCALL_INT                       /* int 0x80 */
+};
+
+/*
+ * Gather argv into strings, back to back; returns argc or an error.
+ * argv may be the caller's own memory, so it is read with uaccess.
+ */
+static int exec_gather_args(char* const argv[], char* strings) {
+    uint32_t argc = 0;
+    uint32_t bytes = 0;
+    while (argv) {
+        char* arg;
+        if (copy_from_user(&arg, &argv[argc], sizeof(arg)) < 0) return -EFAULT;
+        if (!arg) break;
+        if (argc == EXEC_MAX_ARGS) return -EINVAL;
+        
+        int len = strncpy_from_user(strings + bytes, arg, EXEC_MAX_ARG_BYTES - bytes);
+        if (len < 0) return len;
+        if ((uint32_t)len == EXEC_MAX_ARG_BYTES - bytes) return -EINVAL;
+        bytes += len + 1;
+        argc++;
+    }
+    return argc;
+}
+
+/* Copy the exit stub and argc strings onto the top of mm's stack; returns the entry esp, or 0 */
+static uint32_t exec_push_args(mm_t* mm, const char* strings, uint32_t argc) {
+    uint32_t stub = USER_TOP - EXEC_STUB_SIZE;
+    if (mm_copy_out(mm, stub, exit_stub, sizeof(exit_stub)) < 0) return 0;
+    
+    /* Strings below the stub, then the NULL-terminated pointer array */
+    uint32_t pointers[EXEC_MAX_ARGS + 1];
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < argc; i++) {
+        bytes += strlen(strings + bytes) + 1;
+    }
+    uint32_t sp = stub - bytes;
+    if (bytes && mm_copy_out(mm, sp, strings, bytes) < 0) return 0;
+    
+    bytes = 0;
+    for (uint32_t i = 0; i < argc; i++) {
+        pointers[i] = sp + bytes;
+        bytes += strlen(strings + bytes) + 1;
+    }
+    pointers[argc] = 0;
+    
+    sp = (sp - (argc + 1) * sizeof(uint32_t)) & ~0x3;
+    uint32_t array = sp;
+    if (mm_copy_out(mm, array, pointers, (argc + 1) * sizeof(uint32_t)) < 0) return 0;
+    
+    /* [stub][argc][argv], with argc on a 16-byte boundary as for any call */
+    uint32_t frame[3] = { stub, argc, array };
+    sp = ((sp - 2 * sizeof(uint32_t)) & ~0xF) - sizeof(uint32_t);
+    if (mm_copy_out(mm, sp, frame, sizeof(frame)) < 0) return 0;
+    return sp;
+}
+
+/* Name a process after the last component of the program's path */
+static void exec_set_name(process_t* proc, const char* path) {
+    const char* name = path;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/') name = p + 1;
+    }
+    strncpy(proc->name, name, PROCESS_NAME_LEN - 1);
+    proc->name[PROCESS_NAME_LEN - 1] = '\0';
+}
+
+/*
+ * Second half of exec, on the top of the kernel stack: nothing of the
+ * old address space is in use any more, so it can go
+ */
+static void __attribute__((noreturn)) exec_finish(mm_t* mm, uint32_t entry, uint32_t esp) {
+    process_t* proc = process_current();
+    mm_t* old = proc->mm;
+    
+    uint32_t flags = irq_save();
+    proc->mm = mm;
+    load_cr3(mm_cr3(mm));
+    gdt_set_kernel_stack(this_cpu(), (uint32_t)proc->stack + PROCESS_STACK_SIZE);
+    irq_restore(flags);
+    
+    if (old) mm_destroy(old);
+    exec_enter(esp, entry);
+}
+
+/* Give mm a stack with argv on it and the vDSO, and switch to it; returns only on failure */
+static int exec_start(mm_t* mm, uint32_t entry, const char* name, char* const argv[]) {
+    process_t* proc = process_current();
+    
+    vm_area_t stack;
+    memset(&stack, 0, sizeof(stack));
+    stack.start = USER_TOP - USER_STACK_SIZE;
+    stack.end = USER_TOP;
+    stack.flags = VMA_READ | VMA_WRITE | VMA_EXEC;      /* The exit stub runs here */
+    int result = mm_add_area(mm, &stack);
+    if (result >= 0) result = mm_map_vdso(mm);
+    
+    /* The arguments may be in the old address space, which is still loaded */
+    char* strings = NULL;
+    if (result >= 0) {
+        strings = (char*)kmalloc(EXEC_MAX_ARG_BYTES);
+        if (!strings) result = -ENOMEM;
+    }
+    if (result >= 0) result = exec_gather_args(argv, strings);
+    
+    uint32_t esp = 0;
+    if (result >= 0) {
+        esp = exec_push_args(mm, strings, result);
+        if (!esp) result = -ENOMEM;
+    }
+    kfree(strings);
+    if (result < 0) {
+        mm_destroy(mm);
+        return result;
+    }
+    
+    /* Past this point exec cannot fail */
+    exec_set_name(proc, name);
+    
+    /* Leave the old stack for the top of the kernel stack; nothing below is needed */
+    uint32_t top = (uint32_t)(proc->stack + PROCESS_STACK_SIZE) & ~0xF;
+    __asm__ volatile("mov %0, %%esp\n\t"
+                     "push %3\n\t"
+                     "push %2\n\t"
+                     "push %1\n\t"
+                     "call %P4"
+                     : : "r"(top), "r"(mm), "r"(entry), "r"(esp), "i"(exec_finish) : "memory");
+    __builtin_unreachable();
+}
+
+/* Replace the calling process's program; returns only on failure */
+int process_exec(const char* path, char* const argv[]) {
+    process_t* proc = process_current();
+    if (proc->pid == 0 || !proc->stack) return -EINVAL;
+    
+    mm_t* mm = mm_create();
+    if (!mm) return -ENOMEM;
+    
+    uint32_t entry = 0;
+    int result = elf_load(mm, path, &entry);
+    if (result < 0) {
+        mm_destroy(mm);
+        return result;
+    }
+    return exec_start(mm, entry, path, argv);
+}
+
+/* As process_exec, for position-independent code the kernel carries itself */
+int process_exec_code(const char* name, const void* code, uint32_t size, char* const argv[]) {
+    process_t* proc = process_current();
+    if (proc->pid == 0 || !proc->stack) return -EINVAL;
+    if (size == 0 || size > VDSO_ADDR - USER_BASE) return -EINVAL;
+    
+    mm_t* mm = mm_create();
+    if (!mm) return -ENOMEM;
+    
+    vm_area_t text;
+    memset(&text, 0, sizeof(text));
+    text.start = USER_BASE;
+    text.end = USER_BASE + ALIGN(size, PAGE_SIZE);
+    text.flags = VMA_READ | VMA_WRITE | VMA_EXEC;
+    int result = mm_add_area(mm, &text);
+    if (result >= 0) result = mm_copy_out(mm, USER_BASE, code, size);
+    if (result < 0) {
+        mm_destroy(mm);
+        return result;
+    }
+    return exec_start(mm, USER_BASE, name, argv);
+}
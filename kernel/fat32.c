@@ -0,0 +1,814 @@
+/*
+ * NightOS - FAT32 Filesystem Implementation
+ * 
+ * The root directory is parsed once at mount time (long names
+ * included) into an in-memory dentry table. FAT sectors go through a
+ * small write-back cache, and each open file's cluster chain is kept
+ * so sequential I/O never re-walks the FAT. The chain belongs to the
+ * dentry, not the handle: every handle on a file sees (and extends)
+ * the same one.
+ * 
+ * A file's new size and first cluster reach its directory entry only
+ * after the FAT has been flushed, so the disk never has an entry
+ * pointing at clusters its FAT still has as free.
+ */
+
+#include "../include/fat32.h"
+#include "../include/fs.h"
+#include "../include/ata.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+#include "../include/workqueue.h"
+#include "../include/io.h"
+
+/* Cluster chain (cached per open dentry and for the root directory) */
+typedef struct {
+    uint32_t* clusters;
+    uint32_t len;
+    uint32_t cap;
+} fat32_chain_t;
+
+/* In-memory directory entry */
+typedef struct {
+    bool in_use;
+    char name[FAT32_MAX_NAME];
+    uint8_t attr;
+    uint32_t cluster;               /* First cluster (0 for empty files) */
+    uint32_t size;
+    uint32_t dir_index;             /* Position of the short entry in root */
+    uint8_t lfn_count;              /* LFN entries right before it */
+    uint8_t open_count;
+    bool dirty;                     /* cluster/size newer than the entry on disk */
+    fat32_chain_t chain;            /* Loaded by the first open, freed by the last close */
+} fat32_dentry_t;
+
+/* Open file */
+typedef struct {
+    bool in_use;
+    int dentry;
+    uint32_t position;
+    uint8_t mode;
+} fat32_file_t;
+
+/* Cached FAT sector */
+typedef struct {
+    bool valid;
+    bool dirty;
+    uint32_t sector;                /* Relative to the first FAT */
+    uint32_t stamp;                 /* For LRU replacement */
+    uint8_t data[ATA_SECTOR_SIZE];
+} fat32_cache_t;
+
+/* Volume state */
+static struct {
+    bool mounted;
+    uint8_t drive;
+    uint32_t sectors_per_cluster;
+    uint32_t cluster_bytes;
+    uint32_t fat_lba;
+    uint32_t fat_size;
+    uint32_t num_fats;
+    uint32_t data_lba;
+    uint32_t total_clusters;
+    uint32_t root_cluster;
+    uint32_t free_hint;
+} vol;
+
+static fat32_dentry_t dentries[FAT32_MAX_DENTRIES];
+static int dentry_count = 0;
+static fat32_file_t open_files[FAT32_MAX_OPEN];
+static fat32_chain_t root_chain;
+static fat32_cache_t fat_cache[FAT32_CACHE_SECTORS];
+static uint32_t cache_clock = 0;
+static uint8_t sector_buf[ATA_SECTOR_SIZE];
+
+/* ========== Low-level helpers ========== */
+
+static uint32_t cluster_lba(uint32_t cluster) {
+    return vol.data_lba + (cluster - 2) * vol.sectors_per_cluster;
+}
+
+static int disk_read(uint32_t lba, uint8_t count, void* buffer) {
+    return ata_read_sectors(vol.drive, lba, count, buffer);
+}
+
+static int disk_write(uint32_t lba, uint8_t count, const void* buffer) {
+    return ata_write_sectors(vol.drive, lba, count, buffer);
+}
+
+/* Write a cached FAT sector back to every FAT copy */
+static int cache_writeback(fat32_cache_t* c) {
+    if (!c->valid || !c->dirty) return 0;
+    
+    for (uint32_t i = 0; i < vol.num_fats; i++) {
+        if (disk_write(vol.fat_lba + i * vol.fat_size + c->sector, 1, c->data) < 0) {
+            return -1;
+        }
+    }
+    c->dirty = false;
+    return 0;
+}
+
+/* Get a FAT sector through the cache */
+static fat32_cache_t* cache_get(uint32_t sector) {
+    fat32_cache_t* victim = &fat_cache[0];
+    
+    for (int i = 0; i < FAT32_CACHE_SECTORS; i++) {
+        fat32_cache_t* c = &fat_cache[i];
+        if (c->valid && c->sector == sector) {
+            c->stamp = ++cache_clock;
+            return c;
+        }
+        if (!c->valid) {
+            victim = c;
+        } else if (victim->valid && c->stamp < victim->stamp) {
+            victim = c;
+        }
+    }
+    
+    if (cache_writeback(victim) < 0) return NULL;
+    
+    victim->valid = false;
+    if (disk_read(vol.fat_lba + sector, 1, victim->data) < 0) return NULL;
+    
+    victim->valid = true;
+    victim->dirty = false;
+    victim->sector = sector;
+    victim->stamp = ++cache_clock;
+    return victim;
+}
+
+/* Flush all dirty FAT sectors */
+static int cache_flush(void) {
+    for (int i = 0; i < FAT32_CACHE_SECTORS; i++) {
+        if (cache_writeback(&fat_cache[i]) < 0) return -1;
+    }
+    return 0;
+}
+
+/* Deferred writeback of the FAT and file sizes, run by the events worker */
+static work_t writeback_work;
+
+/* Read a FAT entry */
+static uint32_t fat_get(uint32_t cluster) {
+    uint32_t offset = cluster * 4;
+    fat32_cache_t* c = cache_get(offset / ATA_SECTOR_SIZE);
+    if (!c) return FAT32_EOC;
+    
+    return *(uint32_t*)(c->data + offset % ATA_SECTOR_SIZE) & FAT32_MASK;
+}
+
+/* Write a FAT entry (top four bits are reserved and preserved) */
+static int fat_set(uint32_t cluster, uint32_t value) {
+    uint32_t offset = cluster * 4;
+    fat32_cache_t* c = cache_get(offset / ATA_SECTOR_SIZE);
+    if (!c) return -1;
+    
+    uint32_t* entry = (uint32_t*)(c->data + offset % ATA_SECTOR_SIZE);
+    *entry = (*entry & ~FAT32_MASK) | (value & FAT32_MASK);
+    c->dirty = true;
+    return 0;
+}
+
+/* Append a cluster to a chain cache */
+static int chain_push(fat32_chain_t* chain, uint32_t cluster) {
+    if (chain->len == chain->cap) {
+        uint32_t cap = chain->cap ? chain->cap * 2 : 8;
+        uint32_t* clusters = (uint32_t*)krealloc(chain->clusters, cap * sizeof(uint32_t));
+        if (!clusters) return -1;
+        chain->clusters = clusters;
+        chain->cap = cap;
+    }
+    chain->clusters[chain->len++] = cluster;
+    return 0;
+}
+
+/* Walk the FAT once and cache the whole chain */
+static int chain_load(fat32_chain_t* chain, uint32_t first) {
+    chain->len = 0;
+    
+    uint32_t cluster = first;
+    while (cluster >= 2 && cluster < FAT32_EOC) {
+        if (chain->len > vol.total_clusters) return -1;  /* Loop in the FAT */
+        if (chain_push(chain, cluster) < 0) return -1;
+        cluster = fat_get(cluster);
+    }
+    return 0;
+}
+
+static void chain_free(fat32_chain_t* chain) {
+    if (chain->clusters) {
+        kfree(chain->clusters);
+    }
+    chain->clusters = NULL;
+    chain->len = 0;
+    chain->cap = 0;
+}
+
+/* Allocate a free cluster and link it after the chain's last cluster */
+static uint32_t chain_extend(fat32_chain_t* chain) {
+    uint32_t limit = vol.total_clusters + 2;
+    uint32_t cluster = 0;
+    
+    for (uint32_t i = 0; i < vol.total_clusters; i++) {
+        uint32_t c = vol.free_hint + i;
+        if (c >= limit) c -= vol.total_clusters;
+        if (fat_get(c) == FAT32_FREE) {
+            cluster = c;
+            break;
+        }
+    }
+    if (!cluster) return 0;  /* Disk full */
+    
+    if (fat_set(cluster, FAT32_MASK) < 0) return 0;
+    if (chain->len > 0 && fat_set(chain->clusters[chain->len - 1], cluster) < 0) return 0;
+    if (chain_push(chain, cluster) < 0) return 0;
+    
+    vol.free_hint = cluster + 1 < limit ? cluster + 1 : 2;
+    return cluster;
+}
+
+/* Locate root directory entry number index on disk */
+static bool dir_locate(uint32_t index, uint32_t* lba, uint32_t* offset) {
+    uint32_t per_cluster = vol.cluster_bytes / sizeof(fat32_dirent_t);
+    uint32_t c = index / per_cluster;
+    if (c >= root_chain.len) return false;
+    
+    uint32_t byte = (index % per_cluster) * sizeof(fat32_dirent_t);
+    *lba = cluster_lba(root_chain.clusters[c]) + byte / ATA_SECTOR_SIZE;
+    *offset = byte % ATA_SECTOR_SIZE;
+    return true;
+}
+
+/* Read-modify-write one root directory entry */
+static int dir_update(uint32_t index, const fat32_dirent_t* entry, uint8_t first_byte) {
+    uint32_t lba, offset;
+    if (!dir_locate(index, &lba, &offset)) return -1;
+    if (disk_read(lba, 1, sector_buf) < 0) return -1;
+    
+    if (entry) {
+        memcpy(sector_buf + offset, entry, sizeof(fat32_dirent_t));
+    } else {
+        sector_buf[offset] = first_byte;
+    }
+    return disk_write(lba, 1, sector_buf);
+}
+
+/* ========== Names ========== */
+
+static char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static char to_upper(char c) {
+    return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+}
+
+/* FAT names are case-insensitive */
+static bool name_equal(const char* a, const char* b) {
+    while (*a && *b) {
+        if (to_lower(*a++) != to_lower(*b++)) return false;
+    }
+    return *a == *b;
+}
+
+/* Short name checksum stored in every LFN entry */
+static uint8_t lfn_checksum(const char* short_name) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++) {
+        sum = ((sum & 1) << 7) + (sum >> 1) + (uint8_t)short_name[i];
+    }
+    return sum;
+}
+
+/* Format "FOO     TXT" as "foo.txt"/"FOO.TXT" following the case flags */
+static void short_name_format(const fat32_dirent_t* e, char* out) {
+    int len = 0;
+    bool lower_base = e->nt_reserved & 0x08;
+    bool lower_ext = e->nt_reserved & 0x10;
+    
+    for (int i = 0; i < 8 && e->name[i] != ' '; i++) {
+        out[len++] = lower_base ? to_lower(e->name[i]) : e->name[i];
+    }
+    if (e->name[8] != ' ') {
+        out[len++] = '.';
+        for (int i = 8; i < 11 && e->name[i] != ' '; i++) {
+            out[len++] = lower_ext ? to_lower(e->name[i]) : e->name[i];
+        }
+    }
+    out[len] = '\0';
+}
+
+/* Build an 8.3 entry name; returns false if the name needs an LFN */
+static bool short_name_make(const char* name, char* out, uint8_t* case_flags) {
+    const char* dot = strchr(name, '.');
+    int base_len = dot ? (int)(dot - name) : (int)strlen(name);
+    int ext_len = dot ? (int)strlen(dot + 1) : 0;
+    
+    if (base_len == 0 || base_len > 8 || ext_len > 3) return false;
+    if (dot && strchr(dot + 1, '.')) return false;
+    
+    memset(out, ' ', 11);
+    *case_flags = 0x08 | 0x10;
+    bool has_upper_base = false, has_upper_ext = false;
+    
+    for (int i = 0; i < base_len + (dot ? ext_len + 1 : 0); i++) {
+        char c = name[i];
+        if (dot && name + i == dot) continue;
+        
+        bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                     (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '~';
+        if (!valid) return false;
+        
+        bool in_ext = dot && name + i > dot;
+        if (c >= 'A' && c <= 'Z') {
+            if (in_ext) has_upper_ext = true; else has_upper_base = true;
+        }
+        if (in_ext) {
+            out[8 + (name + i - dot - 1)] = to_upper(c);
+        } else {
+            out[i] = to_upper(c);
+        }
+    }
+    
+    if (has_upper_base) *case_flags &= ~0x08;
+    if (has_upper_ext) *case_flags &= ~0x10;
+    return true;
+}
+
+/* ========== Dentry layer ========== */
+
+static int dentry_find(const char* name) {
+    for (int i = 0; i < FAT32_MAX_DENTRIES; i++) {
+        if (dentries[i].in_use && name_equal(dentries[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int dentry_alloc(void) {
+    for (int i = 0; i < FAT32_MAX_DENTRIES; i++) {
+        if (!dentries[i].in_use) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Parse the root directory (short and long names) once */
+static void dentry_scan(void) {
+    char lfn[256];
+    int lfn_entries = 0;
+    uint8_t lfn_sum = 0;
+    bool lfn_valid = false;
+    uint32_t cached_lba = 0;
+    
+    memset(dentries, 0, sizeof(dentries));
+    dentry_count = 0;
+    
+    for (uint32_t index = 0; ; index++) {
+        uint32_t lba, offset;
+        if (!dir_locate(index, &lba, &offset)) break;
+        if (lba != cached_lba) {
+            if (disk_read(lba, 1, sector_buf) < 0) break;
+            cached_lba = lba;
+        }
+        
+        fat32_dirent_t* e = (fat32_dirent_t*)(sector_buf + offset);
+        uint8_t first = (uint8_t)e->name[0];
+        
+        if (first == 0x00) break;                   /* End of directory */
+        if (first == 0xE5) {                        /* Deleted */
+            lfn_valid = false;
+            continue;
+        }
+        
+        if (e->attr == FAT32_ATTR_LFN) {
+            fat32_lfn_t* l = (fat32_lfn_t*)e;
+            int seq = l->order & 0x1F;
+            if (l->order & 0x40) {
+                memset(lfn, 0, sizeof(lfn));
+                lfn_entries = 0;
+                lfn_sum = l->checksum;
+                lfn_valid = true;
+            }
+            if (!lfn_valid || seq < 1 || seq > 19 || l->checksum != lfn_sum) {
+                lfn_valid = false;
+                continue;
+            }
+            
+            /* Thirteen UCS-2 characters per entry, kept as ASCII */
+            uint16_t chars[13];
+            memcpy(chars, l->name1, sizeof(l->name1));
+            memcpy(chars + 5, l->name2, sizeof(l->name2));
+            memcpy(chars + 11, l->name3, sizeof(l->name3));
+            for (int i = 0; i < 13; i++) {
+                uint16_t ch = chars[i];
+                if (ch == 0x0000 || ch == 0xFFFF) break;
+                lfn[(seq - 1) * 13 + i] = ch < 0x80 ? (char)ch : '?';
+            }
+            lfn_entries++;
+            continue;
+        }
+        
+        bool use_lfn = lfn_valid && lfn_checksum(e->name) == lfn_sum;
+        int entries = use_lfn ? lfn_entries : 0;
+        lfn_valid = false;
+        
+        if (e->attr & FAT32_ATTR_VOLUME_ID) continue;
+        if (first == '.') continue;                 /* "." and ".." */
+        
+        int slot = dentry_alloc();
+        if (slot < 0) break;
+        
+        fat32_dentry_t* d = &dentries[slot];
+        if (use_lfn && strlen(lfn) < FAT32_MAX_NAME) {
+            strcpy(d->name, lfn);
+        } else {
+            short_name_format(e, d->name);          /* Too long: 8.3 alias */
+        }
+        d->in_use = true;
+        d->attr = e->attr;
+        d->cluster = ((uint32_t)e->cluster_high << 16) | e->cluster_low;
+        d->size = e->size;
+        d->dir_index = index;
+        d->lfn_count = entries;
+        dentry_count++;
+    }
+}
+
+/* Write a dentry's cluster and size back to its directory entry */
+static int dentry_sync(fat32_dentry_t* d) {
+    uint32_t lba, offset;
+    if (!dir_locate(d->dir_index, &lba, &offset)) return -1;
+    if (disk_read(lba, 1, sector_buf) < 0) return -1;
+    
+    fat32_dirent_t* e = (fat32_dirent_t*)(sector_buf + offset);
+    e->cluster_high = (uint16_t)(d->cluster >> 16);
+    e->cluster_low = (uint16_t)d->cluster;
+    e->size = d->size;
+    return disk_write(lba, 1, sector_buf);
+}
+
+/*
+ * Write back the FAT, then the directory entries that changed. In that
+ * order, an entry on disk never points at clusters the FAT on disk
+ * still has as free.
+ */
+static int fat32_sync(void) {
+    if (cache_flush() < 0) return -1;
+    
+    for (int i = 0; i < FAT32_MAX_DENTRIES; i++) {
+        fat32_dentry_t* d = &dentries[i];
+        if (!d->in_use || !d->dirty) continue;
+        if (dentry_sync(d) < 0) return -1;
+        d->dirty = false;
+    }
+    return 0;
+}
+
+static void fat32_writeback(work_t* work) {
+    UNUSED(work);
+    
+    /* Writers hold the filesystem lock while they dirty sectors */
+    fs_lock();
+    fat32_sync();
+    fs_unlock();
+}
+
+/* ========== Mount ========== */
+
+/* Check that a boot sector holds a FAT32 BPB we can handle */
+static bool bpb_valid(const fat32_bpb_t* bpb) {
+    return bpb->bytes_per_sector == ATA_SECTOR_SIZE &&
+           bpb->sectors_per_cluster != 0 &&
+           bpb->num_fats != 0 &&
+           bpb->fat_size_16 == 0 && bpb->fat_size_32 != 0 &&
+           bpb->root_entries == 0;
+}
+
+/* Mount the FAT32 volume on an ATA drive (whole disk or first FAT partition) */
+int fat32_mount(uint8_t drive) {
+    static uint8_t boot[ATA_SECTOR_SIZE];
+    uint32_t part_lba = 0;
+    
+    vol.mounted = false;
+    vol.drive = drive;
+    
+    cancel_work(&writeback_work);
+    work_init(&writeback_work, fat32_writeback);
+    
+    if (!ata_present(drive)) return -1;
+    if (disk_read(0, 1, boot) < 0) return -2;
+    if (boot[510] != 0x55 || boot[511] != 0xAA) return -3;
+    
+    if (!bpb_valid((fat32_bpb_t*)boot)) {
+        /* Look for a FAT32 partition in the MBR */
+        for (int i = 0; i < 4 && !part_lba; i++) {
+            uint8_t* p = boot + 446 + i * 16;
+            if (p[4] == 0x0B || p[4] == 0x0C) {
+                part_lba = *(uint32_t*)(p + 8);
+            }
+        }
+        if (!part_lba || disk_read(part_lba, 1, boot) < 0) return -3;
+        if (!bpb_valid((fat32_bpb_t*)boot)) return -3;
+    }
+    
+    fat32_bpb_t* bpb = (fat32_bpb_t*)boot;
+    vol.sectors_per_cluster = bpb->sectors_per_cluster;
+    vol.cluster_bytes = bpb->sectors_per_cluster * ATA_SECTOR_SIZE;
+    vol.fat_lba = part_lba + bpb->reserved_sectors;
+    vol.fat_size = bpb->fat_size_32;
+    vol.num_fats = bpb->num_fats;
+    vol.data_lba = vol.fat_lba + vol.num_fats * vol.fat_size;
+    vol.total_clusters = (bpb->total_sectors_32 - (vol.data_lba - part_lba)) /
+                         vol.sectors_per_cluster;
+    vol.root_cluster = bpb->root_cluster;
+    vol.free_hint = 2;
+    
+    memset(fat_cache, 0, sizeof(fat_cache));
+    memset(open_files, 0, sizeof(open_files));
+    chain_free(&root_chain);
+    if (chain_load(&root_chain, vol.root_cluster) < 0) return -4;
+    
+    dentry_scan();
+    vol.mounted = true;
+    return 0;
+}
+
+bool fat32_mounted(void) {
+    return vol.mounted;
+}
+
+/* ========== Directory operations ========== */
+
+int fat32_count(void) {
+    return vol.mounted ? dentry_count : 0;
+}
+
+/* Fill entry from dentry slot index: 1 if used, 0 if empty, -1 past end */
+int fat32_dentry(int index, fs_dirent_t* entry) {
+    if (!vol.mounted || index < 0 || index >= FAT32_MAX_DENTRIES) return -1;
+    if (!dentries[index].in_use) return 0;
+    
+    strncpy(entry->name, dentries[index].name, FS_MAX_FILENAME);
+    entry->type = (dentries[index].attr & FAT32_ATTR_DIRECTORY) ?
+                  FS_TYPE_DIRECTORY : FS_TYPE_FILE;
+    entry->size = dentries[index].size;
+    return 1;
+}
+
+bool fat32_exists(const char* name) {
+    return vol.mounted && dentry_find(name) >= 0;
+}
+
+uint32_t fat32_size(const char* name) {
+    int d = vol.mounted ? dentry_find(name) : -1;
+    return d >= 0 ? dentries[d].size : 0;
+}
+
+/* Create an empty file with an 8.3 name in the root directory */
+int fat32_create(const char* name) {
+    if (!vol.mounted) return -1;
+    if (dentry_find(name) >= 0) return -2;  /* Already exists */
+    
+    fat32_dirent_t entry;
+    memset(&entry, 0, sizeof(entry));
+    if (!short_name_make(name, entry.name, &entry.nt_reserved)) return -3;
+    entry.attr = FAT32_ATTR_ARCHIVE;
+    
+    int slot = dentry_alloc();
+    if (slot < 0) return -4;
+    
+    /* Find a free directory entry, growing the root if needed */
+    uint32_t index = 0;
+    uint32_t cached_lba = 0;
+    for (;; index++) {
+        uint32_t lba, offset;
+        if (!dir_locate(index, &lba, &offset)) {
+            uint32_t cluster = chain_extend(&root_chain);
+            if (!cluster || cache_flush() < 0) return -5;
+            
+            memset(sector_buf, 0, sizeof(sector_buf));
+            for (uint32_t s = 0; s < vol.sectors_per_cluster; s++) {
+                disk_write(cluster_lba(cluster) + s, 1, sector_buf);
+            }
+            break;
+        }
+        if (lba != cached_lba) {
+            if (disk_read(lba, 1, sector_buf) < 0) return -5;
+            cached_lba = lba;
+        }
+        uint8_t first = sector_buf[offset];
+        if (first == 0x00 || first == 0xE5) break;
+    }
+    
+    if (dir_update(index, &entry, 0) < 0) return -5;
+    
+    fat32_dentry_t* d = &dentries[slot];
+    memset(d, 0, sizeof(*d));
+    short_name_format(&entry, d->name);
+    d->in_use = true;
+    d->attr = entry.attr;
+    d->dir_index = index;
+    dentry_count++;
+    return 0;
+}
+
+/* Delete a file and free its clusters */
+int fat32_delete(const char* name) {
+    if (!vol.mounted) return -1;
+    
+    int slot = dentry_find(name);
+    if (slot < 0) return -1;
+    
+    fat32_dentry_t* d = &dentries[slot];
+    if (d->attr & FAT32_ATTR_DIRECTORY) return -2;
+    if (d->open_count) return -3;
+    
+    /* Mark the short entry and its LFN entries deleted */
+    for (uint32_t i = d->dir_index - d->lfn_count; i <= d->dir_index; i++) {
+        if (dir_update(i, NULL, 0xE5) < 0) return -4;
+    }
+    
+    uint32_t cluster = d->cluster;
+    while (cluster >= 2 && cluster < FAT32_EOC) {
+        uint32_t next = fat_get(cluster);
+        fat_set(cluster, FAT32_FREE);
+        cluster = next;
+    }
+    if (d->cluster >= 2 && d->cluster < vol.free_hint) {
+        vol.free_hint = d->cluster;
+    }
+    cache_flush();
+    
+    memset(d, 0, sizeof(*d));
+    dentry_count--;
+    return 0;
+}
+
+/* ========== File I/O ========== */
+
+static fat32_file_t* file_get(int handle) {
+    if (handle < 0 || handle >= FAT32_MAX_OPEN) return NULL;
+    return open_files[handle].in_use ? &open_files[handle] : NULL;
+}
+
+int fat32_open(const char* name, uint8_t mode) {
+    if (!vol.mounted) return -1;
+    
+    int slot = dentry_find(name);
+    if (slot < 0) return -1;
+    if (dentries[slot].attr & FAT32_ATTR_DIRECTORY) return -2;
+    
+    for (int h = 0; h < FAT32_MAX_OPEN; h++) {
+        fat32_file_t* f = &open_files[h];
+        if (f->in_use) continue;
+        
+        fat32_dentry_t* d = &dentries[slot];
+        if (d->open_count == 0 && chain_load(&d->chain, d->cluster) < 0) {
+            chain_free(&d->chain);
+            return -4;
+        }
+        
+        memset(f, 0, sizeof(*f));
+        f->in_use = true;
+        f->dentry = slot;
+        f->mode = mode;
+        dentries[slot].open_count++;
+        return h;
+    }
+    return -3;
+}
+
+void fat32_close(int handle) {
+    fat32_file_t* f = file_get(handle);
+    if (!f) return;
+    
+    fat32_dentry_t* d = &dentries[f->dentry];
+    if (--d->open_count == 0) chain_free(&d->chain);
+    f->in_use = false;
+}
+
+int fat32_read(int handle, void* buffer, uint32_t size) {
+    fat32_file_t* f = file_get(handle);
+    if (!f) return -2;
+    if (!(f->mode & FS_FLAG_READ)) return -3;
+    
+    fat32_dentry_t* d = &dentries[f->dentry];
+    if (f->position >= d->size) return 0;  /* EOF */
+    if (f->position + size > d->size) {
+        size = d->size - f->position;
+    }
+    
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t left = size;
+    
+    while (left > 0) {
+        uint32_t index = f->position / vol.cluster_bytes;
+        if (index >= d->chain.len) break;  /* Chain shorter than size */
+        
+        uint32_t within = f->position % vol.cluster_bytes;
+        uint32_t lba = cluster_lba(d->chain.clusters[index]) + within / ATA_SECTOR_SIZE;
+        uint32_t offset = within % ATA_SECTOR_SIZE;
+        uint32_t n;
+        
+        if (offset == 0 && left >= ATA_SECTOR_SIZE) {
+            /* Whole sectors straight into the caller's buffer */
+            uint32_t sectors = MIN(left / ATA_SECTOR_SIZE,
+                                   vol.sectors_per_cluster - within / ATA_SECTOR_SIZE);
+            sectors = MIN(sectors, 255);
+            if (disk_read(lba, sectors, out) < 0) break;
+            n = sectors * ATA_SECTOR_SIZE;
+        } else {
+            if (disk_read(lba, 1, sector_buf) < 0) break;
+            n = MIN(ATA_SECTOR_SIZE - offset, left);
+            memcpy(out, sector_buf + offset, n);
+        }
+        
+        out += n;
+        left -= n;
+        f->position += n;
+    }
+    
+    return size - left;
+}
+
+int fat32_write(int handle, const void* buffer, uint32_t size) {
+    fat32_file_t* f = file_get(handle);
+    if (!f) return -2;
+    if (!(f->mode & FS_FLAG_WRITE)) return -3;
+    if (size == 0) return 0;
+    
+    fat32_dentry_t* d = &dentries[f->dentry];
+    
+    /* Grow the chain to cover the write */
+    uint32_t needed = (f->position + size + vol.cluster_bytes - 1) / vol.cluster_bytes;
+    while (d->chain.len < needed) {
+        uint32_t cluster = chain_extend(&d->chain);
+        if (!cluster) break;  /* Disk full: write what fits */
+        if (d->chain.len == 1) {
+            d->cluster = cluster;
+            d->dirty = true;
+        }
+    }
+    uint32_t capacity = d->chain.len * vol.cluster_bytes;
+    if (f->position >= capacity) {
+        fat32_sync();
+        return -4;
+    }
+    if (f->position + size > capacity) {
+        size = capacity - f->position;
+    }
+    
+    const uint8_t* in = (const uint8_t*)buffer;
+    uint32_t left = size;
+    
+    while (left > 0) {
+        uint32_t index = f->position / vol.cluster_bytes;
+        uint32_t within = f->position % vol.cluster_bytes;
+        uint32_t lba = cluster_lba(d->chain.clusters[index]) + within / ATA_SECTOR_SIZE;
+        uint32_t offset = within % ATA_SECTOR_SIZE;
+        uint32_t n;
+        
+        if (offset == 0 && left >= ATA_SECTOR_SIZE) {
+            uint32_t sectors = MIN(left / ATA_SECTOR_SIZE,
+                                   vol.sectors_per_cluster - within / ATA_SECTOR_SIZE);
+            sectors = MIN(sectors, 255);
+            if (disk_write(lba, sectors, in) < 0) break;
+            n = sectors * ATA_SECTOR_SIZE;
+        } else {
+            /* Partial sector: read-modify-write */
+            n = MIN(ATA_SECTOR_SIZE - offset, left);
+            if (disk_read(lba, 1, sector_buf) < 0) break;
+            memcpy(sector_buf + offset, in, n);
+            if (disk_write(lba, 1, sector_buf) < 0) break;
+        }
+        
+        in += n;
+        left -= n;
+        f->position += n;
+    }
+    
+    if (f->position > d->size) {
+        d->size = f->position;
+        d->dirty = true;
+    }
+    
+    /* FAT and size updates are written back later, batching consecutive writes */
+    workqueue_t* wq = system_workqueue();
+    if (!wq || !queue_delayed_work(wq, &writeback_work, FAT32_WRITEBACK_MS)) {
+        if (writeback_work.state == WORK_IDLE) fat32_sync();
+    }
+    return size - left;
+}
+
+int fat32_seek(int handle, uint32_t position) {
+    fat32_file_t* f = file_get(handle);
+    if (!f) return -2;
+    
+    uint32_t size = dentries[f->dentry].size;
+    f->position = position > size ? size : position;
+    return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * NightOS - Lazy FPU/SSE Context Switching Implementation
+ * 
+ * Every switch sets CR0.TS instead of restoring FPU registers. The first
+ * FPU or SSE instruction a process runs afterwards raises #NM (ISR 7),
+ * and only then is its state restored. A process that used the FPU in
+ * its slice is saved when switched out, since it may resume on another
+ * CPU; processes that never touch the FPU never pay for it.
+ */
+
+#include "../include/fpu.h"
+#include "../include/idt.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+#include "../include/smp.h"
+#include "../include/io.h"
+
+/* Process whose state is live in each CPU's FPU registers */
+static process_t* owner[SMP_MAX_CPUS];
+
+/* FXSAVE available (otherwise FNSAVE/FRSTOR) */
+static bool fpu_fxsr = false;
+static bool fpu_present = false;
+
+/* Freshly initialized state handed to first-time users */
+static uint8_t fpu_default_state[FPU_STATE_SIZE] __attribute__((aligned(FPU_STATE_ALIGN)));
+
+/* ========== Low-level Helpers ========== */
+
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value));
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value));
+}
+
+static inline void fpu_clts(void) {
+    __asm__ volatile("clts");
+}
+
+static inline void fpu_stts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+/* Save live FPU state into a 16-byte aligned area */
+static void fpu_save(uint8_t* area) {
+    if (fpu_fxsr) {
+        __asm__ volatile("fxsave (%0)" : : "r"(area) : "memory");
+    } else {
+        __asm__ volatile("fnsave (%0); fwait" : : "r"(area) : "memory");
+    }
+}
+
+/* Load FPU state from a 16-byte aligned area */
+static void fpu_restore(const uint8_t* area) {
+    if (fpu_fxsr) {
+        __asm__ volatile("fxrstor (%0)" : : "r"(area) : "memory");
+    } else {
+        __asm__ volatile("frstor (%0)" : : "r"(area) : "memory");
+    }
+}
+
+/* Aligned view of a process's kmalloc'd save area */
+static uint8_t* fpu_area(process_t* proc) {
+    return (uint8_t*)ALIGN((uint32_t)proc->fpu_state, FPU_STATE_ALIGN);
+}
+
+/* ========== #NM Handler ========== */
+
+/* Device Not Available: hand the FPU to the current process */
+static void fpu_trap(registers_t* regs) {
+    UNUSED(regs);
+    
+    fpu_clts();
+    
+    uint32_t cpu = smp_cpu_id();
+    process_t* proc = process_current();
+    
+    /* Our registers are stale if we used the FPU on another CPU since */
+    if (owner[cpu] == proc && proc->fpu_cpu == cpu) return;
+    
+    /* The previous owner was saved when it was switched out */
+    if (!proc->fpu_state) {
+        proc->fpu_state = (uint8_t*)kmalloc(FPU_STATE_SIZE + FPU_STATE_ALIGN);
+        if (!proc->fpu_state) {
+            owner[cpu] = NULL;
+            fpu_restore(fpu_default_state);
+            return;
+        }
+        memcpy(fpu_area(proc), fpu_default_state, FPU_STATE_SIZE);
+    }
+    
+    fpu_restore(fpu_area(proc));
+    owner[cpu] = proc;
+    proc->fpu_cpu = cpu;
+    proc->fpu_uses++;
+}
+
+/* Set CR0/CR4 for native FPU errors and SSE on the calling CPU */
+static void fpu_enable(uint32_t edx) {
+    write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+    if (fpu_fxsr) {
+        uint32_t cr4 = read_cr4() | CR4_OSFXSR;
+        if (edx & CPUID_EDX_SSE) cr4 |= CR4_OSXMMEXCPT;
+        write_cr4(cr4);
+    }
+    __asm__ volatile("fninit");
+}
+
+/* ========== Public Interface ========== */
+
+/* Enable the FPU, SSE if present, and install the #NM handler */
+void fpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    
+    fpu_present = (edx & CPUID_EDX_FPU) != 0;
+    fpu_fxsr = (edx & CPUID_EDX_FXSR) != 0;
+    if (!fpu_present) return;
+    
+    fpu_enable(edx);
+    
+    /* Capture a clean state to seed every new FPU user */
+    fpu_save(fpu_default_state);
+    
+    memset(owner, 0, sizeof(owner));
+    register_interrupt_handler(7, fpu_trap);
+    
+    /* Nobody owns the FPU yet, so the first use traps */
+    fpu_stts();
+}
+
+/* Same CPU setup on an application processor */
+void fpu_init_cpu(void) {
+    if (!fpu_present) return;
+    
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    fpu_enable(edx);
+    fpu_stts();
+}
+
+/* Save prev if it used the FPU; trap the next use unless next owns it */
+void fpu_switch(process_t* prev, process_t* next) {
+    if (!fpu_present) return;
+    
+    uint32_t cpu = smp_cpu_id();
+    
+    /* TS clear means the owner ran FPU code this slice */
+    if (owner[cpu] == prev && !(read_cr0() & CR0_TS)) {
+        fpu_save(fpu_area(prev));
+        if (!fpu_fxsr) owner[cpu] = NULL;   /* FNSAVE reinitializes */
+    }
+    
+    if (next == owner[cpu] && next->fpu_cpu == cpu) {
+        fpu_clts();
+    } else {
+        fpu_stts();
+    }
+}
+
+/* Give a forked child a copy of the parent's (current) FPU state; false if out of memory */
+bool fpu_fork(process_t* parent, process_t* child) {
+    if (!fpu_present) return true;
+    
+    /* Live registers are newer than the save area */
+    uint32_t flags = irq_save();
+    uint32_t cpu = smp_cpu_id();
+    if (owner[cpu] == parent && !(read_cr0() & CR0_TS)) {
+        fpu_save(fpu_area(parent));
+        if (!fpu_fxsr) {
+            owner[cpu] = NULL;
+            fpu_stts();
+        }
+    }
+    irq_restore(flags);
+    
+    if (!parent->fpu_state) return true;
+    
+    child->fpu_state = (uint8_t*)kmalloc(FPU_STATE_SIZE + FPU_STATE_ALIGN);
+    if (!child->fpu_state) return false;
+    memcpy(fpu_area(child), fpu_area(parent), FPU_STATE_SIZE);
+    return true;
+}
+
+/* Forget a process's FPU state (exit/kill) */
+void fpu_release(process_t* proc) {
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        if (owner[i] == proc) {
+            owner[i] = NULL;
+        }
+    }
+    if (proc->fpu_state) {
+        kfree(proc->fpu_state);
+        proc->fpu_state = NULL;
+    }
+}
+
+/* Process holding this CPU's FPU registers, if any */
+process_t* fpu_owner(void) {
+    return owner[smp_cpu_id()];
+}
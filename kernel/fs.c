@@ -1,32 +1,269 @@
 /*
  * NightOS - Simple RAM Filesystem Implementation
  * 
- * In-memory filesystem for basic file operations
+ * In-memory filesystem for basic file operations. The public calls
+ * are thin wrappers that take a mutex around the *_locked bodies, so
+ * a process waiting for the filesystem sleeps instead of spinning.
  */
 
 #include "../include/fs.h"
+#include "../include/config.h"
 #include "../include/memory.h"
 #include "../include/string.h"
 #include "../include/timer.h"
+#include "../include/fat32.h"
+#include "../include/sync.h"
+
+/* ustar archive header (one 512-byte block) */
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];          /* Octal ASCII */
+    char mtime[12];
+    char checksum[8];
+    char typeflag;          /* '0' file, '5' directory */
+    char linkname[100];
+    char magic[6];          /* "ustar" */
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+} __attribute__((packed)) tar_header_t;
+
+/* Reference-counted data block, shared by files and the snapshot */
+typedef struct {
+    uint8_t* data;          /* FS_BLOCK_SIZE bytes */
+    uint16_t refs;
+    uint8_t flags;
+} fs_block_t;
+
+#define FS_BLOCK_EXTERN     0x01    /* Data lives in the initramfs */
 
 /* Filesystem state */
 static fs_file_t files[FS_MAX_FILES];
 static fs_handle_t handles[16];
 static bool fs_initialized = false;
+static mutex_t fs_mutex;
+
+/* Block pool; index 0 is never handed out so it can mean "hole" */
+static fs_block_t block_pool[FS_MAX_BLOCKS + 1];
+static uint16_t free_blocks[FS_MAX_BLOCKS];
+static int free_block_count = 0;
+
+/* Snapshot: a copy of the file table holding its own block references */
+static fs_file_t snap_files[FS_MAX_FILES];
+static int snap_entries = 0;
+static uint32_t snap_used_bytes = 0;
+static bool snap_valid = false;
+
+/* Running counters so listings and space queries don't rescan */
+static uint32_t fs_gen = 0;
+static int fs_entries = 0;
+static uint32_t fs_used_bytes = 0;
+
+static int find_free_slot(void);
+static void fs_snapshot_drop_locked(void);
+static bool fs_exists_locked(const char* name);
+static int fs_readdir_locked(fs_dir_t* dir, fs_dirent_t* entry);
+
+/* ========== Block Pool ========== */
+
+/* Take a block off the free list with one reference */
+static uint16_t block_take(void) {
+    if (free_block_count == 0) return 0;
+    
+    uint16_t b = free_blocks[--free_block_count];
+    block_pool[b].refs = 1;
+    block_pool[b].flags = 0;
+    return b;
+}
+
+/* Allocate a private, zeroed block */
+static uint16_t block_alloc(void) {
+    uint16_t b = block_take();
+    if (!b) return 0;
+    
+    block_pool[b].data = (uint8_t*)kmalloc(FS_BLOCK_SIZE);
+    if (!block_pool[b].data) {
+        free_blocks[free_block_count++] = b;
+        return 0;
+    }
+    memset(block_pool[b].data, 0, FS_BLOCK_SIZE);
+    return b;
+}
+
+/* Drop one reference, freeing the block with the last one */
+static void block_put(uint16_t b) {
+    if (!b) return;
+    if (--block_pool[b].refs > 0) return;
+    
+    if (!(block_pool[b].flags & FS_BLOCK_EXTERN)) {
+        kfree(block_pool[b].data);
+    }
+    block_pool[b].data = NULL;
+    free_blocks[free_block_count++] = b;
+}
+
+/* Add a reference to every block of a file */
+static void file_share_blocks(fs_file_t* f) {
+    for (int i = 0; i < FS_FILE_BLOCKS; i++) {
+        if (f->blocks[i]) block_pool[f->blocks[i]].refs++;
+    }
+}
+
+/* Drop a file's references to its blocks */
+static void file_release_blocks(fs_file_t* f) {
+    for (int i = 0; i < FS_FILE_BLOCKS; i++) {
+        block_put(f->blocks[i]);
+        f->blocks[i] = 0;
+    }
+}
+
+/* Return block i of a file ready for writing, copying it if shared */
+static uint8_t* file_block_writable(fs_file_t* f, int i) {
+    uint16_t b = f->blocks[i];
+    if (b && block_pool[b].refs == 1 && !(block_pool[b].flags & FS_BLOCK_EXTERN)) {
+        return block_pool[b].data;
+    }
+    
+    uint16_t copy = block_alloc();
+    if (!copy) return NULL;
+    
+    if (b) {
+        memcpy(block_pool[copy].data, block_pool[b].data, FS_BLOCK_SIZE);
+        block_put(b);
+    }
+    f->blocks[i] = copy;
+    return block_pool[copy].data;
+}
+
+/* ========== Filesystem ========== */
 
 /* Initialize filesystem */
 void fs_init(void) {
+    mutex_init(&fs_mutex, "fs");
     memset(files, 0, sizeof(files));
     memset(handles, 0, sizeof(handles));
+    memset(block_pool, 0, sizeof(block_pool));
+    
+    free_block_count = 0;
+    for (int b = FS_MAX_BLOCKS; b >= 1; b--) {
+        free_blocks[free_block_count++] = (uint16_t)b;
+    }
+    snap_valid = false;
     
     /* Create root directory entry */
     strcpy(files[0].name, "/");
     files[0].type = FS_TYPE_DIRECTORY;
     files[0].flags = FS_FLAG_READ | FS_FLAG_SYSTEM;
     files[0].created = timer_get_seconds();
-    files[0].data = NULL;
+    
+    fs_entries = 1;
+    fs_used_bytes = 0;
+    fs_gen++;
     
     fs_initialized = true;
+    
+    /* Index the initramfs the bootloader left in memory, if any */
+    uint32_t initrd_size = *(volatile uint32_t*)BOOT_INFO_ADDR;
+    if (initrd_size > 0 && initrd_size <= INITRD_MAX_SIZE) {
+        fs_load_initrd((const uint8_t*)INITRD_ADDR, initrd_size);
+    }
+}
+
+/* Parse an octal ASCII field from a tar header */
+static uint32_t tar_octal(const char* field, int len) {
+    uint32_t value = 0;
+    for (int i = 0; i < len && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = (value << 3) | (field[i] - '0');
+    }
+    return value;
+}
+
+/* Turn "./etc/motd" or "etc/" into a flat filesystem name */
+static bool tar_entry_name(const tar_header_t* hdr, char* name) {
+    const char* src = hdr->name;
+    while (src[0] == '.' && src[1] == '/') src += 2;
+    while (src[0] == '/') src++;
+    
+    int len = 0;
+    while (len < (int)sizeof(hdr->name) - (src - hdr->name) && src[len]) {
+        if (len >= FS_MAX_FILENAME - 1) return false;  /* Name too long */
+        name[len] = src[len];
+        len++;
+    }
+    while (len > 0 && name[len - 1] == '/') len--;
+    name[len] = '\0';
+    
+    return len > 0;
+}
+
+/* Index a ustar archive in place; file blocks point into it */
+int fs_load_initrd(const uint8_t* archive, uint32_t size) {
+    if (!fs_initialized || !archive) return -1;
+    
+    int added = 0;
+    uint32_t offset = 0;
+    
+    while (offset + FS_BLOCK_SIZE <= size) {
+        const tar_header_t* hdr = (const tar_header_t*)(archive + offset);
+        if (hdr->name[0] == '\0') break;                   /* End of archive */
+        if (memcmp(hdr->magic, "ustar", 5) != 0) break;     /* Not a tar */
+        
+        uint32_t file_size = tar_octal(hdr->size, sizeof(hdr->size));
+        const uint8_t* data = archive + offset + FS_BLOCK_SIZE;
+        offset += FS_BLOCK_SIZE + ALIGN(file_size, FS_BLOCK_SIZE);
+        if (offset > size) break;                           /* Truncated */
+        
+        uint8_t type;
+        if (hdr->typeflag == '0' || hdr->typeflag == '\0') {
+            type = FS_TYPE_FILE;
+        } else if (hdr->typeflag == '5') {
+            type = FS_TYPE_DIRECTORY;
+        } else {
+            continue;  /* Links and special files are not supported */
+        }
+        
+        char name[FS_MAX_FILENAME];
+        if (!tar_entry_name(hdr, name) || fs_exists_locked(name)) continue;
+        
+        int slot = find_free_slot();
+        if (slot < 0) break;
+        
+        strcpy(files[slot].name, name);
+        files[slot].type = type;
+        files[slot].flags = FS_FLAG_READ | FS_FLAG_WRITE;
+        files[slot].created = timer_get_seconds();
+        files[slot].modified = files[slot].created;
+        
+        if (type == FS_TYPE_FILE) {
+            /* Archive members are padded to whole blocks, so share them */
+            uint32_t keep = MIN(file_size, (uint32_t)FS_MAX_FILESIZE);
+            for (uint32_t i = 0; i * FS_BLOCK_SIZE < keep; i++) {
+                uint16_t b = block_take();
+                if (!b) {
+                    keep = i * FS_BLOCK_SIZE;
+                    break;
+                }
+                block_pool[b].data = (uint8_t*)data + i * FS_BLOCK_SIZE;
+                block_pool[b].flags = FS_BLOCK_EXTERN;
+                files[slot].blocks[i] = b;
+            }
+            files[slot].size = keep;
+            fs_used_bytes += keep;
+        }
+        
+        fs_entries++;
+        added++;
+    }
+    
+    if (added > 0) fs_gen++;
+    return added;
 }
 
 /* Find a file by name */
@@ -41,13 +278,27 @@ fs_file_t* fs_find(const char* name) {
     return NULL;
 }
 
+/* Map "fat/NAME" to NAME when a FAT32 volume is mounted */
+static const char* fs_fat_path(const char* name) {
+    if (fat32_mounted() && strncmp(name, FS_FAT_PREFIX, 4) == 0) {
+        return name + 4;
+    }
+    return NULL;
+}
+
 /* Check if file exists */
-bool fs_exists(const char* name) {
+static bool fs_exists_locked(const char* name) {
+    const char* fat = fs_fat_path(name);
+    if (fat) return fat32_exists(fat);
+    
     return fs_find(name) != NULL;
 }
 
 /* Get file size */
-uint32_t fs_size(const char* name) {
+static uint32_t fs_size_locked(const char* name) {
+    const char* fat = fs_fat_path(name);
+    if (fat) return fat32_size(fat);
+    
     fs_file_t* file = fs_find(name);
     return file ? file->size : 0;
 }
@@ -73,9 +324,18 @@ static int find_free_handle(void) {
 }
 
 /* Create a file or directory */
-int fs_create(const char* name, uint8_t type) {
+static int fs_create_locked(const char* name, uint8_t type) {
     if (!fs_initialized) return -1;
-    if (fs_exists(name)) return -2;  /* Already exists */
+    if (fs_exists_locked(name)) return -2;  /* Already exists */
+    
+    const char* fat = fs_fat_path(name);
+    if (fat) {
+        if (type != FS_TYPE_FILE) return -6;  /* No FAT32 mkdir */
+        int result = fat32_create(fat);
+        if (result == 0) fs_gen++;
+        return result;
+    }
+    
     if (strlen(name) >= FS_MAX_FILENAME) return -3;
     
     int slot = find_free_slot();
@@ -88,37 +348,56 @@ int fs_create(const char* name, uint8_t type) {
     files[slot].size = 0;
     files[slot].created = timer_get_seconds();
     files[slot].modified = files[slot].created;
+    memset(files[slot].blocks, 0, sizeof(files[slot].blocks));  /* Blocks on write */
     
-    if (type == FS_TYPE_FILE) {
-        files[slot].data = (uint8_t*)kmalloc(FS_MAX_FILESIZE);
-        if (!files[slot].data) {
-            files[slot].type = FS_TYPE_FREE;
-            return -5;  /* Out of memory */
-        }
-        memset(files[slot].data, 0, FS_MAX_FILESIZE);
-    } else {
-        files[slot].data = NULL;
-    }
-    
+    fs_entries++;
+    fs_gen++;
     return 0;
 }
 
 /* Delete a file */
-int fs_delete(const char* name) {
+static int fs_delete_locked(const char* name) {
+    const char* fat = fs_fat_path(name);
+    if (fat) {
+        int result = fat32_delete(fat);
+        if (result == 0) fs_gen++;
+        return result;
+    }
+    
     fs_file_t* file = fs_find(name);
     if (!file) return -1;
     if (file->flags & FS_FLAG_SYSTEM) return -2;  /* Can't delete system files */
     
-    if (file->data) {
-        kfree(file->data);
+    file_release_blocks(file);
+    
+    if (file->type == FS_TYPE_FILE) {
+        fs_used_bytes -= file->size;
     }
+    fs_entries--;
+    fs_gen++;
     
     memset(file, 0, sizeof(fs_file_t));
     return 0;
 }
 
 /* Open a file */
-int fs_open(const char* name, uint8_t mode) {
+static int fs_open_locked(const char* name, uint8_t mode) {
+    const char* fat = fs_fat_path(name);
+    if (fat) {
+        int h = find_free_handle();
+        if (h < 0) return -3;
+        
+        int fh = fat32_open(fat, mode);
+        if (fh < 0) return fh;
+        
+        handles[h].file = NULL;
+        handles[h].position = 0;
+        handles[h].mode = mode;
+        handles[h].in_use = true;
+        handles[h].fat_handle = fh;
+        return h;
+    }
+    
     fs_file_t* file = fs_find(name);
     if (!file) return -1;
     if (file->type != FS_TYPE_FILE) return -2;
@@ -130,25 +409,33 @@ int fs_open(const char* name, uint8_t mode) {
     handles[h].position = 0;
     handles[h].mode = mode;
     handles[h].in_use = true;
+    handles[h].fat_handle = -1;
     
     return h;
 }
 
 /* Close a file handle */
-void fs_close(int handle) {
+static void fs_close_locked(int handle) {
     if (handle >= 0 && handle < 16) {
+        if (handles[handle].in_use && handles[handle].fat_handle >= 0) {
+            fat32_close(handles[handle].fat_handle);
+        }
         handles[handle].in_use = false;
         handles[handle].file = NULL;
     }
 }
 
 /* Read from file */
-int fs_read(int handle, void* buffer, uint32_t size) {
+static int fs_read_locked(int handle, void* buffer, uint32_t size) {
     if (handle < 0 || handle >= 16) return -1;
     if (!handles[handle].in_use) return -2;
     if (!(handles[handle].mode & FS_FLAG_READ)) return -3;
     
     fs_handle_t* h = &handles[handle];
+    if (h->fat_handle >= 0) {
+        return fat32_read(h->fat_handle, buffer, size);
+    }
+    
     fs_file_t* f = h->file;
     
     if (h->position >= f->size) return 0;  /* EOF */
@@ -158,19 +445,38 @@ int fs_read(int handle, void* buffer, uint32_t size) {
         to_read = f->size - h->position;
     }
     
-    memcpy(buffer, f->data + h->position, to_read);
+    uint8_t* out = (uint8_t*)buffer;
+    for (uint32_t done = 0; done < to_read; ) {
+        uint32_t pos = h->position + done;
+        uint32_t offset = pos % FS_BLOCK_SIZE;
+        uint32_t chunk = MIN(FS_BLOCK_SIZE - offset, to_read - done);
+        uint16_t b = f->blocks[pos / FS_BLOCK_SIZE];
+        
+        if (b) {
+            memcpy(out + done, block_pool[b].data + offset, chunk);
+        } else {
+            memset(out + done, 0, chunk);
+        }
+        done += chunk;
+    }
     h->position += to_read;
     
     return to_read;
 }
 
 /* Write to file */
-int fs_write(int handle, const void* buffer, uint32_t size) {
+static int fs_write_locked(int handle, const void* buffer, uint32_t size) {
     if (handle < 0 || handle >= 16) return -1;
     if (!handles[handle].in_use) return -2;
     if (!(handles[handle].mode & FS_FLAG_WRITE)) return -3;
     
     fs_handle_t* h = &handles[handle];
+    if (h->fat_handle >= 0) {
+        int written = fat32_write(h->fat_handle, buffer, size);
+        if (written > 0) fs_gen++;
+        return written;
+    }
+    
     fs_file_t* f = h->file;
     
     if (h->position + size > FS_MAX_FILESIZE) {
@@ -179,22 +485,44 @@ int fs_write(int handle, const void* buffer, uint32_t size) {
     
     if (size == 0) return 0;
     
-    memcpy(f->data + h->position, buffer, size);
+    /* Only the blocks touched here are copied if they are shared */
+    const uint8_t* in = (const uint8_t*)buffer;
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = h->position + done;
+        uint32_t offset = pos % FS_BLOCK_SIZE;
+        uint32_t chunk = MIN(FS_BLOCK_SIZE - offset, size - done);
+        
+        uint8_t* block = file_block_writable(f, pos / FS_BLOCK_SIZE);
+        if (!block) break;
+        
+        memcpy(block + offset, in + done, chunk);
+        done += chunk;
+    }
+    
+    if (done == 0) return -4;  /* Out of blocks */
+    size = done;
     h->position += size;
     
     if (h->position > f->size) {
+        fs_used_bytes += h->position - f->size;
         f->size = h->position;
     }
     
     f->modified = timer_get_seconds();
+    fs_gen++;
     return size;
 }
 
 /* Seek in file */
-int fs_seek(int handle, uint32_t position) {
+static int fs_seek_locked(int handle, uint32_t position) {
     if (handle < 0 || handle >= 16) return -1;
     if (!handles[handle].in_use) return -2;
     
+    if (handles[handle].fat_handle >= 0) {
+        return fat32_seek(handles[handle].fat_handle, position);
+    }
+    
     if (position > handles[handle].file->size) {
         position = handles[handle].file->size;
     }
@@ -204,16 +532,13 @@ int fs_seek(int handle, uint32_t position) {
 }
 
 /* List files */
-int fs_list(fs_dirent_t* entries, int max_entries) {
+static int fs_list_locked(fs_dirent_t* entries, int max_entries) {
+    fs_dir_t dir;
     int count = 0;
     
-    for (int i = 0; i < FS_MAX_FILES && count < max_entries; i++) {
-        if (files[i].type != FS_TYPE_FREE) {
-            strncpy(entries[count].name, files[i].name, FS_MAX_FILENAME);
-            entries[count].type = files[i].type;
-            entries[count].size = files[i].size;
-            count++;
-        }
+    fs_opendir(&dir);
+    while (count < max_entries && fs_readdir_locked(&dir, &entries[count])) {
+        count++;
     }
     
     return count;
@@ -221,21 +546,61 @@ int fs_list(fs_dirent_t* entries, int max_entries) {
 
 /* Count files */
 int fs_count(void) {
-    int count = 0;
-    for (int i = 0; i < FS_MAX_FILES; i++) {
-        if (files[i].type != FS_TYPE_FREE) {
-            count++;
+    return fs_entries + fat32_count();
+}
+
+/* Start iterating the directory from the beginning */
+void fs_opendir(fs_dir_t* dir) {
+    dir->slot = 0;
+    dir->generation = fs_gen;
+    dir->changed = false;
+}
+
+/* Read the next entry; returns 1 with entry filled in, 0 at the end */
+static int fs_readdir_locked(fs_dir_t* dir, fs_dirent_t* entry) {
+    /* Slots already passed may have changed under us */
+    if (dir->generation != fs_gen) dir->changed = true;
+    
+    while (dir->slot < FS_MAX_FILES) {
+        fs_file_t* f = &files[dir->slot++];
+        if (f->type != FS_TYPE_FREE) {
+            strncpy(entry->name, f->name, FS_MAX_FILENAME);
+            entry->type = f->type;
+            entry->size = f->size;
+            return 1;
         }
     }
-    return count;
+    
+    /* Then the FAT32 volume, listed under its prefix */
+    while (dir->slot >= FS_MAX_FILES) {
+        fs_dirent_t fat_entry;
+        int result = fat32_dentry(dir->slot - FS_MAX_FILES, &fat_entry);
+        if (result < 0) break;
+        
+        dir->slot++;
+        if (result > 0) {
+            strcpy(entry->name, FS_FAT_PREFIX);
+            strcat(entry->name, fat_entry.name);
+            entry->type = fat_entry.type;
+            entry->size = fat_entry.size;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Current filesystem generation */
+uint32_t fs_generation(void) {
+    return fs_gen;
 }
 
 /* Format filesystem (clear all) */
-void fs_format(void) {
+static void fs_format_locked(void) {
     for (int i = 0; i < FS_MAX_FILES; i++) {
-        if (files[i].data) {
-            kfree(files[i].data);
-        }
+        file_release_blocks(&files[i]);
+    }
+    for (int i = 0; i < 16; i++) {
+        fs_close_locked(i);
     }
     memset(files, 0, sizeof(files));
     memset(handles, 0, sizeof(handles));
@@ -244,26 +609,189 @@ void fs_format(void) {
     strcpy(files[0].name, "/");
     files[0].type = FS_TYPE_DIRECTORY;
     files[0].flags = FS_FLAG_READ | FS_FLAG_SYSTEM;
+    
+    fs_entries = 1;
+    fs_used_bytes = 0;
+    fs_gen++;
 }
 
-/* Get free space */
-uint32_t fs_free_space(void) {
-    int free_slots = 0;
+/* ========== Snapshots ========== */
+
+/* Checkpoint the file table; data blocks are shared, not copied */
+static int fs_snapshot_locked(void) {
+    if (!fs_initialized) return -1;
+    
+    fs_snapshot_drop_locked();
+    memcpy(snap_files, files, sizeof(files));
     for (int i = 0; i < FS_MAX_FILES; i++) {
-        if (files[i].type == FS_TYPE_FREE) {
-            free_slots++;
+        file_share_blocks(&snap_files[i]);
+    }
+    
+    snap_entries = fs_entries;
+    snap_used_bytes = fs_used_bytes;
+    snap_valid = true;
+    return fs_entries;
+}
+
+/* Restore the file table from the snapshot, which stays available */
+static int fs_rollback_locked(void) {
+    if (!snap_valid) return -1;
+    
+    /* Open RAM handles would point at entries that no longer exist */
+    for (int i = 0; i < 16; i++) {
+        if (handles[i].in_use && handles[i].fat_handle < 0) {
+            fs_close_locked(i);
         }
     }
-    return free_slots * FS_MAX_FILESIZE;
+    
+    for (int i = 0; i < FS_MAX_FILES; i++) {
+        file_release_blocks(&files[i]);
+    }
+    memcpy(files, snap_files, sizeof(files));
+    for (int i = 0; i < FS_MAX_FILES; i++) {
+        file_share_blocks(&files[i]);
+    }
+    
+    fs_entries = snap_entries;
+    fs_used_bytes = snap_used_bytes;
+    fs_gen++;
+    return 0;
 }
 
-/* Get used space */
-uint32_t fs_used_space(void) {
-    uint32_t used = 0;
+/* Release the snapshot and any blocks only it was holding */
+static void fs_snapshot_drop_locked(void) {
+    if (!snap_valid) return;
+    
     for (int i = 0; i < FS_MAX_FILES; i++) {
-        if (files[i].type == FS_TYPE_FILE) {
-            used += files[i].size;
-        }
+        file_release_blocks(&snap_files[i]);
     }
-    return used;
+    snap_valid = false;
+}
+
+/* Check whether a snapshot is held */
+bool fs_has_snapshot(void) {
+    return snap_valid;
+}
+
+/* Get free space */
+uint32_t fs_free_space(void) {
+    return (FS_MAX_FILES - fs_entries) * FS_MAX_FILESIZE;
+}
+
+/* Get used space */
+uint32_t fs_used_space(void) {
+    return fs_used_bytes;
+}
+
+/* ========== Locked Entry Points ========== */
+
+/* Serialize callers from every CPU; FAT32 writeback takes it too */
+void fs_lock(void) {
+    mutex_lock(&fs_mutex);
+}
+
+void fs_unlock(void) {
+    mutex_unlock(&fs_mutex);
+}
+
+bool fs_exists(const char* name) {
+    fs_lock();
+    bool result = fs_exists_locked(name);
+    fs_unlock();
+    return result;
+}
+
+uint32_t fs_size(const char* name) {
+    fs_lock();
+    uint32_t result = fs_size_locked(name);
+    fs_unlock();
+    return result;
+}
+
+int fs_create(const char* name, uint8_t type) {
+    fs_lock();
+    int result = fs_create_locked(name, type);
+    fs_unlock();
+    return result;
+}
+
+int fs_delete(const char* name) {
+    fs_lock();
+    int result = fs_delete_locked(name);
+    fs_unlock();
+    return result;
+}
+
+int fs_open(const char* name, uint8_t mode) {
+    fs_lock();
+    int result = fs_open_locked(name, mode);
+    fs_unlock();
+    return result;
+}
+
+void fs_close(int handle) {
+    fs_lock();
+    fs_close_locked(handle);
+    fs_unlock();
+}
+
+int fs_read(int handle, void* buffer, uint32_t size) {
+    fs_lock();
+    int result = fs_read_locked(handle, buffer, size);
+    fs_unlock();
+    return result;
+}
+
+int fs_write(int handle, const void* buffer, uint32_t size) {
+    fs_lock();
+    int result = fs_write_locked(handle, buffer, size);
+    fs_unlock();
+    return result;
+}
+
+int fs_seek(int handle, uint32_t position) {
+    fs_lock();
+    int result = fs_seek_locked(handle, position);
+    fs_unlock();
+    return result;
+}
+
+int fs_list(fs_dirent_t* entries, int max_entries) {
+    fs_lock();
+    int result = fs_list_locked(entries, max_entries);
+    fs_unlock();
+    return result;
+}
+
+int fs_readdir(fs_dir_t* dir, fs_dirent_t* entry) {
+    fs_lock();
+    int result = fs_readdir_locked(dir, entry);
+    fs_unlock();
+    return result;
+}
+
+void fs_format(void) {
+    fs_lock();
+    fs_format_locked();
+    fs_unlock();
+}
+
+int fs_snapshot(void) {
+    fs_lock();
+    int result = fs_snapshot_locked();
+    fs_unlock();
+    return result;
+}
+
+int fs_rollback(void) {
+    fs_lock();
+    int result = fs_rollback_locked();
+    fs_unlock();
+    return result;
+}
+
+void fs_snapshot_drop(void) {
+    fs_lock();
+    fs_snapshot_drop_locked();
+    fs_unlock();
 }
@@ -0,0 +1,111 @@
+/*
+ * NightOS - Fast User-Space Mutex Implementation
+ * 
+ * Waiters sleep on a hash bucket keyed by the word's identity. A
+ * waiter queues itself before it compares the word, and a waker
+ * changes the word before it calls in, so a wake-up can't fall
+ * between the two. Programs have address spaces of their own, so a
+ * private word is named by its mm and address together, and a word in
+ * shared memory by the frame under it, which every mapping of the
+ * segment sees wherever it is mapped. Kernel threads share the kernel
+ * mappings, so for them the address alone is the key.
+ * 
+ * The comparison runs with preemption off, so it must not sleep: the
+ * word is faulted in by an ordinary copy first, and the check itself
+ * is a fixup-protected copy that can only fail, never page in.
+ */
+
+#include "../include/futex.h"
+#include "../include/errno.h"
+#include "../include/wait.h"
+#include "../include/vmm.h"
+#include "../include/shm.h"
+#include "../include/process.h"
+#include "../include/uaccess.h"
+
+static wait_queue_t futex_buckets[FUTEX_HASH_BUCKETS];
+
+/* Initialize the bucket table */
+void futex_init(void) {
+    for (int i = 0; i < FUTEX_HASH_BUCKETS; i++) {
+        wait_queue_init(&futex_buckets[i]);
+    }
+}
+
+/* Fibonacci hash of a key, both halves folded in */
+static wait_queue_t* futex_bucket(uint64_t key) {
+    uint32_t fold = (uint32_t)key ^ (uint32_t)(key >> 32);
+    return &futex_buckets[((fold >> 2) * 2654435761u) >> (32 - FUTEX_HASH_BITS)];
+}
+
+/* Identity of the word at addr (nonzero); -EFAULT if no area covers it */
+static int futex_key(volatile uint32_t* addr, uint64_t* key) {
+    uint32_t address = (uint32_t)addr;
+    mm_t* mm = process_current()->mm;
+    if (!mm) {
+        *key = address;
+        return 0;
+    }
+    
+    vm_area_t* area = mm_find_area(mm, address);
+    if (!area) return -EFAULT;
+    
+    if (area->flags & VMA_SHM) {
+        uint32_t frame = shm_frame(area->shm, (address - area->start) / PAGE_SIZE);
+        *key = frame | (address & ~PAGE_FRAME_MASK);
+    } else {
+        *key = ((uint64_t)(uint32_t)mm << 32) | address;
+    }
+    return 0;
+}
+
+/* Words must be aligned so an atomic update is one bus operation */
+static inline bool futex_valid(volatile uint32_t* addr) {
+    return addr && ((uint32_t)addr & 3) == 0;
+}
+
+/* Sleep while *addr == expected, until futex_wake or the timeout */
+int futex_wait(volatile uint32_t* addr, uint32_t expected, uint32_t timeout_ms) {
+    if (!futex_valid(addr)) return -EINVAL;
+    
+    /* Fault the word in now, while we may still sleep */
+    uint32_t value;
+    if (copy_from_user(&value, (const void*)addr, sizeof(value)) < 0) return -EFAULT;
+    
+    uint64_t key;
+    int result = futex_key(addr, &key);
+    if (result < 0) return result;
+    
+    wait_queue_t* wq = futex_bucket(key);
+    bool timed = timeout_ms != 0;
+    uint32_t deadline = timed ? wait_deadline(timeout_ms) : 0;
+    
+    prepare_to_wait_key(wq, key, timed, deadline);
+    if (copy_from_user(&value, (const void*)addr, sizeof(value)) < 0) {
+        finish_wait(wq);
+        return -EFAULT;
+    }
+    if (value != expected) {
+        result = -EAGAIN;
+    } else {
+        wait_schedule();
+    }
+    
+    /* Still queued: the timer woke us, or someone else did (spurious) */
+    bool woken = finish_wait(wq);
+    if (result == 0 && !woken && timed && wait_expired(deadline)) {
+        result = -ETIMEDOUT;
+    }
+    return result;
+}
+
+/* Wake up to nr waiters on addr; returns how many woke */
+int futex_wake(volatile uint32_t* addr, uint32_t nr) {
+    if (!futex_valid(addr)) return -EINVAL;
+    if (nr == 0) return 0;
+    
+    uint64_t key;
+    int result = futex_key(addr, &key);
+    if (result < 0) return result;
+    return (int)wake_up_key(futex_bucket(key), key, nr);
+}
@@ -0,0 +1,91 @@
+/*
+ * NightOS - Global Descriptor Table Implementation
+ * 
+ * Replaces the bootloader's GDT with one per CPU. The flat code and
+ * data selectors keep their values, so nothing that hardcodes 0x08
+ * or 0x10 has to change.
+ */
+
+#include "../include/gdt.h"
+#include "../include/smp.h"
+#include "../include/idt.h"
+#include "../include/string.h"
+
+/* Stacks of the double fault tasks, which must not trust the faulting one */
+static uint8_t df_stacks[SMP_MAX_CPUS][GDT_DF_STACK_SIZE] __attribute__((aligned(16)));
+
+/* Encode a segment descriptor */
+static uint64_t gdt_entry(uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    uint64_t desc = limit & 0xFFFF;
+    desc |= (uint64_t)(base & 0xFFFFFF) << 16;
+    desc |= (uint64_t)access << 40;
+    desc |= (uint64_t)((limit >> 16) & 0xF) << 48;
+    desc |= (uint64_t)(flags & 0xF) << 52;
+    desc |= (uint64_t)((base >> 24) & 0xFF) << 56;
+    return desc;
+}
+
+/* Task entered through the double fault gate: fresh stack, interrupts off */
+static void df_tss_init(cpu_t* cpu) {
+    tss_t* tss = &cpu->df_tss;
+    memset(tss, 0, sizeof(tss_t));
+    
+    tss->eip = (uint32_t)double_fault_task;
+    tss->esp = (uint32_t)&df_stacks[cpu->id][GDT_DF_STACK_SIZE];
+    tss->eflags = 0x002;
+    tss->cs = GDT_KERNEL_CODE;
+    tss->ss = tss->ds = tss->es = GDT_KERNEL_DATA;
+    tss->gs = GDT_PERCPU;
+    tss->iomap_base = sizeof(tss_t);
+    /* cr3 is filled in once paging is on */
+}
+
+/* Build and load a CPU's GDT and TSS, and point %gs at its per-CPU data */
+void gdt_init_cpu(struct cpu* cpu) {
+    memset(cpu->gdt, 0, sizeof(cpu->gdt));
+    memset(&cpu->tss, 0, sizeof(tss_t));
+    
+    cpu->tss.ss0 = GDT_KERNEL_DATA;
+    cpu->tss.iomap_base = sizeof(tss_t);    /* No I/O permission bitmap */
+    df_tss_init(cpu);
+    
+    cpu->gdt[GDT_KERNEL_CODE / 8] = gdt_entry(0, 0xFFFFF, GDT_ACCESS_CODE, GDT_FLAGS_FLAT);
+    cpu->gdt[GDT_KERNEL_DATA / 8] = gdt_entry(0, 0xFFFFF, GDT_ACCESS_DATA, GDT_FLAGS_FLAT);
+    cpu->gdt[GDT_USER_CODE / 8] = gdt_entry(0, 0xFFFFF, GDT_ACCESS_USER_CODE, GDT_FLAGS_FLAT);
+    cpu->gdt[GDT_USER_DATA / 8] = gdt_entry(0, 0xFFFFF, GDT_ACCESS_USER_DATA, GDT_FLAGS_FLAT);
+    cpu->gdt[GDT_TSS / 8] = gdt_entry((uint32_t)&cpu->tss, sizeof(tss_t) - 1,
+                                      GDT_ACCESS_TSS, 0);
+    cpu->gdt[GDT_PERCPU / 8] = gdt_entry((uint32_t)cpu, sizeof(cpu_t) - 1,
+                                         GDT_ACCESS_DATA, GDT_FLAGS_BYTE);
+    cpu->gdt[GDT_DF_TSS / 8] = gdt_entry((uint32_t)&cpu->df_tss, sizeof(tss_t) - 1,
+                                         GDT_ACCESS_TSS, 0);
+    cpu->gdt[GDT_CPU_NUMBER / 8] = gdt_entry(0, cpu->id, GDT_ACCESS_USER_DATA, GDT_FLAGS_BYTE);
+    
+    gdt_ptr_t gdtr;
+    gdtr.limit = sizeof(cpu->gdt) - 1;
+    gdtr.base = (uint32_t)cpu->gdt;
+    
+    __asm__ volatile(
+        "lgdt (%0)\n\t"
+        "ljmp %1, $1f\n"
+        "1:\n\t"
+        "movw %2, %%ax\n\t"
+        "movw %%ax, %%ds\n\t"
+        "movw %%ax, %%es\n\t"
+        "movw %%ax, %%ss\n\t"
+        "xorw %%ax, %%ax\n\t"
+        "movw %%ax, %%fs\n\t"
+        "movw %3, %%ax\n\t"
+        "movw %%ax, %%gs\n\t"
+        "movw %4, %%ax\n\t"
+        "ltr %%ax"
+        :
+        : "r"(&gdtr), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA),
+          "i"(GDT_PERCPU), "i"(GDT_TSS)
+        : "eax", "memory");
+}
+
+/* Stack the CPU switches to on entry from ring 3 */
+void gdt_set_kernel_stack(struct cpu* cpu, uint32_t esp0) {
+    cpu->tss.esp0 = esp0;
+}
@@ -436,12 +436,23 @@ void gui_app_sysinfo(void) {
     }
 }
 
+/* File manager listing, refreshed only when the filesystem changes */
+static fs_dirent_t files_cache[10];
+static int files_cache_count = 0;
+static uint32_t files_cache_gen = 0;
+static bool files_cache_valid = false;
+
 /* File manager draw callback */
 static void files_draw(void* data) {
     gui_window_t* win = (gui_window_t*)data;
     
-    fs_dirent_t entries[16];
-    int count = fs_list(entries, 16);
+    if (!files_cache_valid || files_cache_gen != fs_generation()) {
+        files_cache_count = fs_list(files_cache, 10);
+        files_cache_gen = fs_generation();
+        files_cache_valid = true;
+    }
+    fs_dirent_t* entries = files_cache;
+    int count = files_cache_count;
     
     tui_draw_text(win->base.x + 2, win->base.y + 2, "Name          Size", 
                   VGA_COLOR_WHITE, VGA_COLOR_BLACK);
@@ -6,9 +6,18 @@
 
 #include "../include/idt.h"
 #include "../include/pic.h"
+#include "../include/apic.h"
 #include "../include/vga.h"
 #include "../include/io.h"
 #include "../include/string.h"
+#include "../include/process.h"
+#include "../include/paging.h"
+#include "../include/smp.h"
+#include "../include/gdt.h"
+#include "../include/stackpool.h"
+#include "../include/syscall.h"
+#include "../include/vmm.h"
+#include "../include/uaccess.h"
 
 /* IDT and pointer */
 static idt_entry_t idt[IDT_ENTRIES];
@@ -91,7 +100,7 @@ void idt_init(void) {
     idt_set_gate(5, (uint32_t)isr5, 0x08, IDT_GATE_INTERRUPT);
     idt_set_gate(6, (uint32_t)isr6, 0x08, IDT_GATE_INTERRUPT);
     idt_set_gate(7, (uint32_t)isr7, 0x08, IDT_GATE_INTERRUPT);
-    idt_set_gate(8, (uint32_t)isr8, 0x08, IDT_GATE_INTERRUPT);
+    idt_set_gate(8, 0, GDT_DF_TSS, IDT_GATE_TASK);     /* Fresh stack, see double_fault_task */
     idt_set_gate(9, (uint32_t)isr9, 0x08, IDT_GATE_INTERRUPT);
     idt_set_gate(10, (uint32_t)isr10, 0x08, IDT_GATE_INTERRUPT);
     idt_set_gate(11, (uint32_t)isr11, 0x08, IDT_GATE_INTERRUPT);
@@ -134,18 +143,89 @@ void idt_init(void) {
     idt_set_gate(46, (uint32_t)irq14, 0x08, IDT_GATE_INTERRUPT);
     idt_set_gate(47, (uint32_t)irq15, 0x08, IDT_GATE_INTERRUPT);
     
+    /* Local APIC timer and spurious vectors */
+    idt_set_gate(LAPIC_TIMER_VECTOR, (uint32_t)lapic_timer_isr, 0x08, IDT_GATE_INTERRUPT);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (uint32_t)spurious_isr, 0x08, IDT_GATE_INTERRUPT);
+    
+    /* System calls (int 0x80), open to ring 3 */
+    idt_set_gate(SYSCALL_INT, (uint32_t)isr128, 0x08, IDT_GATE_USER);
+    
     /* Load IDT */
     idt_load((uint32_t)&idt_ptr);
 }
 
+/* Load the already built IDT on another CPU */
+void idt_reload(void) {
+    idt_load((uint32_t)&idt_ptr);
+}
+
+/* Name the process whose stack a fault address overflowed, if any */
+static void report_stack_guard(uint32_t addr) {
+    if (stack_is_guard(addr)) {
+        process_t* proc = process_current();
+        vga_printf("  Kernel stack overflow (guard page hit) in %s, PID %d\n",
+                   proc ? proc->name : "?", proc ? proc->pid : 0);
+    }
+}
+
+/*
+ * Double fault - entered through a task gate, so it runs on its own
+ * stack even when the faulting stack has run into its guard page.
+ * The faulting task's registers were saved in this CPU's main TSS.
+ */
+void double_fault_task(void) {
+    tss_t* prev = &this_cpu()->tss;
+    uint32_t cr2 = read_cr2();
+    
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_RED));
+    vga_puts("\n  KERNEL PANIC  \n");
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    vga_printf("\n  Exception: %s (CPU %d)\n", exception_messages[8], smp_cpu_id());
+    
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_printf("  EIP: 0x%x\n", prev->eip);
+    vga_printf("  ESP: 0x%x\n", prev->esp);
+    vga_printf("  Last fault address: 0x%x\n", cr2);
+    report_stack_guard(stack_is_guard(prev->esp) ? prev->esp : cr2);
+    
+    vga_puts("\n  System halted.\n");
+    while (1) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
 /* ISR handler - called from assembly */
 void isr_handler(registers_t* regs) {
+    /* Program memory is filled in, and copied on write, a page at a time */
+    if (regs->int_no == 14 && vmm_handle_fault(regs, read_cr2())) {
+        return;
+    }
+    
+    /* A bad pointer met by copy_from_user and friends: they return -EFAULT */
+    if (regs->int_no == 14 && uaccess_fixup(regs)) {
+        return;
+    }
+    
     /* Check for registered handler */
     if (interrupt_handlers[regs->int_no]) {
+        uint32_t acct = acct_enter(ACCT_KERNEL, (regs->cs & 3) != 0);
         interrupt_handlers[regs->int_no](regs);
+        acct_exit(acct);
+        process_exit_if_killed(regs);
         return;
     }
     
+    /* A program's exception ends the program, not the system */
+    if ((regs->cs & 3) == 3) {
+        process_t* proc = process_current();
+        vga_set_color(vga_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        vga_printf("\n  %s (PID %d): %s at EIP 0x%x\n", proc->name, proc->pid,
+                   regs->int_no < 32 ? exception_messages[regs->int_no] : "Unknown interrupt",
+                   regs->eip);
+        vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        process_exit(-1);
+    }
+    
     /* Default exception handler - display error and halt */
     vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_RED));
     vga_puts("\n  KERNEL PANIC  \n");
@@ -159,6 +239,11 @@ void isr_handler(registers_t* regs) {
     
     vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     vga_printf("  Error code: 0x%x\n", regs->err_code);
+    if (regs->int_no == 14) {
+        uint32_t cr2 = read_cr2();
+        vga_printf("  Address: 0x%x\n", cr2);
+        report_stack_guard(cr2);
+    }
     vga_printf("  EIP: 0x%x\n", regs->eip);
     vga_printf("  CS:  0x%x\n", regs->cs);
     vga_printf("  EFLAGS: 0x%x\n", regs->eflags);
@@ -171,11 +256,20 @@ void isr_handler(registers_t* regs) {
 
 /* IRQ handler - called from assembly */
 void irq_handler(registers_t* regs) {
-    /* Send EOI to PIC */
-    pic_send_eoi(regs->int_no - 32);
+    uint32_t acct = acct_enter(ACCT_IRQ, (regs->cs & 3) != 0);
+    
+    /* Send EOI to the PIC, or to the local APIC for its own vectors */
+    if (regs->int_no >= LAPIC_TIMER_VECTOR) {
+        lapic_eoi();
+    } else {
+        pic_send_eoi(regs->int_no - 32);
+    }
     
     /* Call registered handler if exists */
     if (interrupt_handlers[regs->int_no]) {
         interrupt_handlers[regs->int_no](regs);
     }
+    
+    acct_exit(acct);
+    process_exit_if_killed(regs);
 }
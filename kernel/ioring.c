@@ -0,0 +1,170 @@
+/*
+ * NightOS - Asynchronous I/O Ring Implementation
+ * 
+ * Processes queue file and console operations in a shared submission
+ * ring and reap results from a completion ring. One SYS_IORING_ENTER
+ * covers a whole batch; SQPOLL rings need no syscall at all because
+ * the kernel drains them whenever their owner yields. Only the owner's
+ * rings are drained then: their entries name its descriptors and its
+ * buffers, so they must run in its address space.
+ * 
+ * A ring is one pool frame, mapped into its owner's address space and
+ * used by the kernel through the frame's identity mapping.
+ */
+
+#include "../include/ioring.h"
+#include "../include/syscall.h"
+#include "../include/process.h"
+#include "../include/vmm.h"
+#include "../include/string.h"
+
+/*
+ * A ring in use. The process may scribble over anything in its page,
+ * so who owns the ring and how it was set up are kept here instead.
+ */
+typedef struct {
+    io_ring_t* ring;                    /* The kernel's view: the frame itself */
+    uint32_t addr;                      /* The owner's view, and its handle */
+    uint32_t owner_pid;
+    uint32_t flags;
+} ring_slot_t;
+
+/* Active rings */
+static ring_slot_t rings[IORING_MAX_RINGS];
+
+/* Initialize ring table */
+void ioring_init(void) {
+    memset(rings, 0, sizeof(rings));
+}
+
+/* Slot of a ring handle the caller was given: -1 if none, -2 if not its own */
+static int ioring_slot(io_ring_t* ring) {
+    uint32_t pid = process_getpid();
+    int result = -1;
+    for (int i = 0; i < IORING_MAX_RINGS; i++) {
+        if (!rings[i].ring || rings[i].addr != (uint32_t)ring) continue;
+        if (rings[i].owner_pid == pid) return i;
+        result = -2;
+    }
+    return result;
+}
+
+/* Drop a ring's frame; the owner's mapping keeps it until the owner exits */
+static void ioring_free(ring_slot_t* slot) {
+    frame_put((uint32_t)slot->ring);
+    slot->ring = NULL;
+}
+
+/* Create a ring for the current process, mapped into its address space */
+io_ring_t* ioring_setup(uint32_t flags) {
+    for (int i = 0; i < IORING_MAX_RINGS; i++) {
+        if (rings[i].ring) continue;
+        
+        uint32_t frame = frame_alloc();
+        if (!frame) return NULL;
+        memset((void*)frame, 0, PAGE_SIZE);
+        
+        /* Kernel threads use the frame where it is */
+        uint32_t addr = frame;
+        mm_t* mm = process_current()->mm;
+        if (mm) {
+            addr = mm_find_gap(mm, IORING_MAP_BASE, PAGE_SIZE);
+            if (!addr || mm_map_frame(mm, addr, frame) < 0) {
+                frame_put(frame);
+                return NULL;
+            }
+        }
+        
+        io_ring_t* ring = (io_ring_t*)frame;
+        ring->flags = flags & IORING_SETUP_SQPOLL;
+        ring->owner_pid = process_getpid();
+        
+        rings[i].ring = ring;
+        rings[i].addr = addr;
+        rings[i].owner_pid = ring->owner_pid;
+        rings[i].flags = ring->flags;
+        return (io_ring_t*)addr;
+    }
+    return NULL;
+}
+
+/* Execute one submission through the regular syscall handlers */
+static int32_t ioring_execute(const io_sqe_t* sqe) {
+    switch (sqe->opcode) {
+        case IORING_OP_NOP:
+            return 0;
+        case IORING_OP_READ:
+            return syscall_dispatch(SYS_READ, sqe->fd, sqe->addr, sqe->len, 0, 0);
+        case IORING_OP_WRITE:
+            return syscall_dispatch(SYS_WRITE, sqe->fd, sqe->addr, sqe->len, 0, 0);
+        case IORING_OP_OPEN:
+            return syscall_dispatch(SYS_OPEN, sqe->addr, sqe->len, 0, 0, 0);
+        case IORING_OP_CLOSE:
+            return syscall_dispatch(SYS_CLOSE, sqe->fd, 0, 0, 0, 0);
+        default:
+            return -1;
+    }
+}
+
+/* Drain up to max submissions; stops early when the CQ is full */
+static int ioring_process(io_ring_t* ring, uint32_t max) {
+    int done = 0;
+    
+    while ((uint32_t)done < max && ring->sq_head != ring->sq_tail) {
+        if (ring->cq_tail - ring->cq_head >= IORING_CQ_ENTRIES) {
+            break;  /* Back-pressure: leave the rest queued */
+        }
+        
+        io_sqe_t sqe = ring->sqes[ring->sq_head & (IORING_ENTRIES - 1)];
+        ring->sq_head++;
+        
+        io_cqe_t* cqe = &ring->cqes[ring->cq_tail & (IORING_CQ_ENTRIES - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->result = ioring_execute(&sqe);
+        __asm__ volatile("" ::: "memory");  /* CQE contents before the tail */
+        ring->cq_tail++;
+        
+        ring->submitted++;
+        ring->completed++;
+        done++;
+    }
+    
+    return done;
+}
+
+/* Doorbell: consume up to to_submit queued entries */
+int ioring_enter(io_ring_t* ring, uint32_t to_submit) {
+    int slot = ioring_slot(ring);
+    if (slot < 0) return slot;
+    
+    return ioring_process(rings[slot].ring, to_submit);
+}
+
+/* Tear down a ring */
+int ioring_destroy(io_ring_t* ring) {
+    int slot = ioring_slot(ring);
+    if (slot < 0) return slot;
+    
+    ioring_free(&rings[slot]);
+    return 0;
+}
+
+/* Free all rings owned by an exiting process */
+void ioring_release(uint32_t pid) {
+    for (int i = 0; i < IORING_MAX_RINGS; i++) {
+        if (rings[i].ring && rings[i].owner_pid == pid) {
+            ioring_free(&rings[i]);
+        }
+    }
+}
+
+/* Drain the calling process's SQPOLL rings (kernel context, not IRQs) */
+void ioring_poll(void) {
+    uint32_t pid = process_getpid();
+    for (int i = 0; i < IORING_MAX_RINGS; i++) {
+        if (rings[i].ring && (rings[i].flags & IORING_SETUP_SQPOLL) &&
+            rings[i].owner_pid == pid) {
+            ioring_process(rings[i].ring, IORING_ENTRIES);
+        }
+    }
+}
@@ -12,10 +12,14 @@ global _isr16, _isr17, _isr18, _isr19, _isr20, _isr21, _isr22, _isr23
 global _isr24, _isr25, _isr26, _isr27, _isr28, _isr29, _isr30, _isr31
 global _irq0, _irq1, _irq2, _irq3, _irq4, _irq5, _irq6, _irq7
 global _irq8, _irq9, _irq10, _irq11, _irq12, _irq13, _irq14, _irq15
+global _lapic_timer_isr, _spurious_isr
+global _isr128, _fork_return, _sysenter_entry
 global _idt_load
 
 extern _isr_handler
 extern _irq_handler
+extern _process_fork_tail
+extern _sysenter_handler
 
 ; Define aliases
 %define isr0 _isr0
@@ -66,9 +70,16 @@ extern _irq_handler
 %define irq13 _irq13
 %define irq14 _irq14
 %define irq15 _irq15
+%define lapic_timer_isr _lapic_timer_isr
+%define spurious_isr _spurious_isr
+%define isr128 _isr128
+%define fork_return _fork_return
+%define sysenter_entry _sysenter_entry
 %define idt_load _idt_load
 %define ISR_HANDLER _isr_handler
 %define IRQ_HANDLER _irq_handler
+%define FORK_TAIL _process_fork_tail
+%define SYSENTER_HANDLER _sysenter_handler
 
 %else
 ; Export ISR handlers without prefix (ELF format)
@@ -78,12 +89,18 @@ global isr16, isr17, isr18, isr19, isr20, isr21, isr22, isr23
 global isr24, isr25, isr26, isr27, isr28, isr29, isr30, isr31
 global irq0, irq1, irq2, irq3, irq4, irq5, irq6, irq7
 global irq8, irq9, irq10, irq11, irq12, irq13, irq14, irq15
+global lapic_timer_isr, spurious_isr
+global isr128, fork_return, sysenter_entry
 global idt_load
 
 extern isr_handler
 extern irq_handler
+extern process_fork_tail
+extern sysenter_handler
 %define ISR_HANDLER isr_handler
 %define IRQ_HANDLER irq_handler
+%define FORK_TAIL process_fork_tail
+%define SYSENTER_HANDLER sysenter_handler
 %endif
 
 ; ============================================
@@ -105,11 +122,11 @@ isr_common_stub:
     mov ax, ds
     push eax
     
-    ; Load kernel data segment
+    ; Load kernel data segment, and %gs (an iret to ring 3 clears it)
     mov ax, 0x10
     mov ds, ax
     mov es, ax
-    mov fs, ax
+    mov ax, 0x30
     mov gs, ax
     
     ; Push pointer to registers structure
@@ -121,12 +138,11 @@ isr_common_stub:
     ; Remove pushed parameter
     add esp, 4
     
+isr_return:
     ; Restore data segment
     pop eax
     mov ds, ax
     mov es, ax
-    mov fs, ax
-    mov gs, ax
     
     ; Restore registers
     popa
@@ -148,11 +164,11 @@ irq_common_stub:
     mov ax, ds
     push eax
     
-    ; Load kernel data segment
+    ; Load kernel data segment, and %gs (an iret to ring 3 clears it)
     mov ax, 0x10
     mov ds, ax
     mov es, ax
-    mov fs, ax
+    mov ax, 0x30
     mov gs, ax
     
     ; Push pointer to registers structure
@@ -168,8 +184,6 @@ irq_common_stub:
     pop eax
     mov ds, ax
     mov es, ax
-    mov fs, ax
-    mov gs, ax
     
     ; Restore registers
     popa
@@ -458,3 +472,82 @@ irq15:
     push byte 15
     push byte 47
     jmp irq_common_stub
+
+; ============================================
+; Local APIC Interrupts
+; ============================================
+
+; Vector 48: Local APIC timer (scheduling tick on APs)
+lapic_timer_isr:
+    push byte 0
+    push byte 48
+    jmp irq_common_stub
+
+; Vector 255: Spurious interrupt (no EOI, nothing to do)
+spurious_isr:
+    iret
+
+; ============================================
+; System Calls
+; ============================================
+
+; Vector 128: int 0x80 (dispatched by syscall_isr)
+isr128:
+    push byte 0
+    push dword 128
+    jmp isr_common_stub
+
+; A forked child starts here, on its copy of the parent's stack with
+; esp at the parent's system call frame: finish the switch, then
+; return from the system call (with eax already cleared)
+fork_return:
+    call FORK_TAIL
+    jmp isr_return
+
+; SYSENTER lands here in ring 0 with interrupts off, on a stack whose
+; only word is this CPU's tss.esp0 (see syscall_init_cpu). The caller
+; passed its esp in ecx and its return address in edx, as SYSEXIT
+; wants them back. Building the same frame as int 0x80 costs a few
+; pushes and lets fork, exit and the C side treat both paths alike.
+sysenter_entry:
+    mov esp, [esp]              ; Kernel stack of the current process
+    push dword 0x23             ; ss (user data, RPL 3)
+    push ecx                    ; useresp
+    pushfd
+    or dword [esp], 0x200       ; The caller ran with interrupts on
+    push dword 0x1B             ; cs (user code, RPL 3)
+    push edx                    ; eip
+    push byte 0                 ; err_code
+    push dword 128              ; int_no, as for int 0x80
+    pusha
+    mov ax, ds
+    push eax
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ax, 0x30
+    mov gs, ax
+    
+    push esp
+    call SYSENTER_HANDLER
+    add esp, 4
+    
+    ; SYSEXIT leaves %gs alone (iret would have cleared it), so drop
+    ; the per-CPU segment with interrupts off for the rest of the way
+    cli
+    xor eax, eax
+    mov gs, ax
+    
+    pop eax
+    mov ds, ax
+    mov es, ax
+    popa
+    add esp, 8
+    
+    ; SYSEXIT takes eip from edx and esp from ecx; sti holds off
+    ; interrupts until after the next instruction, so none can land
+    ; on this stack in ring 3's place
+    mov edx, [esp]
+    mov ecx, [esp + 12]
+    sti
+    sysexit
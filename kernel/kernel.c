@@ -15,11 +15,25 @@
 #include "../include/timer.h"
 #include "../include/rtc.h"
 #include "../include/memory.h"
+#include "../include/paging.h"
+#include "../include/stackpool.h"
+#include "../include/vmm.h"
+#include "../include/vdso.h"
+#include "../include/pipe.h"
+#include "../include/shm.h"
+#include "../include/elf.h"
 #include "../include/tui.h"
 #include "../include/fs.h"
 #include "../include/process.h"
 #include "../include/syscall.h"
+#include "../include/futex.h"
 #include "../include/gui.h"
+#include "../include/ioring.h"
+#include "../include/ata.h"
+#include "../include/fat32.h"
+#include "../include/fpu.h"
+#include "../include/workqueue.h"
+#include "../include/smp.h"
 
 /* Forward declarations */
 static void display_boot_logo(void);
@@ -53,6 +67,9 @@ static void kernel_init(void) {
     /* Initialize VGA driver */
     vga_init();
     
+    /* Load our own GDT and per-CPU data before anything asks which CPU it is on */
+    smp_early_init();
+    
     /* Initialize IDT (interrupts) */
     idt_init();
     
@@ -65,14 +82,38 @@ static void kernel_init(void) {
     /* Initialize memory manager */
     memory_init();
     
+    /* Turn on paging, carve out guarded process stacks, program frames and the vDSO */
+    paging_init();
+    stack_pool_init();
+    vmm_init();
+    vdso_init();
+    
     /* Initialize filesystem */
     fs_init();
     
-    /* Initialize process manager */
+    /* Probe ATA disks and mount a FAT32 volume from the second disk */
+    ata_init();
+    fat32_mount(ATA_DRIVE_SLAVE);
+    
+    /* Initialize process manager and start preempting */
     process_init();
+    fpu_init();
+    scheduler_init();
+    
+    /* Start kernel worker threads */
+    workqueue_init();
     
     /* Initialize system calls */
     syscall_init();
+    futex_init();
+    elf_init();
+    
+    /* Initialize pipes and shared memory */
+    pipe_init();
+    shm_init();
+    
+    /* Initialize asynchronous I/O rings */
+    ioring_init();
     
     /* Initialize GUI */
     gui_init();
@@ -80,6 +121,9 @@ static void kernel_init(void) {
     /* Enable interrupts */
     __asm__ volatile("sti");
     
+    /* Start the other CPUs (calibrates against the running PIT) */
+    smp_init();
+    
     /* Initialize keyboard driver */
     keyboard_init();
     
@@ -0,0 +1,129 @@
+/*
+ * NightOS - Paging Implementation
+ * 
+ * The whole 32-bit space is identity-mapped, so turning paging on
+ * changes no addresses. Memory is covered by 4MB pages; only the
+ * process stack region gets a 4KB page table, so the pages between
+ * stacks can be left unmapped as guards. Kernel threads share the one
+ * kernel page directory; processes running a program get a copy of it
+ * with their own user region (kernel/vmm.c).
+ */
+
+#include "../include/paging.h"
+#include "../include/config.h"
+#include "../include/string.h"
+#include "../include/smp.h"
+
+#define CR0_WP              0x00010000  /* Honour read-only pages in ring 0 */
+#define CR0_PG              0x80000000
+#define CR4_PSE             0x00000010
+
+/* Kernel page directory and the 4KB tables of the stack region */
+#define STACK_TABLES        (STACK_POOL_SIZE / PAGE_LARGE_SIZE)
+
+static uint32_t page_directory[PAGE_TABLE_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t stack_tables[STACK_TABLES][PAGE_TABLE_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+
+/* ========== Low-level Helpers ========== */
+
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value));
+}
+
+/* Page table entry for virt, or NULL if it is covered by a 4MB page */
+static uint32_t* page_entry(uint32_t virt) {
+    uint32_t pde = page_directory[PAGE_DIR_INDEX(virt)];
+    if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE)) return NULL;
+    
+    uint32_t* table = (uint32_t*)(pde & PAGE_FRAME_MASK);
+    return &table[PAGE_TABLE_INDEX(virt)];
+}
+
+/* ========== Setup ========== */
+
+/* Load the kernel directory and enable 4MB pages and paging on this CPU */
+static void paging_enable(void) {
+    write_cr4(read_cr4() | CR4_PSE);
+    load_cr3((uint32_t)page_directory);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+    
+    /* A double fault task runs in the kernel address space too */
+    this_cpu()->df_tss.cr3 = (uint32_t)page_directory;
+}
+
+/* Build the kernel page directory and turn paging on for the BSP */
+void paging_init(void) {
+    memset(page_directory, 0, sizeof(page_directory));
+    
+    for (uint32_t i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        uint32_t base = i * PAGE_LARGE_SIZE;
+        if (base >= USER_BASE && base < USER_TOP) continue;
+        
+        uint32_t flags = PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE;
+        if (base >= PAGING_MMIO_BASE) flags |= PAGE_NOCACHE | PAGE_WRITETHROUGH;
+        page_directory[i] = base | flags;
+    }
+    
+    /* The stack region is mapped a page at a time */
+    for (uint32_t t = 0; t < STACK_TABLES; t++) {
+        uint32_t base = STACK_POOL_BASE + t * PAGE_LARGE_SIZE;
+        for (uint32_t i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+            stack_tables[t][i] = (base + i * PAGE_SIZE) | PAGE_PRESENT | PAGE_WRITE;
+        }
+        page_directory[PAGE_DIR_INDEX(base)] = (uint32_t)stack_tables[t] | PAGE_PRESENT | PAGE_WRITE;
+    }
+    
+    paging_enable();
+}
+
+/* Turn paging on for an application processor */
+void paging_init_cpu(void) {
+    paging_enable();
+}
+
+/* Physical address of the kernel page directory (for CR3 and TSSes) */
+uint32_t paging_kernel_directory(void) {
+    return (uint32_t)page_directory;
+}
+
+/* ========== Mappings ========== */
+
+/* Map or unmap one identity-mapped 4KB page in a 4KB-paged region */
+bool paging_set_present(uint32_t virt, bool present) {
+    uint32_t* pte = page_entry(virt);
+    if (!pte) return false;
+    
+    if (present) {
+        *pte |= PAGE_PRESENT;
+    } else {
+        *pte &= ~PAGE_PRESENT;
+    }
+    invlpg(virt);
+    return true;
+}
+
+/* True if an access to virt would not fault */
+bool paging_is_mapped(uint32_t virt) {
+    uint32_t pde = page_directory[PAGE_DIR_INDEX(virt)];
+    if (!(pde & PAGE_PRESENT)) return false;
+    if (pde & PAGE_LARGE) return true;
+    
+    uint32_t* pte = page_entry(virt);
+    return pte && (*pte & PAGE_PRESENT);
+}
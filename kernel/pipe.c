@@ -0,0 +1,311 @@
+/*
+ * NightOS - Pipe Implementation
+ * 
+ * A pipe is a ring of buffers, each a pool frame with a run of unread
+ * bytes. Small writes are copied onto the last page while it has room.
+ * A whole page-aligned page of a program's memory is not copied at all:
+ * mm_lend_page makes the writer's page copy-on-write and hands the pipe
+ * a reference to its frame, so the reader copies straight out of the
+ * writer's memory and the data crosses the kernel once instead of
+ * twice. Either way a buffer is dropped with frame_put once read.
+ * 
+ * Each end counts the processes holding it, and each process keeps a
+ * bit per end it holds (pipe_ends): fork copies the bits and takes a
+ * reference on every end, and close or exit drops them. A pipe reads
+ * as ended once no process holds its write end, and refuses writes
+ * once none holds its read end.
+ * 
+ * One mutex covers every pipe; each has condition variables for
+ * readers waiting on data and writers waiting on space.
+ */
+
+#include "../include/pipe.h"
+#include "../include/vmm.h"
+#include "../include/process.h"
+#include "../include/sync.h"
+#include "../include/errno.h"
+#include "../include/string.h"
+#include "../include/uaccess.h"
+
+/* A run of unread bytes in a frame */
+typedef struct {
+    uint32_t frame;
+    uint16_t offset;
+    uint16_t len;
+    bool lent;                          /* A writer's page: read-only to us */
+} pipe_buf_t;
+
+typedef struct {
+    bool in_use;
+    uint32_t readers;                   /* Processes holding the read end */
+    uint32_t writers;                   /* ...and the write end */
+    uint32_t head;                      /* Oldest buffer */
+    uint32_t count;                     /* Buffers in the ring */
+    pipe_buf_t bufs[PIPE_BUFFERS];
+    condvar_t readable;
+    condvar_t writable;
+} pipe_t;
+
+static pipe_t pipes[PIPE_MAX];
+static mutex_t pipe_mutex;
+static uint32_t bytes_copied = 0;
+static uint32_t pages_lent = 0;
+
+/* Initialize the pipe table */
+void pipe_init(void) {
+    mutex_init(&pipe_mutex, "pipes");
+    memset(pipes, 0, sizeof(pipes));
+    for (int i = 0; i < PIPE_MAX; i++) {
+        condvar_init(&pipes[i].readable);
+        condvar_init(&pipes[i].writable);
+    }
+}
+
+/* Bit of an end in a process's pipe_ends */
+static inline uint32_t pipe_bit(uint32_t fd) {
+    return 1u << (fd - PIPE_FD_BASE);
+}
+
+/* The pipe behind an end the calling process holds, or NULL (pipe_mutex held) */
+static pipe_t* pipe_end(uint32_t fd, bool write) {
+    if (!pipe_is_fd(fd) || ((fd - PIPE_FD_BASE) & 1) != (write ? 1u : 0u)) return NULL;
+    if (!(process_current()->pipe_ends & pipe_bit(fd))) return NULL;
+    
+    pipe_t* pipe = &pipes[(fd - PIPE_FD_BASE) / 2];
+    return pipe->in_use ? pipe : NULL;
+}
+
+static inline pipe_buf_t* pipe_tail(pipe_t* pipe) {
+    return &pipe->bufs[(pipe->head + pipe->count - 1) % PIPE_BUFFERS];
+}
+
+/* Append a buffer; the ring must have room */
+static pipe_buf_t* pipe_push(pipe_t* pipe, uint32_t frame, uint32_t len, bool lent) {
+    pipe->count++;
+    pipe_buf_t* buf = pipe_tail(pipe);
+    buf->frame = frame;
+    buf->offset = 0;
+    buf->len = (uint16_t)len;
+    buf->lent = lent;
+    return buf;
+}
+
+/* Last buffer if more bytes can be copied onto it, else NULL */
+static pipe_buf_t* pipe_tail_room(pipe_t* pipe) {
+    if (!pipe->count) return NULL;
+    pipe_buf_t* buf = pipe_tail(pipe);
+    if (buf->lent || buf->offset + buf->len >= PAGE_SIZE) return NULL;
+    return buf;
+}
+
+/* Drop every buffer (pipe_mutex held) */
+static void pipe_drain(pipe_t* pipe) {
+    while (pipe->count) {
+        frame_put(pipe->bufs[pipe->head].frame);
+        pipe->head = (pipe->head + 1) % PIPE_BUFFERS;
+        pipe->count--;
+    }
+}
+
+/* Drop a hold on one end; the last of both frees the pipe (pipe_mutex held) */
+static void pipe_put_end(pipe_t* pipe, bool write) {
+    /* Once the last holder is gone, readers see end of file, writers -EPIPE */
+    if (write) {
+        if (--pipe->writers == 0) condvar_broadcast(&pipe->readable);
+    } else if (--pipe->readers == 0) {
+        pipe_drain(pipe);
+        condvar_broadcast(&pipe->writable);
+    }
+    
+    if (!pipe->readers && !pipe->writers) {
+        pipe_drain(pipe);
+        pipe->in_use = false;
+    }
+}
+
+/* Open a pipe: fds[0] reads, fds[1] writes */
+int pipe_create(int fds[2]) {
+    mutex_lock(&pipe_mutex);
+    for (int i = 0; i < PIPE_MAX; i++) {
+        pipe_t* pipe = &pipes[i];
+        if (pipe->in_use) continue;
+        
+        pipe->in_use = true;
+        pipe->readers = 1;
+        pipe->writers = 1;
+        pipe->head = 0;
+        pipe->count = 0;
+        
+        fds[0] = PIPE_FD_BASE + 2 * i;
+        fds[1] = PIPE_FD_BASE + 2 * i + 1;
+        process_current()->pipe_ends |= pipe_bit(fds[0]) | pipe_bit(fds[1]);
+        mutex_unlock(&pipe_mutex);
+        return 0;
+    }
+    mutex_unlock(&pipe_mutex);
+    return -ENFILE;
+}
+
+/* Read what is there, up to count bytes, once there is anything */
+int pipe_read(uint32_t fd, void* buf, uint32_t count) {
+    mutex_lock(&pipe_mutex);
+    pipe_t* pipe = pipe_end(fd, false);
+    while (pipe && pipe->count == 0 && pipe->writers) {
+        condvar_wait(&pipe->readable, &pipe_mutex);
+        pipe = pipe_end(fd, false);         /* Closed while we slept? */
+    }
+    if (!pipe) {
+        mutex_unlock(&pipe_mutex);
+        return -EBADF;
+    }
+    
+    uint8_t* dst = (uint8_t*)buf;
+    uint32_t done = 0;
+    int result = 0;
+    while (done < count && pipe->count) {
+        pipe_buf_t* b = &pipe->bufs[pipe->head];
+        uint32_t n = MIN(count - done, b->len);
+        if (copy_to_user(dst + done, (const uint8_t*)b->frame + b->offset, n) < 0) {
+            result = -EFAULT;
+            break;
+        }
+        b->offset += n;
+        b->len -= n;
+        done += n;
+        
+        if (b->len == 0) {
+            frame_put(b->frame);
+            pipe->head = (pipe->head + 1) % PIPE_BUFFERS;
+            pipe->count--;
+        }
+    }
+    
+    if (done) condvar_broadcast(&pipe->writable);
+    mutex_unlock(&pipe_mutex);
+    return done ? (int)done : result;
+}
+
+/* Write all count bytes, lending whole pages and copying the rest */
+int pipe_write(uint32_t fd, const void* buf, uint32_t count) {
+    const uint8_t* src = (const uint8_t*)buf;
+    mm_t* mm = process_current()->mm;
+    uint32_t done = 0;
+    int result = 0;
+    
+    mutex_lock(&pipe_mutex);
+    pipe_t* pipe = pipe_end(fd, true);
+    while (pipe && done < count) {
+        if (!pipe->readers) {
+            result = -EPIPE;
+            break;
+        }
+        
+        uint32_t addr = (uint32_t)(src + done);
+        uint32_t left = count - done;
+        pipe_buf_t* tail = pipe_tail_room(pipe);
+        
+        if (!tail && pipe->count == PIPE_BUFFERS) {
+            condvar_wait(&pipe->writable, &pipe_mutex);
+            pipe = pipe_end(fd, true);
+            continue;
+        }
+        
+        /* A whole page of the program's memory: lend the pipe its frame */
+        if (mm && left >= PAGE_SIZE && !(addr & (PAGE_SIZE - 1)) &&
+            pipe->count < PIPE_BUFFERS && access_ok((const void*)addr, PAGE_SIZE)) {
+            uint32_t frame = mm_lend_page(mm, addr);
+            if (frame) {
+                pipe_push(pipe, frame, PAGE_SIZE, true);
+                done += PAGE_SIZE;
+                pages_lent++;
+                condvar_broadcast(&pipe->readable);
+                continue;
+            }
+        }
+        
+        /* Otherwise copy onto the last page, or a new one */
+        if (!tail) {
+            uint32_t frame = frame_alloc();
+            if (!frame) {
+                result = -ENOMEM;
+                break;
+            }
+            tail = pipe_push(pipe, frame, 0, false);
+        }
+        
+        uint32_t start = tail->offset + tail->len;
+        uint32_t n = MIN(left, PAGE_SIZE - start);
+        if (copy_from_user((uint8_t*)tail->frame + start, src + done, n) < 0) {
+            if (tail->len == 0) {
+                /* The page we just added stays empty: take it back */
+                frame_put(tail->frame);
+                pipe->count--;
+            }
+            result = -EFAULT;
+            break;
+        }
+        tail->len += n;
+        done += n;
+        bytes_copied += n;
+        condvar_broadcast(&pipe->readable);
+    }
+    mutex_unlock(&pipe_mutex);
+    
+    if (!pipe && !done) return -EBADF;
+    return done ? (int)done : result;
+}
+
+/* Let go of one end; the pipe is freed once nobody holds either */
+int pipe_close(uint32_t fd) {
+    bool write = ((fd - PIPE_FD_BASE) & 1) != 0;
+    
+    mutex_lock(&pipe_mutex);
+    pipe_t* pipe = pipe_end(fd, write);
+    if (!pipe) {
+        mutex_unlock(&pipe_mutex);
+        return -EBADF;
+    }
+    
+    process_current()->pipe_ends &= ~pipe_bit(fd);
+    pipe_put_end(pipe, write);
+    mutex_unlock(&pipe_mutex);
+    return 0;
+}
+
+/* A forked child holds ends (a pipe_ends mask) as well as its parent */
+void pipe_fork(uint32_t ends) {
+    mutex_lock(&pipe_mutex);
+    for (uint32_t n = 0; n < 2 * PIPE_MAX; n++) {
+        if (!(ends & (1u << n))) continue;
+        
+        pipe_t* pipe = &pipes[n / 2];
+        if (n & 1) {
+            pipe->writers++;
+        } else {
+            pipe->readers++;
+        }
+    }
+    mutex_unlock(&pipe_mutex);
+}
+
+/* Let go of every end in ends, for a process that is exiting */
+void pipe_release(uint32_t ends) {
+    mutex_lock(&pipe_mutex);
+    for (uint32_t n = 0; n < 2 * PIPE_MAX; n++) {
+        if (ends & (1u << n)) {
+            pipe_put_end(&pipes[n / 2], (n & 1) != 0);
+        }
+    }
+    mutex_unlock(&pipe_mutex);
+}
+
+void pipe_get_stats(pipe_stats_t* stats) {
+    mutex_lock(&pipe_mutex);
+    stats->open = 0;
+    for (int i = 0; i < PIPE_MAX; i++) {
+        if (pipes[i].in_use) stats->open++;
+    }
+    stats->bytes_copied = bytes_copied;
+    stats->pages_lent = pages_lent;
+    mutex_unlock(&pipe_mutex);
+}
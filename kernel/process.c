@@ -1,7 +1,18 @@
 /*
  * NightOS - Process Management Implementation
  * 
- * Simple cooperative multitasking system
+ * Two scheduling classes per CPU. REALTIME processes round-robin in
+ * a FIFO run queue and always run first. Everyone else is in the
+ * fair class: a red-black tree ordered by virtual runtime, the TSC
+ * cycles a process has used scaled down by its priority's weight, so
+ * the leftmost process is the one furthest behind its share. New
+ * processes go to the least loaded CPU, and a CPU with no REALTIME
+ * work whose queue is clearly shorter than another's steals from it
+ * when it reschedules.
+ * One lock covers every queue; it is taken with interrupts off and
+ * handed across context_switch to the incoming process, which drops it.
+ * A tick that lands inside a preempt_disable() section only marks the
+ * CPU; the switch happens when the section ends.
  */
 
 #include "../include/process.h"
@@ -9,218 +20,1481 @@
 #include "../include/string.h"
 #include "../include/timer.h"
 #include "../include/vga.h"
+#include "../include/io.h"
+#include "../include/ioring.h"
+#include "../include/pipe.h"
+#include "../include/shm.h"
+#include "../include/fpu.h"
+#include "../include/smp.h"
+#include "../include/sync.h"
+#include "../include/stackpool.h"
+#include "../include/vmm.h"
+#include "../include/errno.h"
+#include "../include/gdt.h"
+#include "../include/vdso.h"
 
-/* Process table */
-static process_t processes[MAX_PROCESSES];
-static uint32_t current_pid = 0;
+/* PCB pool: chunks of kmalloc'd PCBs recycled through a free-list */
+static process_t* pcb_free_list = NULL;
+static int pcb_allocated = 0;
+
+/* Live processes: PID hash for lookup, a list for iteration */
+static process_t* pid_hash[PID_HASH_BUCKETS];
+static process_t* task_head = NULL;
+static process_t* task_tail = NULL;
+static int state_counts[PROC_STATE_COUNT];
+static int live_processes = 0;
+
+static process_t* kernel_process = NULL;
 static uint32_t next_pid = 1;
 static bool scheduler_enabled = false;
 
-/* Initialize process manager */
-void process_init(void) {
-    memset(processes, 0, sizeof(processes));
+/* FIFO of READY REALTIME processes; the other priorities are fair */
+typedef struct run_queue {
+    process_t* head;
+    process_t* tail;
+    uint32_t count;
+} run_queue_t;
+
+/*
+ * Scheduler state of one CPU. REALTIME processes that used up their
+ * slice wait in the expired set until the active one drains; fair
+ * processes wait on the timeline.
+ */
+typedef struct {
+    process_t* running;         /* Process on this CPU right now */
+    process_t* idle;            /* Runs when nothing is READY; never queued */
+    process_t* dead;            /* Exited; stack freed once we are off it */
+    bool need_resched;
+    run_queue_t queues[2];
+    run_queue_t* active;
+    run_queue_t* expired;
+    rb_tree_t timeline;         /* READY fair processes by vruntime */
+    uint32_t fair_queued;
+    uint32_t fair_weight;       /* Sum of the queued fair processes' weights */
+    uint64_t min_vruntime;      /* Never decreases; floor for new and waking */
+    process_t* skip;            /* Just yielded: passed over by the next pick */
+    uint64_t acct_stamp;        /* TSC of the last accounting event */
+    uint32_t acct_state;        /* What the running process is doing */
+} sched_cpu_t;
+
+static sched_cpu_t sched_cpus[SMP_MAX_CPUS];
+
+#define this_sched()    (&sched_cpus[smp_cpu_id()])
+#define current         (this_sched()->running)
+
+/* Guards run queues, the sleep queue, the PID hash and the task list */
+static spinlock_t sched_lock;
+
+/* Fair class weights, about 1.25x per Unix nice level (LOW ~ +5, HIGH ~ -5) */
+#define WEIGHT_LOW      335
+#define WEIGHT_HIGH     3121
+#define WEIGHT_RT       9548
+
+static const uint32_t sched_weight[SCHED_PRIORITIES] = {
+    WEIGHT_LOW, SCHED_NICE0_WEIGHT, WEIGHT_HIGH, WEIGHT_RT
+};
+
+/* NICE0 weight / weight in 16.16 fixed point, so charging needs no divide */
+static const uint32_t sched_wmult[SCHED_PRIORITIES] = {
+    (SCHED_NICE0_WEIGHT << 16) / WEIGHT_LOW,
+    1 << 16,
+    (SCHED_NICE0_WEIGHT << 16) / WEIGHT_HIGH,
+    (SCHED_NICE0_WEIGHT << 16) / WEIGHT_RT
+};
+
+static uint32_t min_granularity_ms = SCHED_MIN_GRANULARITY_MS;
+
+/* TSC cycles per PIT tick, measured by the BSP (0 until the second tick) */
+static uint32_t tick_cycles = 0;
+static uint64_t last_tick_tsc = 0;
+
+/* Sleeping processes, earliest wake tick first */
+static process_t* sleep_queue = NULL;
+
+/* Parents in wait, keyed by their PID (+1, so the kernel's is nonzero) */
+static wait_queue_t child_exit = WAIT_QUEUE_INIT;
+#define CHILD_KEY(pid)  ((pid) + 1)
+
+static void schedule_locked(void);
+
+/* ========== PCB Pool ========== */
+
+/* Move a process to a new state, keeping the per-state counters exact */
+static void set_state(process_t* proc, proc_state_t state) {
+    if (proc->state != PROC_STATE_FREE) state_counts[proc->state]--;
+    if (state != PROC_STATE_FREE) state_counts[state]++;
+    proc->state = state;
+}
+
+/* Take a zeroed PCB off the free-list, refilling it a chunk at a time */
+static process_t* pcb_alloc(void) {
+    if (!pcb_free_list) {
+        if (pcb_allocated + PCB_POOL_CHUNK > MAX_PROCESSES) return NULL;
+        
+        process_t* chunk = (process_t*)kmalloc(sizeof(process_t) * PCB_POOL_CHUNK);
+        if (!chunk) return NULL;
+        
+        for (int i = 0; i < PCB_POOL_CHUNK; i++) {
+            chunk[i].hash_next = pcb_free_list;
+            pcb_free_list = &chunk[i];
+        }
+        pcb_allocated += PCB_POOL_CHUNK;
+    }
     
-    /* Create kernel process (PID 0) */
-    processes[0].pid = 0;
-    strcpy(processes[0].name, "kernel");
-    processes[0].state = PROC_STATE_RUNNING;
-    processes[0].priority = PROC_PRIORITY_REALTIME;
-    processes[0].created_time = timer_get_seconds();
-    processes[0].parent_pid = 0;
+    process_t* proc = pcb_free_list;
+    pcb_free_list = proc->hash_next;
+    memset(proc, 0, sizeof(process_t));
+    return proc;
+}
+
+/* Hash, list and count a freshly initialized PCB */
+static void pcb_publish(process_t* proc, proc_state_t state) {
+    uint32_t bucket = proc->pid % PID_HASH_BUCKETS;
+    proc->hash_next = pid_hash[bucket];
+    pid_hash[bucket] = proc;
     
-    current_pid = 0;
-    next_pid = 1;
+    proc->task_prev = task_tail;
+    if (task_tail) {
+        task_tail->task_next = proc;
+    } else {
+        task_head = proc;
+    }
+    task_tail = proc;
+    
+    live_processes++;
+    set_state(proc, state);
+}
+
+/* Return a PCB that is not (or no longer) published to the free-list */
+static void pcb_free(process_t* proc) {
+    memset(proc, 0, sizeof(process_t));
+    proc->hash_next = pcb_free_list;
+    pcb_free_list = proc;
+}
+
+/* Unhash and unlist a PCB and return it to the free-list */
+static void pcb_release(process_t* proc) {
+    process_t** link = &pid_hash[proc->pid % PID_HASH_BUCKETS];
+    while (*link != proc) {
+        link = &(*link)->hash_next;
+    }
+    *link = proc->hash_next;
+    
+    if (proc->task_prev) {
+        proc->task_prev->task_next = proc->task_next;
+    } else {
+        task_head = proc->task_next;
+    }
+    if (proc->task_next) {
+        proc->task_next->task_prev = proc->task_prev;
+    } else {
+        task_tail = proc->task_prev;
+    }
+    
+    live_processes--;
+    set_state(proc, PROC_STATE_FREE);
+    pcb_free(proc);
+}
+
+/* ========== Run Queues ========== */
+
+/* Append a READY REALTIME process to the tail of a queue */
+static void rq_enqueue(run_queue_t* rq, process_t* proc) {
+    proc->run_next = NULL;
+    proc->run_prev = rq->tail;
+    proc->run_queue = rq;
+    
+    if (rq->tail) {
+        rq->tail->run_next = proc;
+    } else {
+        rq->head = proc;
+    }
+    rq->tail = proc;
+    rq->count++;
+}
+
+/* Unlink a process from whichever queue holds it */
+static void rq_remove(process_t* proc) {
+    run_queue_t* rq = proc->run_queue;
+    if (!rq) return;
+    
+    if (proc->run_prev) {
+        proc->run_prev->run_next = proc->run_next;
+    } else {
+        rq->head = proc->run_next;
+    }
+    if (proc->run_next) {
+        proc->run_next->run_prev = proc->run_prev;
+    } else {
+        rq->tail = proc->run_prev;
+    }
+    rq->count--;
+    
+    proc->run_next = NULL;
+    proc->run_prev = NULL;
+    proc->run_queue = NULL;
+}
+
+/* Dequeue the process at the head, if any */
+static process_t* rq_pick(run_queue_t* rq) {
+    process_t* proc = rq->head;
+    if (proc) rq_remove(proc);
+    return proc;
+}
+
+/* ========== Fair Class ========== */
+
+static inline bool is_fair(const process_t* proc) {
+    return proc->priority != PROC_PRIORITY_REALTIME;
+}
+
+/* Timeline order; compared as a difference so wrap-around is harmless */
+static bool vruntime_less(const rb_node_t* a, const rb_node_t* b) {
+    const process_t* pa = rb_entry(a, process_t, run_node);
+    const process_t* pb = rb_entry(b, process_t, run_node);
+    return (int64_t)(pa->vruntime - pb->vruntime) < 0;
+}
+
+/* TSC cycles per millisecond (0 until the tick has been measured) */
+static inline uint32_t cycles_per_ms(void) {
+    return tick_cycles / (1000 / TIMER_FREQUENCY);
+}
+
+static void fair_enqueue(sched_cpu_t* sc, process_t* proc) {
+    rb_insert(&sc->timeline, &proc->run_node, vruntime_less);
+    proc->on_timeline = true;
+    sc->fair_queued++;
+    sc->fair_weight += sched_weight[proc->priority];
+}
+
+static void fair_dequeue(sched_cpu_t* sc, process_t* proc) {
+    rb_erase(&sc->timeline, &proc->run_node);
+    proc->on_timeline = false;
+    sc->fair_queued--;
+    sc->fair_weight -= sched_weight[proc->priority];
+    if (sc->skip == proc) sc->skip = NULL;
+}
+
+/* Raise min_vruntime to the smaller of the running and leftmost vruntimes */
+static void update_min_vruntime(sched_cpu_t* sc) {
+    process_t* curr = sc->running;
+    rb_node_t* left = rb_first(&sc->timeline);
+    bool have_curr = curr && curr != sc->idle && is_fair(curr);
+    
+    if (!have_curr && !left) return;
+    
+    uint64_t vruntime = have_curr ? curr->vruntime
+                                  : rb_entry(left, process_t, run_node)->vruntime;
+    if (have_curr && left) {
+        uint64_t left_vruntime = rb_entry(left, process_t, run_node)->vruntime;
+        if ((int64_t)(left_vruntime - vruntime) < 0) vruntime = left_vruntime;
+    }
+    if ((int64_t)(vruntime - sc->min_vruntime) > 0) {
+        sc->min_vruntime = vruntime;
+    }
+}
+
+/* Charge the running process for the cycles since it was last charged */
+static void update_curr(sched_cpu_t* sc) {
+    process_t* curr = sc->running;
+    uint64_t now = rdtsc();
+    uint64_t delta = now - curr->exec_start;
+    curr->exec_start = now;
+    
+    if (curr == sc->idle || !is_fair(curr)) return;
+    
+    uint32_t cycles = delta > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)delta;
+    curr->slice_exec = (curr->slice_exec + cycles < curr->slice_exec)
+                     ? 0xFFFFFFFF : curr->slice_exec + cycles;
+    curr->vruntime += ((uint64_t)cycles * sched_wmult[curr->priority]) >> 16;
+    update_min_vruntime(sc);
+}
+
+/* Running process's share of the latency period, at least the granularity */
+static uint32_t fair_slice(sched_cpu_t* sc, process_t* proc) {
+    uint32_t per_ms = cycles_per_ms();
+    uint32_t weight = sched_weight[proc->priority];
+    uint32_t slice = (SCHED_LATENCY_MS * per_ms) / (sc->fair_weight + weight) * weight;
+    return MAX(slice, min_granularity_ms * per_ms);
+}
+
+/* A waking sleeper gets at most half a latency period of credit */
+static void place_waking(sched_cpu_t* sc, process_t* proc) {
+    uint64_t floor = sc->min_vruntime - (uint64_t)(SCHED_LATENCY_MS / 2) * cycles_per_ms();
+    if ((int64_t)(proc->vruntime - floor) < 0) {
+        proc->vruntime = floor;
+    }
+}
+
+/* Dequeue the leftmost fair process, passing over one that just yielded */
+static process_t* fair_pick(sched_cpu_t* sc) {
+    rb_node_t* node = rb_first(&sc->timeline);
+    if (!node) return NULL;
+    
+    if (rb_entry(node, process_t, run_node) == sc->skip && rb_next(node)) {
+        node = rb_next(node);
+    }
+    sc->skip = NULL;
+    
+    process_t* proc = rb_entry(node, process_t, run_node);
+    fair_dequeue(sc, proc);
+    return proc;
+}
+
+/* Should a process made READY on sc take the CPU from what runs there? */
+static bool should_preempt(sched_cpu_t* sc, process_t* proc) {
+    process_t* curr = sc->running;
+    
+    if (curr == sc->idle) return true;
+    if (!is_fair(proc)) {
+        return is_fair(curr) || proc->priority > curr->priority;
+    }
+    if (!is_fair(curr)) return false;
+    
+    /* Only if it is behind by more than the granularity, to limit switching */
+    uint64_t granularity = (uint64_t)min_granularity_ms * cycles_per_ms();
+    return (int64_t)(curr->vruntime - proc->vruntime) > (int64_t)granularity;
+}
+
+/* ========== CPU Accounting ========== */
+
+/* Charge the cycles since the last event to the running process's state */
+static void acct_charge(sched_cpu_t* sc, uint64_t now) {
+    process_t* proc = sc->running;
+    uint32_t state = sc->acct_state;
+    if (state == ACCT_KERNEL && proc == sc->idle) {
+        state = ACCT_IDLE;
+    }
+    proc->cycles[state] += now - sc->acct_stamp;
+    sc->acct_stamp = now;
+}
+
+/* Interrupt entry: close the interrupted state, returning it for acct_exit */
+uint32_t acct_enter(uint32_t state, bool from_user) {
+    sched_cpu_t* sc = this_sched();
+    if (!sc->running) return state;
+    
+    if (from_user) sc->acct_state = ACCT_USER;
+    uint32_t prev = sc->acct_state;
+    acct_charge(sc, rdtsc());
+    sc->acct_state = state;
+    return prev;
+}
+
+/* Interrupt exit: charge the handler and resume the interrupted state */
+void acct_exit(uint32_t prev_state) {
+    sched_cpu_t* sc = this_sched();
+    if (!sc->running) return;
+    
+    acct_charge(sc, rdtsc());
+    sc->acct_state = prev_state;
+}
+
+/* TSC cycles per millisecond, measured against the PIT (0 until known) */
+uint32_t scheduler_cycles_per_ms(void) {
+    return cycles_per_ms();
+}
+
+/* ========== Class Dispatch ========== */
+
+/* Queue a READY process on sc in its class */
+static void enqueue_task(sched_cpu_t* sc, process_t* proc) {
+    if (is_fair(proc)) {
+        fair_enqueue(sc, proc);
+    } else {
+        rq_enqueue(sc->active, proc);
+    }
+}
+
+/* Take a process off whichever queue holds it, if any */
+static void dequeue_task(process_t* proc) {
+    if (proc->on_timeline) {
+        fair_dequeue(&sched_cpus[proc->cpu], proc);
+    } else {
+        rq_remove(proc);
+    }
+}
+
+/* Make a process READY on its CPU and preempt there if it should run first */
+static void make_ready(process_t* proc) {
+    /* Blocked but not yet switched out: it simply keeps running */
+    if (proc->on_cpu) {
+        set_state(proc, PROC_STATE_RUNNING);
+        return;
+    }
+    
+    sched_cpu_t* sc = &sched_cpus[proc->cpu];
+    set_state(proc, PROC_STATE_READY);
+    if (is_fair(proc)) {
+        place_waking(sc, proc);
+    }
+    enqueue_task(sc, proc);
+    
+    if (should_preempt(sc, proc)) {
+        sc->need_resched = true;
+    }
+}
+
+/* READY REALTIME processes queued on a CPU */
+static inline uint32_t rt_queued(sched_cpu_t* sc) {
+    return sc->active->count + sc->expired->count;
+}
+
+/* READY processes queued on a CPU */
+static uint32_t sched_queued(sched_cpu_t* sc) {
+    return rt_queued(sc) + sc->fair_queued;
+}
+
+/* Online CPU with the least work, for placing a new process */
+static uint32_t least_loaded_cpu(void) {
+    uint32_t best = smp_cpu_id();
+    uint32_t best_load = 0xFFFFFFFF;
+    
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (!smp_cpu(i)) continue;
+        
+        sched_cpu_t* sc = &sched_cpus[i];
+        uint32_t load = sched_queued(sc) + (sc->running != sc->idle ? 1 : 0);
+        if (load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+/*
+ * Pull one READY process over from the CPU with the most queued, if it
+ * has at least two more than we do (or any at all when we have none).
+ */
+static process_t* steal_task(uint32_t self) {
+    uint32_t own = sched_queued(&sched_cpus[self]);
+    uint32_t threshold = own ? own + 1 : 0;
+    sched_cpu_t* busiest = NULL;
+    uint32_t most = threshold;
+    
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (i == self || !smp_cpu(i)) continue;
+        
+        uint32_t queued = sched_queued(&sched_cpus[i]);
+        if (queued > most) {
+            busiest = &sched_cpus[i];
+            most = queued;
+        }
+    }
+    if (!busiest) return NULL;
+    
+    /* Expired processes have waited longest and are coldest in cache */
+    process_t* proc = rq_pick(busiest->expired);
+    if (!proc) proc = rq_pick(busiest->active);
+    
+    /* Else the fair process that would wait longest, rebased to our clock */
+    if (!proc) {
+        proc = rb_entry(rb_last(&busiest->timeline), process_t, run_node);
+        fair_dequeue(busiest, proc);
+        proc->vruntime = proc->vruntime - busiest->min_vruntime
+                       + sched_cpus[self].min_vruntime;
+    }
+    
+    proc->cpu = self;
+    smp_cpu(self)->steals++;
+    return proc;
+}
+
+/* ========== Sleep Queue ========== */
+
+/* Insert a process in wake-tick order */
+static void sleep_enqueue(process_t* proc) {
+    process_t** link = &sleep_queue;
+    while (*link && (int32_t)((*link)->wake_tick - proc->wake_tick) <= 0) {
+        link = &(*link)->sleep_next;
+    }
+    proc->sleep_next = *link;
+    *link = proc;
+    proc->sleeping = true;
+}
+
+/* Take a process off the sleep queue (early wake or kill) */
+static void sleep_remove(process_t* proc) {
+    if (!proc->sleeping) return;
+    proc->sleeping = false;
+    
+    for (process_t** link = &sleep_queue; *link; link = &(*link)->sleep_next) {
+        if (*link == proc) {
+            *link = proc->sleep_next;
+            proc->sleep_next = NULL;
+            return;
+        }
+    }
+}
+
+/* Wake every sleeper whose time has come; stops at the first that hasn't */
+static void sleep_wake_expired(uint32_t now) {
+    while (sleep_queue && (int32_t)(now - sleep_queue->wake_tick) >= 0) {
+        process_t* proc = sleep_queue;
+        sleep_queue = proc->sleep_next;
+        proc->sleep_next = NULL;
+        proc->sleeping = false;
+        make_ready(proc);
+    }
+}
+
+/* ========== Wait Queues ========== */
+
+void wait_queue_init(wait_queue_t* wq) {
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+/* Take a process off the wait queue it is on, if any */
+static void wait_unlink(process_t* proc) {
+    wait_queue_t* wq = proc->wait_queue;
+    if (!wq) return;
+    
+    if (proc->wait_prev) {
+        proc->wait_prev->wait_next = proc->wait_next;
+    } else {
+        wq->head = proc->wait_next;
+    }
+    if (proc->wait_next) {
+        proc->wait_next->wait_prev = proc->wait_prev;
+    } else {
+        wq->tail = proc->wait_prev;
+    }
+    proc->wait_next = NULL;
+    proc->wait_prev = NULL;
+    proc->wait_queue = NULL;
+}
+
+/* Queue current on wq (once) and mark it blocked; lock held */
+static void wait_link(wait_queue_t* wq, bool exclusive, uint64_t key) {
+    process_t* proc = current;
+    
+    if (proc->wait_queue != wq) {
+        wait_unlink(proc);
+        proc->wait_queue = wq;
+        proc->wait_exclusive = exclusive;
+        proc->wait_key = key;
+        
+        /* Exclusive waiters queue FIFO at the tail, the rest at the head */
+        if (exclusive) {
+            proc->wait_next = NULL;
+            proc->wait_prev = wq->tail;
+            if (wq->tail) {
+                wq->tail->wait_next = proc;
+            } else {
+                wq->head = proc;
+            }
+            wq->tail = proc;
+        } else {
+            proc->wait_prev = NULL;
+            proc->wait_next = wq->head;
+            if (wq->head) {
+                wq->head->wait_prev = proc;
+            } else {
+                wq->tail = proc;
+            }
+            wq->head = proc;
+        }
+    }
+    
+    if (proc->state == PROC_STATE_RUNNING) {
+        set_state(proc, PROC_STATE_BLOCKED);
+    }
+}
+
+/* Queue current and block it; preemption stays off until wait_schedule or finish_wait */
+static void wait_prepare(wait_queue_t* wq, bool exclusive, uint64_t key,
+                         bool timed, uint32_t deadline) {
+    preempt_disable();
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    wait_link(wq, exclusive, key);
+    if (timed && !current->sleeping) {
+        current->wake_tick = deadline;
+        sleep_enqueue(current);
+    }
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    
+    /* A waker's store must be visible to the caller's test, and ours to it */
+    __sync_synchronize();
+}
+
+void prepare_to_wait(wait_queue_t* wq, bool exclusive) {
+    wait_prepare(wq, exclusive, 0, false, 0);
+}
+
+void prepare_to_wait_until(wait_queue_t* wq, bool exclusive, uint32_t deadline) {
+    wait_prepare(wq, exclusive, 0, true, deadline);
+}
+
+void prepare_to_wait_key(wait_queue_t* wq, uint64_t key, bool timed, uint32_t deadline) {
+    wait_prepare(wq, true, key, timed, deadline);
+}
+
+/* Sleep after a failed test, unless a wake-up already came in */
+void wait_schedule(void) {
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    preempt_enable_no_resched();        /* prepare_to_wait's */
+    if (scheduler_enabled && current->state == PROC_STATE_BLOCKED) {
+        schedule_locked();
+    }
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+}
+
+/* Leave the wait queue and run on; true if a wake_up took us off it */
+bool finish_wait(wait_queue_t* wq) {
+    UNUSED(wq);
+    
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    process_t* proc = current;
+    bool woken = proc->wait_queue == NULL;
+    wait_unlink(proc);
+    sleep_remove(proc);
+    if (proc->state == PROC_STATE_BLOCKED) {
+        set_state(proc, PROC_STATE_RUNNING);
+    }
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    preempt_enable();                   /* prepare_to_wait's */
+    return woken;
+}
+
+uint32_t wait_deadline(uint32_t ms) {
+    uint32_t ticks = (ms * TIMER_FREQUENCY + 999) / 1000;
+    return timer_get_ticks() + (ticks ? ticks : 1);
+}
+
+bool wait_expired(uint32_t deadline) {
+    return (int32_t)(timer_get_ticks() - deadline) >= 0;
+}
+
+/* Wake every non-exclusive waiter and up to nr exclusive ones; returns how many woke */
+uint32_t wake_up_nr(wait_queue_t* wq, uint32_t nr) {
+    return wake_up_key(wq, 0, nr);
 }
 
-/* Find free process slot */
-static int find_free_slot(void) {
-    for (int i = 1; i < MAX_PROCESSES; i++) {
-        if (processes[i].state == PROC_STATE_FREE) {
-            return i;
+/* Body of wake_up_key; lock held */
+static uint32_t wake_locked(wait_queue_t* wq, uint64_t key, uint32_t nr) {
+    uint32_t woken = 0;
+    uint32_t exclusive = 0;
+    
+    process_t* proc = wq->head;
+    while (proc && exclusive < nr) {
+        process_t* next = proc->wait_next;
+        if (key && proc->wait_key != key) {
+            proc = next;
+            continue;
+        }
+        if (proc->wait_exclusive) exclusive++;
+        
+        wait_unlink(proc);
+        sleep_remove(proc);
+        if (proc->state == PROC_STATE_BLOCKED) {
+            make_ready(proc);
         }
+        woken++;
+        proc = next;
     }
-    return -1;
+    return woken;
+}
+
+/* As wake_up_nr, limited to waiters with this key unless it is 0 */
+uint32_t wake_up_key(wait_queue_t* wq, uint64_t key, uint32_t nr) {
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    uint32_t woken = wake_locked(wq, key, nr);
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    return woken;
+}
+
+/* ========== Processes ========== */
+
+/* Initialize process manager */
+void process_init(void) {
+    memset(pid_hash, 0, sizeof(pid_hash));
+    memset(state_counts, 0, sizeof(state_counts));
+    memset(sched_cpus, 0, sizeof(sched_cpus));
+    spin_lock_init(&sched_lock, "sched");
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        sched_cpus[i].active = &sched_cpus[i].queues[0];
+        sched_cpus[i].expired = &sched_cpus[i].queues[1];
+    }
+    task_head = NULL;
+    task_tail = NULL;
+    live_processes = 0;
+    sleep_queue = NULL;
+    
+    /* Create kernel process (PID 0); it runs the shell, so it gets a large share */
+    kernel_process = pcb_alloc();
+    kernel_process->pid = 0;
+    strcpy(kernel_process->name, "kernel");
+    kernel_process->priority = PROC_PRIORITY_HIGH;
+    kernel_process->created_time = timer_get_seconds();
+    kernel_process->parent_pid = 0;
+    kernel_process->cpu = smp_cpu_id();
+    kernel_process->on_cpu = true;
+    pcb_publish(kernel_process, PROC_STATE_RUNNING);
+    
+    current = kernel_process;
+    this_sched()->acct_stamp = rdtsc();
+    next_pid = 1;
 }
 
 /* Find process by PID */
 static process_t* find_process(uint32_t pid) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (processes[i].pid == pid && processes[i].state != PROC_STATE_FREE) {
-            return &processes[i];
+    for (process_t* proc = pid_hash[pid % PID_HASH_BUCKETS]; proc; proc = proc->hash_next) {
+        if (proc->pid == pid) {
+            return proc;
         }
     }
     return NULL;
 }
 
-/* Create a new process */
-int process_create(const char* name, void (*entry)(void), proc_priority_t priority) {
-    int slot = find_free_slot();
-    if (slot < 0) return -1;
+/* Is this some CPU's idle process? */
+static bool is_idle(process_t* proc) {
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        if (sched_cpus[i].idle == proc) return true;
+    }
+    return false;
+}
+
+/*
+ * Free a zombie nobody will wait for, once it is off every CPU (lock
+ * held). Its address space can't be torn down under the lock, so
+ * vmm frees that later from process context.
+ */
+static void zombie_release(process_t* proc) {
+    mm_t* mm = proc->mm;
+    if (proc->stack) {
+        stack_free(proc->stack);
+        proc->stack = NULL;
+    }
+    pcb_release(proc);
+    if (mm) mm_destroy_later(mm);
+}
+
+/* Runs after every switch, on the incoming process's stack (lock held) */
+static void schedule_tail(void) {
+    sched_cpu_t* sc = this_sched();
     
-    process_t* proc = &processes[slot];
+    if (sc->dead && sc->dead != sc->running) {
+        process_t* dead = sc->dead;
+        stack_free(dead->stack);
+        dead->stack = NULL;
+        sc->dead = NULL;
+        if (dead->detached) zombie_release(dead);
+    }
+    sc->need_resched = false;
+}
+
+/* First code a new process runs; context_switch returns here */
+static void process_trampoline(void) {
+    schedule_tail();
+    spin_unlock(&sched_lock);
+    __asm__ volatile("sti");
     
+    process_t* self = current;
+    if (self->thread_fn) {
+        process_exit(self->thread_fn(self->thread_arg));
+    }
+    self->entry();
+    process_exit(0);
+}
+
+/* Build a PCB and stack and queue it on the least loaded CPU */
+static int process_spawn(const char* name, void (*entry)(void),
+                         int (*fn)(void* arg), void* arg, proc_priority_t priority) {
     /* Allocate stack */
-    proc->stack = (uint8_t*)kmalloc(PROCESS_STACK_SIZE);
-    if (!proc->stack) return -2;
+    uint8_t* stack = stack_alloc();
+    if (!stack) return -2;
+    
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    
+    process_t* proc = pcb_alloc();
+    if (!proc) {
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+        stack_free(stack);
+        return -1;
+    }
+    proc->stack = stack;
     
     /* Initialize PCB */
     proc->pid = next_pid++;
     strncpy(proc->name, name, PROCESS_NAME_LEN - 1);
     proc->name[PROCESS_NAME_LEN - 1] = '\0';
-    proc->state = PROC_STATE_READY;
     proc->priority = priority;
     proc->stack_size = PROCESS_STACK_SIZE;
-    proc->parent_pid = current_pid;
+    proc->parent_pid = current->pid;
     proc->created_time = timer_get_seconds();
     proc->cpu_time = 0;
     proc->entry = entry;
+    proc->thread_fn = fn;
+    proc->thread_arg = arg;
+    if (!is_fair(proc)) proc->timeslice = SCHED_RT_SLICE_TICKS;
+    proc->cpu = least_loaded_cpu();
+    proc->vruntime = sched_cpus[proc->cpu].min_vruntime;
+    
+    /* Build a context that context_switch will "return" into */
+    uint32_t top = (uint32_t)(proc->stack + PROCESS_STACK_SIZE) & ~0xF;
+    top -= sizeof(uint32_t);                /* Fake return address */
+    *(uint32_t*)top = 0;
+    
+    proc->context = (cpu_context_t*)(top - sizeof(cpu_context_t));
+    memset(proc->context, 0, sizeof(cpu_context_t));
+    proc->context->eip = (uint32_t)process_trampoline;
+    proc->context->eflags = 0x002;          /* IF stays clear until started */
     
-    /* Set up initial context */
-    proc->context.esp = (uint32_t)(proc->stack + PROCESS_STACK_SIZE - 4);
-    proc->context.ebp = proc->context.esp;
-    proc->context.eip = (uint32_t)entry;
-    proc->context.eflags = 0x202;  /* IF flag set */
+    pcb_publish(proc, PROC_STATE_READY);
+    make_ready(proc);
     
-    return proc->pid;
+    uint32_t pid = proc->pid;
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    return pid;
+}
+
+/* Create a new process */
+int process_create(const char* name, void (*entry)(void), proc_priority_t priority) {
+    return process_spawn(name, entry, NULL, NULL, priority);
+}
+
+/* Create a kernel thread running fn(arg); its return value is the exit code */
+int kthread_create(const char* name, int (*fn)(void* arg), void* arg, proc_priority_t priority) {
+    return process_spawn(name, NULL, fn, arg, priority);
+}
+
+/*
+ * A process became a zombie: record why, tell its parent, and hand its
+ * children to the kernel, which never waits for them: they are freed
+ * when they exit, or now if they already have (lock held)
+ */
+static void exit_notify(process_t* proc, int code) {
+    proc->exit_code = code;
+    process_t* next;
+    for (process_t* child = task_head; child; child = next) {
+        next = child->task_next;
+        if (child->parent_pid != proc->pid || child == proc) continue;
+        
+        child->parent_pid = 0;
+        child->detached = true;
+        if (child->state == PROC_STATE_ZOMBIE && !child->on_cpu) {
+            zombie_release(child);
+        }
+    }
+    wake_locked(&child_exit, CHILD_KEY(proc->parent_pid), 0xFFFFFFFF);
 }
 
-/* Exit current process */
+/* Exit current process; a zombie until its parent waits, unless detached */
 void process_exit(int code) {
-    UNUSED(code);
-    
-    process_t* proc = &processes[current_pid];
+    process_t* proc = current;
     if (proc->pid == 0) return;  /* Can't exit kernel */
     
-    proc->state = PROC_STATE_ZOMBIE;
+    ioring_release(proc->pid);
+    pipe_release(proc->pipe_ends);
+    proc->pipe_ends = 0;
+    shm_release_ids(proc->shm_ids);
+    proc->shm_ids = 0;
     
-    /* Free stack */
-    if (proc->stack) {
-        kfree(proc->stack);
-        proc->stack = NULL;
-    }
+    /* The stack is still in use; the next process frees it */
+    __asm__ volatile("cli");
+    spin_lock(&sched_lock);
+    fpu_release(proc);
+    set_state(proc, PROC_STATE_ZOMBIE);
+    exit_notify(proc, code);
+    this_sched()->dead = proc;
+    
+    schedule_locked();
     
-    schedule();
+    /* A zombie is never picked again */
+    while (1) {
+        __asm__ volatile("hlt");
+    }
 }
 
 /* Kill a process */
 int process_kill(uint32_t pid) {
     if (pid == 0) return -1;  /* Can't kill kernel */
     
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    
     process_t* proc = find_process(pid);
-    if (!proc) return -2;
     
-    proc->state = PROC_STATE_ZOMBIE;
+    /*
+     * Running on another CPU, maybe holding locks: have it switch out
+     * and kill it once it has. A program usually exits first by itself,
+     * on its way back to ring 3 (process_exit_if_killed).
+     */
+    bool waited = false;
+    while (proc && proc != current && proc->on_cpu && !is_idle(proc)) {
+        proc->killed = true;
+        sched_cpus[proc->cpu].need_resched = true;
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+        
+        process_yield();
+        waited = true;
+        
+        flags = irq_save();
+        spin_lock(&sched_lock);
+        proc = find_process(pid);
+    }
+    
+    if (!proc || is_idle(proc)) {
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+        if (!proc && waited) return 0;      /* Exited and freed meanwhile */
+        return proc ? -1 : -2;
+    }
     
+    /* Programs are reaped by their parent's wait (detached ones are gone already) */
+    if (proc->state == PROC_STATE_ZOMBIE && proc->mm) {
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+        return 0;
+    }
+    
+    if (proc == current) {
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+        process_exit(-1);
+    }
+    
+    dequeue_task(proc);
+    sleep_remove(proc);
+    wait_unlink(proc);
+    set_state(proc, PROC_STATE_ZOMBIE);
+    fpu_release(proc);
+    
+    /* Not running, so its stack can go now; exited ones were freed already */
     if (proc->stack) {
-        kfree(proc->stack);
+        stack_free(proc->stack);
         proc->stack = NULL;
     }
     
-    /* Clean up zombie */
-    memset(proc, 0, sizeof(process_t));
+    /* Its pipe ends and shared memory ids are let go below, where we may sleep */
+    uint32_t pipe_ends = proc->pipe_ends;
+    uint32_t shm_ids = proc->shm_ids;
+    proc->pipe_ends = 0;
+    proc->shm_ids = 0;
+    
+    /* A program waits for its parent; kernel threads are cleaned up now */
+    exit_notify(proc, -1);
+    if (!proc->mm || proc->detached) {
+        zombie_release(proc);
+    }
     
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    
+    ioring_release(pid);
+    pipe_release(pipe_ends);
+    shm_release_ids(shm_ids);
     return 0;
 }
 
+/*
+ * On the way back to ring 3: exit if we were killed while running. The
+ * program holds no locks here, unlike at an arbitrary tick.
+ */
+void process_exit_if_killed(registers_t* regs) {
+    if ((regs->cs & 3) != 3 || !current->killed || preempt_count() != 0) return;
+    
+    /* Exiting may sleep (pipe_release), so let interrupts in again */
+    __asm__ volatile("sti");
+    process_exit(-1);
+}
+
+/* Nobody will wait for pid: free it as soon as it exits */
+int process_detach(uint32_t pid) {
+    if (pid == 0) return -1;  /* The kernel never exits */
+    
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    
+    process_t* proc = find_process(pid);
+    if (proc && !is_idle(proc)) {
+        proc->detached = true;
+        if (proc->state == PROC_STATE_ZOMBIE && !proc->on_cpu) {
+            zombie_release(proc);
+        }
+    }
+    
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    return proc ? 0 : -1;
+}
+
+/*
+ * Duplicate the calling program. The child shares every page
+ * copy-on-write and gets a copy of the parent's system call frame at
+ * the same place on its own kernel stack. Just below it sits a context
+ * that resumes in fork_return, so the child returns from the same call
+ * with 0.
+ */
+int process_fork(registers_t* frame) {
+    process_t* parent = current;
+    if (!parent->mm || !frame || (frame->cs & 3) != 3) return -EINVAL;
+    
+    uint32_t offset = (uint32_t)frame - (uint32_t)parent->stack;
+    if (offset > PROCESS_STACK_SIZE - sizeof(registers_t)) return -EINVAL;
+    
+    uint8_t* stack = stack_alloc();
+    if (!stack) return -ENOMEM;
+    
+    mm_t* mm = mm_clone(parent->mm);
+    if (!mm) {
+        stack_free(stack);
+        return -ENOMEM;
+    }
+    
+    registers_t* child_frame = (registers_t*)(stack + offset);
+    memcpy(child_frame, frame, sizeof(registers_t));
+    child_frame->eax = 0;
+    
+    cpu_context_t* context = (cpu_context_t*)((uint32_t)child_frame - sizeof(cpu_context_t));
+    memset(context, 0, sizeof(cpu_context_t));
+    context->eip = (uint32_t)fork_return;
+    context->eflags = 0x002;                /* The iret restores the caller's */
+    
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    process_t* child = pcb_alloc();
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    
+    if (!child || !fpu_fork(parent, child)) {
+        flags = irq_save();
+        spin_lock(&sched_lock);
+        if (child) {
+            fpu_release(child);
+            pcb_free(child);
+        }
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+        mm_destroy(mm);
+        stack_free(stack);
+        return child ? -ENOMEM : -EAGAIN;
+    }
+    
+    strcpy(child->name, parent->name);
+    child->priority = parent->priority;
+    child->stack = stack;
+    child->stack_size = PROCESS_STACK_SIZE;
+    child->parent_pid = parent->pid;
+    child->created_time = timer_get_seconds();
+    if (!is_fair(child)) child->timeslice = SCHED_RT_SLICE_TICKS;
+    child->mm = mm;
+    child->context = context;
+    
+    /* The child holds the parent's pipe ends and shared memory ids too */
+    child->pipe_ends = parent->pipe_ends;
+    pipe_fork(child->pipe_ends);
+    child->shm_ids = parent->shm_ids;
+    shm_fork(child->shm_ids);
+    
+    flags = irq_save();
+    spin_lock(&sched_lock);
+    child->pid = next_pid++;
+    child->cpu = least_loaded_cpu();
+    child->vruntime = sched_cpus[child->cpu].min_vruntime;
+    pcb_publish(child, PROC_STATE_READY);
+    make_ready(child);
+    uint32_t pid = child->pid;
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+    return pid;
+}
+
+/* Runs on a forked child's first switch-in, before it returns to the program */
+void process_fork_tail(void) {
+    schedule_tail();
+    spin_unlock(&sched_lock);
+}
+
+/* Reap a zombie child (any if pid is -1); returns its PID */
+int process_wait(int32_t pid, int* status) {
+    process_t* self = current;
+    int result;
+    mm_t* mm = NULL;
+    int code = 0;
+    
+    while (1) {
+        prepare_to_wait_key(&child_exit, CHILD_KEY(self->pid), false, 0);
+        
+        uint32_t flags = irq_save();
+        spin_lock(&sched_lock);
+        result = -ECHILD;
+        for (process_t* proc = task_head; proc; proc = proc->task_next) {
+            if (proc->parent_pid != self->pid || proc == self || is_idle(proc)) continue;
+            if (pid >= 0 && proc->pid != (uint32_t)pid) continue;
+            
+            result = -EAGAIN;
+            if (proc->state == PROC_STATE_ZOMBIE && !proc->on_cpu) {
+                result = proc->pid;
+                code = proc->exit_code;
+                mm = proc->mm;
+                pcb_release(proc);
+                break;
+            }
+        }
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+        
+        if (result != -EAGAIN) break;
+        wait_schedule();
+    }
+    finish_wait(&child_exit);
+    
+    /* No CPU has it loaded: the child has switched out for good */
+    if (mm) mm_destroy(mm);
+    if (result >= 0 && status) *status = code;
+    return result;
+}
+
 /* Yield to scheduler */
 void process_yield(void) {
-    schedule();
+    /* Our kernel-polled I/O rings make progress whenever we yield */
+    ioring_poll();
+    
+    if (!scheduler_enabled) return;
+    
+    /* Giving up the CPU forfeits the rest of the slice */
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    process_t* proc = current;
+    proc->timeslice = 0;
+    if (is_fair(proc)) {
+        this_sched()->skip = proc;
+    }
+    schedule_locked();
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
 }
 
-/* Sleep for milliseconds */
+/* Sleep for milliseconds, letting other processes run meanwhile */
 void process_sleep(uint32_t ms) {
-    /* Simple busy-wait sleep for now */
-    msleep(ms);
+    if (!scheduler_enabled) {
+        msleep(ms);
+        return;
+    }
+    
+    uint32_t ticks = (ms * TIMER_FREQUENCY + 999) / 1000;
+    if (ticks == 0) ticks = 1;
+    
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    process_t* proc = current;
+    proc->wake_tick = timer_get_ticks() + ticks;
+    set_state(proc, PROC_STATE_BLOCKED);
+    sleep_enqueue(proc);
+    
+    schedule_locked();
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
 }
 
-/* Block a process */
+/* Block a process; a running one stops at its next schedule() */
 void process_block(uint32_t pid) {
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
     process_t* proc = find_process(pid);
-    if (proc && proc->state == PROC_STATE_RUNNING) {
-        proc->state = PROC_STATE_BLOCKED;
+    if (proc && proc->state == PROC_STATE_READY) {
+        dequeue_task(proc);
+        set_state(proc, PROC_STATE_BLOCKED);
+    } else if (proc && proc->state == PROC_STATE_RUNNING) {
+        set_state(proc, PROC_STATE_BLOCKED);
     }
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
 }
 
 /* Unblock a process */
 void process_unblock(uint32_t pid) {
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
     process_t* proc = find_process(pid);
     if (proc && proc->state == PROC_STATE_BLOCKED) {
-        proc->state = PROC_STATE_READY;
+        sleep_remove(proc);
+        make_ready(proc);
     }
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
 }
 
 /* Get current process */
 process_t* process_current(void) {
-    return &processes[current_pid];
+    return current;
 }
 
 /* Get current PID */
 uint32_t process_getpid(void) {
-    return processes[current_pid].pid;
+    return current->pid;
 }
 
 /* List processes */
 int process_list(proc_info_t* info, int max_count) {
     int count = 0;
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
     
-    for (int i = 0; i < MAX_PROCESSES && count < max_count; i++) {
-        if (processes[i].state != PROC_STATE_FREE) {
-            info[count].pid = processes[i].pid;
-            strncpy(info[count].name, processes[i].name, PROCESS_NAME_LEN);
-            info[count].state = processes[i].state;
-            info[count].cpu_time = processes[i].cpu_time;
-            count++;
-        }
+    for (process_t* proc = task_head; proc && count < max_count; proc = proc->task_next) {
+        info[count].pid = proc->pid;
+        strncpy(info[count].name, proc->name, PROCESS_NAME_LEN);
+        info[count].state = proc->state;
+        info[count].cpu_time = proc->cpu_time;
+        info[count].fpu_uses = proc->fpu_uses;
+        info[count].cpu = proc->cpu;
+        memcpy(info[count].cycles, proc->cycles, sizeof(proc->cycles));
+        info[count].switches_voluntary = proc->switches_voluntary;
+        info[count].switches_forced = proc->switches_forced;
+        info[count].stack = proc->stack;
+        count++;
     }
     
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
     return count;
 }
 
 /* Count active processes */
 int process_count(void) {
-    int count = 0;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (processes[i].state != PROC_STATE_FREE) {
-            count++;
-        }
+    return live_processes;
+}
+
+/* Count processes in one state */
+int process_count_state(proc_state_t state) {
+    if (state <= PROC_STATE_FREE || state >= PROC_STATE_COUNT) return 0;
+    return state_counts[state];
+}
+
+/* Idle loop: repaint freed stacks, then halt until something is READY */
+static void idle_loop(void) {
+    while (1) {
+        stack_pool_refill();
+        __asm__ volatile("hlt");
     }
-    return count;
 }
 
 /* Initialize scheduler */
 void scheduler_init(void) {
+    int pid = process_create("idle", idle_loop, PROC_PRIORITY_LOW);
+    if (pid > 0) {
+        uint32_t flags = irq_save();
+        spin_lock(&sched_lock);
+        process_t* idle = find_process((uint32_t)pid);
+        dequeue_task(idle);
+        this_sched()->idle = idle;
+        spin_unlock(&sched_lock);
+        irq_restore(flags);
+    }
+    
     scheduler_enabled = true;
 }
 
-/* Scheduler tick (called from timer interrupt) */
+/* Adopt an application processor's boot context as its idle process */
+void scheduler_init_cpu(uint8_t* idle_stack) {
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    
+    process_t* proc = pcb_alloc();
+    if (proc) {
+        proc->pid = next_pid++;
+        strcpy(proc->name, "idle/");
+        proc->name[5] = (char)('0' + smp_cpu_id());
+        proc->priority = PROC_PRIORITY_LOW;
+        proc->stack = idle_stack;
+        proc->stack_size = PROCESS_STACK_SIZE;
+        proc->created_time = timer_get_seconds();
+        proc->cpu = smp_cpu_id();
+        proc->on_cpu = true;
+        pcb_publish(proc, PROC_STATE_RUNNING);
+        
+        sched_cpu_t* sc = this_sched();
+        sc->running = proc;
+        sc->idle = proc;
+        sc->acct_stamp = rdtsc();
+    }
+    
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+}
+
+/* Scheduler tick (called from this CPU's timer interrupt) */
 void scheduler_tick(void) {
     if (!scheduler_enabled) return;
     
+    sched_cpu_t* sc = this_sched();
+    process_t* proc = sc->running;
+    if (!proc) return;
+    
     /* Update CPU time for current process */
-    processes[current_pid].cpu_time++;
+    proc->cpu_time++;
+    
+    /* Holding a lock: defer any switch to preempt_enable() */
+    bool preemptible = preempt_count() == 0;
+    
+    spin_lock(&sched_lock);
+    
+    /* Sleepers are timed by the PIT, which only the BSP receives */
+    if (smp_cpu_id() == 0) {
+        uint64_t now = rdtsc();
+        if (last_tick_tsc) {
+            uint64_t cycles = now - last_tick_tsc;
+            tick_cycles = cycles > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)cycles;
+        }
+        last_tick_tsc = now;
+        vdso_tick(timer_get_ticks(), now, tick_cycles);
+        
+        sleep_wake_expired(timer_get_ticks());
+    }
+    
+    update_curr(sc);
+    
+    /*
+     * Idle looks for work every tick. A REALTIME process runs out its
+     * slice; a fair one yields to a waiting REALTIME process at once,
+     * and reschedules once it has had its share of the period (alone,
+     * that is the whole period, after which it may be stolen).
+     */
+    bool resched = sc->need_resched;
+    if (proc == sc->idle) {
+        resched = true;
+    } else if (is_fair(proc)) {
+        if (rt_queued(sc) || proc->slice_exec >= fair_slice(sc, proc)) {
+            resched = true;
+        }
+    } else {
+        if (proc->timeslice > 0) proc->timeslice--;
+        if (proc->timeslice == 0) resched = true;
+    }
+    
+    if (resched) {
+        if (preemptible) {
+            schedule_locked();
+        } else {
+            sc->need_resched = true;
+        }
+    }
+    
+    spin_unlock(&sched_lock);
 }
 
-/* Simple round-robin scheduler */
+/* Pick the next process: REALTIME first, then the fair timeline */
 void schedule(void) {
     if (!scheduler_enabled) return;
     
-    /* Mark current as ready if running */
-    if (processes[current_pid].state == PROC_STATE_RUNNING) {
-        processes[current_pid].state = PROC_STATE_READY;
+    uint32_t flags = irq_save();
+    spin_lock(&sched_lock);
+    schedule_locked();
+    spin_unlock(&sched_lock);
+    irq_restore(flags);
+}
+
+/* Switch now if a tick was deferred while preemption was disabled */
+void preempt_schedule(void) {
+    if (scheduler_enabled && this_sched()->need_resched) {
+        schedule();
     }
+}
+
+/* Set the fair class's minimum granularity (clamped to a sane range) */
+void scheduler_set_granularity(uint32_t ms) {
+    if (ms < 1) ms = 1;
+    if (ms > SCHED_MAX_GRANULARITY_MS) ms = SCHED_MAX_GRANULARITY_MS;
+    min_granularity_ms = ms;
+}
+
+uint32_t scheduler_get_granularity(void) {
+    return min_granularity_ms;
+}
+
+/* Pick and switch to the next process; lock held, interrupts off */
+static void schedule_locked(void) {
+    uint32_t cpu = smp_cpu_id();
+    sched_cpu_t* sc = &sched_cpus[cpu];
+    process_t* prev = sc->running;
+    bool preempted = prev->state == PROC_STATE_RUNNING;
+    
+    update_curr(sc);
     
-    /* Find next ready process (round-robin) */
-    int next = current_pid;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        next = (next + 1) % MAX_PROCESSES;
-        if (processes[next].state == PROC_STATE_READY) {
-            break;
+    /* Requeue current; a spent REALTIME slice is refilled in the expired set */
+    if (prev == sc->idle) {
+        set_state(prev, PROC_STATE_READY);
+    } else if (prev->state == PROC_STATE_RUNNING) {
+        set_state(prev, PROC_STATE_READY);
+        if (is_fair(prev)) {
+            fair_enqueue(sc, prev);
+        } else if (prev->timeslice == 0) {
+            prev->timeslice = SCHED_RT_SLICE_TICKS;
+            rq_enqueue(sc->expired, prev);
+        } else {
+            rq_enqueue(sc->active, prev);
         }
     }
     
-    /* Switch to next process */
-    current_pid = next;
-    processes[current_pid].state = PROC_STATE_RUNNING;
+    /* REALTIME first; swap sets once every active process has had its turn */
+    process_t* next = rq_pick(sc->active);
+    if (!next && sc->expired->count) {
+        run_queue_t* swap = sc->active;
+        sc->active = sc->expired;
+        sc->expired = swap;
+        next = rq_pick(sc->active);
+    }
     
-    /* Context switch would happen here in a real implementation */
+    /* No REALTIME work here: even out queue lengths before the fair class */
+    if (!next) {
+        next = steal_task(cpu);
+    }
+    if (!next) {
+        next = fair_pick(sc);
+    }
+    
+    /* Nothing runnable anywhere: everyone is asleep or blocked */
+    if (!next) {
+        next = sc->idle ? sc->idle : kernel_process;
+    }
+    
+    /* Close prev's accounting; next resumes in whatever state it left */
+    uint64_t now = rdtsc();
+    if (prev != next) {
+        acct_charge(sc, now);
+        prev->acct_state = sc->acct_state;
+        sc->acct_state = next->acct_state;
+        if (preempted) {
+            prev->switches_forced++;
+        } else {
+            prev->switches_voluntary++;
+        }
+    }
+    
+    sc->running = next;
+    set_state(next, PROC_STATE_RUNNING);
+    next->exec_start = now;
+    next->slice_exec = 0;
+    
+    if (prev != next) {
+        prev->on_cpu = false;
+        next->on_cpu = true;
+        fpu_switch(prev, next);
+        
+        vdso_switch(smp_cpu_id(), next->pid);
+        
+        /* Entries from ring 3 land on the program's kernel stack */
+        if (next->mm) {
+            gdt_set_kernel_stack(this_cpu(), (uint32_t)next->stack + PROCESS_STACK_SIZE);
+        }
+        
+        /* We may come back on another CPU; don't reuse sc below */
+        context_switch(&prev->context, next->context, mm_cr3(next->mm));
+    }
+    schedule_tail();
 }
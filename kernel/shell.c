@@ -17,6 +17,13 @@
 #include "../include/fs.h"
 #include "../include/process.h"
 #include "../include/gui.h"
+#include "../include/smp.h"
+#include "../include/sync.h"
+#include "../include/stackpool.h"
+#include "../include/vmm.h"
+#include "../include/syscall.h"
+#include "../include/pipe.h"
+#include "../include/shm.h"
 
 /* Maximum number of registered commands */
 #define MAX_COMMANDS 32
@@ -253,7 +260,12 @@ void cmd_mem(int argc, char* argv[]) {
     vga_printf("  Used Memory:   %d KB\n", stats.used_memory / 1024);
     vga_printf("  Free Memory:   %d KB\n", stats.free_memory / 1024);
     vga_printf("  Allocations:   %d\n", stats.allocations);
-    vga_printf("  Frees:         %d\n\n", stats.frees);
+    vga_printf("  Frees:         %d\n", stats.frees);
+    
+    frame_stats_t frames;
+    frame_get_stats(&frames);
+    vga_printf("  Program Pages: %d of %d in use, %d shared\n\n",
+               frames.total - frames.free, frames.total, frames.shared);
 }
 
 /* Built-in: sleep */
@@ -270,7 +282,7 @@ void cmd_sleep(int argc, char* argv[]) {
     }
     
     vga_printf("Sleeping for %d seconds...\n", seconds);
-    sleep(seconds);
+    process_sleep((uint32_t)seconds * 1000);
     vga_puts("Done!\n");
 }
 
@@ -376,21 +388,29 @@ void cmd_ls(int argc, char* argv[]) {
     UNUSED(argc);
     UNUSED(argv);
     
-    fs_dirent_t entries[32];
-    int count = fs_list(entries, 32);
+    fs_dir_t dir;
+    fs_dirent_t entry;
+    int count = 0;
     
     vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
     vga_puts("\n  Files in filesystem:\n");
     vga_puts("  ====================\n");
     
-    for (int i = 0; i < count; i++) {
-        if (entries[i].type == FS_TYPE_DIRECTORY) {
+    fs_opendir(&dir);
+    while (fs_readdir(&dir, &entry)) {
+        if (entry.type == FS_TYPE_DIRECTORY) {
             vga_set_color(vga_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
-            vga_printf("  [DIR]  %s\n", entries[i].name);
+            vga_printf("  [DIR]  %s\n", entry.name);
         } else {
             vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
-            vga_printf("  [FILE] %-16s %d bytes\n", entries[i].name, entries[i].size);
+            vga_printf("  [FILE] %-16s %d bytes\n", entry.name, entry.size);
         }
+        count++;
+    }
+    
+    if (dir.changed) {
+        vga_set_color(vga_color(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        vga_puts("\n  (files changed while listing; run ls again)\n");
     }
     
     vga_set_color(vga_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
@@ -499,17 +519,64 @@ void cmd_write(int argc, char* argv[]) {
     vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
 }
 
+/* Built-in: snapshot - checkpoint the filesystem */
+void cmd_snapshot(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "drop") == 0) {
+        fs_snapshot_drop();
+        vga_puts("Snapshot dropped\n");
+        return;
+    }
+    
+    int result = fs_snapshot();
+    if (result >= 0) {
+        vga_set_color(vga_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK));
+        vga_printf("Snapshot taken: %d entries\n", result);
+    } else {
+        vga_set_color(vga_color(VGA_COLOR_RED, VGA_COLOR_BLACK));
+        vga_printf("Snapshot failed (error %d)\n", result);
+    }
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+}
+
+/* Built-in: rollback - restore the last snapshot */
+void cmd_rollback(int argc, char* argv[]) {
+    UNUSED(argc);
+    UNUSED(argv);
+    
+    if (fs_rollback() == 0) {
+        vga_set_color(vga_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK));
+        vga_puts("Filesystem rolled back to snapshot\n");
+    } else {
+        vga_set_color(vga_color(VGA_COLOR_RED, VGA_COLOR_BLACK));
+        vga_puts("No snapshot to roll back to\n");
+    }
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+}
+
+/* Cycles a process spent doing work (not waiting in an idle loop) */
+static uint64_t proc_busy_cycles(const proc_info_t* info) {
+    return info->cycles[ACCT_KERNEL] + info->cycles[ACCT_USER] + info->cycles[ACCT_IRQ];
+}
+
+/* TSC cycles as milliseconds (0 until the TSC has been measured) */
+static uint32_t cycles_to_ms(uint64_t cycles) {
+    uint32_t per_ms = scheduler_cycles_per_ms();
+    return per_ms ? (uint32_t)udiv64(cycles, per_ms, NULL) : 0;
+}
+
 /* Built-in: ps - list processes */
 void cmd_ps(int argc, char* argv[]) {
     UNUSED(argc);
     UNUSED(argv);
     
-    proc_info_t info[16];
-    int count = process_list(info, 16);
+    int max = process_count();
+    proc_info_t* info = (proc_info_t*)kmalloc(sizeof(proc_info_t) * max);
+    if (!info) return;
+    int count = process_list(info, max);
     
     vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
-    vga_puts("\n  PID  Name             State      CPU\n");
-    vga_puts("  ===  ====             =====      ===\n");
+    vga_puts("\n  PID  Name             State      CPU(ms)  Switches  FPU    Core\n");
+    vga_puts("  ===  ====             =====      =======  ========  ===    ====\n");
     
     const char* state_names[] = {"FREE", "READY", "RUN", "BLOCK", "ZOMBIE"};
     
@@ -520,13 +587,594 @@ void cmd_ps(int argc, char* argv[]) {
         if (info[i].state == PROC_STATE_RUNNING) {
             vga_set_color(vga_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK));
         }
-        vga_printf("%-10s %d\n", state_names[info[i].state], info[i].cpu_time);
+        vga_printf("%-10s %-8u %-9u %-6d %d\n", state_names[info[i].state],
+                   cycles_to_ms(proc_busy_cycles(&info[i])),
+                   info[i].switches_voluntary + info[i].switches_forced,
+                   info[i].fpu_uses, info[i].cpu);
     }
+    kfree(info);
     
+    vga_set_color(vga_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
+    vga_printf("\n  %d ready, %d blocked, %d zombie\n",
+               process_count_state(PROC_STATE_READY),
+               process_count_state(PROC_STATE_BLOCKED),
+               process_count_state(PROC_STATE_ZOMBIE));
     vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     vga_putchar('\n');
 }
 
+/* top: processes shown at most, and samples kept between refreshes */
+#define TOP_FIRST_ROW   4
+#define TOP_MAX_ROWS    (VGA_HEIGHT - TOP_FIRST_ROW - 1)
+#define TOP_MAX_PROCS   64
+
+typedef struct {
+    uint32_t pid;
+    uint64_t cycles[ACCT_STATES];
+} top_sample_t;
+
+/* part / whole in tenths of a percent */
+static uint32_t tenths_of(uint64_t part, uint64_t whole) {
+    while (whole > 0xFFFFFFFF) {
+        whole >>= 1;
+        part >>= 1;
+    }
+    if (whole == 0) return 0;
+    return (uint32_t)udiv64(part * 1000, (uint32_t)whole, NULL);
+}
+
+/* Blank the rest of the current row so a shorter line overwrites a longer one */
+static void top_clear_eol(void) {
+    int x, y;
+    vga_get_cursor(&x, &y);
+    while (x++ < VGA_WIDTH - 1) {
+        vga_putchar(' ');
+    }
+}
+
+/* Print a percentage given in tenths */
+static void top_print_tenths(uint32_t tenths) {
+    vga_printf("%3d.%d ", tenths / 10, tenths % 10);
+}
+
+/* Built-in: top - live per-process CPU usage, refreshed in place every second */
+void cmd_top(int argc, char* argv[]) {
+    UNUSED(argc);
+    UNUSED(argv);
+    
+    proc_info_t* info = (proc_info_t*)kmalloc(sizeof(proc_info_t) * TOP_MAX_PROCS);
+    top_sample_t* prev = (top_sample_t*)kmalloc(sizeof(top_sample_t) * TOP_MAX_PROCS * 2);
+    if (!info || !prev) {
+        kfree(info);
+        kfree(prev);
+        return;
+    }
+    top_sample_t* next = prev + TOP_MAX_PROCS;
+    static uint32_t delta[TOP_MAX_PROCS][ACCT_STATES];     /* Tenths of a percent */
+    static int order[TOP_MAX_PROCS];
+    
+    /* Baseline sample */
+    int prev_count = process_list(info, TOP_MAX_PROCS);
+    for (int i = 0; i < prev_count; i++) {
+        prev[i].pid = info[i].pid;
+        memcpy(prev[i].cycles, info[i].cycles, sizeof(prev[i].cycles));
+    }
+    uint64_t last_tsc = rdtsc();
+    
+    /* Static parts are drawn once; only the numbers are rewritten */
+    vga_clear();
+    vga_disable_cursor();
+    vga_set_cursor(0, 0);
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLUE));
+    vga_puts(" top - NightOS                                              press q to quit");
+    top_clear_eol();
+    vga_set_cursor(0, TOP_FIRST_ROW - 1);
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("  PID  Name             Core State  %CPU  User  Kern   IRQ  Voluntary Forced");
+    
+    const char* state_names[] = {"FREE", "READY", "RUN", "BLOCK", "ZOMBIE"};
+    int drawn = 0;
+    bool quit = false;
+    
+    while (!quit) {
+        /* Wait a second, watching for q */
+        for (int i = 0; i < 20 && !quit; i++) {
+            process_sleep(50);
+            while (keyboard_has_key()) {
+                char c = keyboard_getchar_nonblock();
+                if (c == 'q' || c == 'Q') quit = true;
+            }
+        }
+        if (quit) break;
+        
+        int count = process_list(info, TOP_MAX_PROCS);
+        uint64_t now = rdtsc();
+        uint64_t elapsed = now - last_tsc;
+        last_tsc = now;
+        
+        /* Per-process deltas against the previous sample, matched by PID */
+        uint64_t totals[ACCT_STATES] = {0};
+        for (int i = 0; i < count; i++) {
+            const top_sample_t* old = NULL;
+            for (int j = 0; j < prev_count; j++) {
+                if (prev[j].pid == info[i].pid) {
+                    old = &prev[j];
+                    break;
+                }
+            }
+            for (int s = 0; s < ACCT_STATES; s++) {
+                uint64_t d = info[i].cycles[s] - (old ? old->cycles[s] : 0);
+                delta[i][s] = tenths_of(d, elapsed);
+                totals[s] += d;
+            }
+            next[i].pid = info[i].pid;
+            memcpy(next[i].cycles, info[i].cycles, sizeof(next[i].cycles));
+            
+            /* Insertion sort by busy share, highest first */
+            uint32_t busy = delta[i][ACCT_KERNEL] + delta[i][ACCT_USER] + delta[i][ACCT_IRQ];
+            int k = i;
+            while (k > 0) {
+                int o = order[k - 1];
+                if (delta[o][ACCT_KERNEL] + delta[o][ACCT_USER] + delta[o][ACCT_IRQ] >= busy) break;
+                order[k] = o;
+                k--;
+            }
+            order[k] = i;
+        }
+        
+        top_sample_t* swap = prev;
+        prev = next;
+        next = swap;
+        prev_count = count;
+        
+        /* Summary across all CPUs */
+        uint64_t capacity = elapsed * (uint32_t)smp_cpu_count();
+        vga_set_cursor(0, 1);
+        vga_set_color(vga_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
+        vga_printf("  up %ds, %d CPU(s), %d processes, %d running", timer_get_seconds(),
+                   smp_cpu_count(), count, process_count_state(PROC_STATE_RUNNING));
+        top_clear_eol();
+        vga_set_cursor(0, 2);
+        vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_puts("  CPU: ");
+        top_print_tenths(tenths_of(totals[ACCT_USER], capacity));
+        vga_puts("user ");
+        top_print_tenths(tenths_of(totals[ACCT_KERNEL], capacity));
+        vga_puts("kernel ");
+        top_print_tenths(tenths_of(totals[ACCT_IRQ], capacity));
+        vga_puts("irq ");
+        top_print_tenths(tenths_of(totals[ACCT_IDLE], capacity));
+        vga_puts("idle");
+        top_clear_eol();
+        
+        /* One row per process, busiest first */
+        int rows = MIN(count, TOP_MAX_ROWS);
+        for (int r = 0; r < rows; r++) {
+            const proc_info_t* p = &info[order[r]];
+            const uint32_t* d = delta[order[r]];
+            
+            vga_set_cursor(0, TOP_FIRST_ROW + r);
+            vga_set_color(vga_color(p->state == PROC_STATE_RUNNING ? VGA_COLOR_GREEN
+                                                                   : VGA_COLOR_LIGHT_GREY,
+                                    VGA_COLOR_BLACK));
+            vga_printf("  %-4d %-16s %-4d %-6s ", p->pid, p->name, p->cpu, state_names[p->state]);
+            top_print_tenths(d[ACCT_KERNEL] + d[ACCT_USER] + d[ACCT_IRQ]);
+            top_print_tenths(d[ACCT_USER]);
+            top_print_tenths(d[ACCT_KERNEL]);
+            top_print_tenths(d[ACCT_IRQ]);
+            vga_printf(" %-9u %u", p->switches_voluntary, p->switches_forced);
+            top_clear_eol();
+        }
+        
+        /* Blank rows left over from a longer list */
+        for (int r = rows; r < drawn; r++) {
+            vga_set_cursor(0, TOP_FIRST_ROW + r);
+            top_clear_eol();
+        }
+        drawn = rows;
+    }
+    
+    kfree(info);
+    kfree(prev < next ? prev : next);
+    
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_clear();
+    vga_enable_cursor(14, 15);
+}
+
+/* Demo process: animates a marker on the top row without yielding */
+static void spinner_process(void) {
+    const char frames[] = "|/-\\";
+    int column = VGA_WIDTH - 1 - (int)(process_getpid() % 16);
+    
+    for (uint32_t i = 0; ; i++) {
+        vga_put_char_at(frames[i % 4], column, 0, VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+        for (volatile uint32_t spin = 0; spin < 200000; spin++);
+    }
+}
+
+/* Built-in: spawn - start a demo process */
+void cmd_spawn(int argc, char* argv[]) {
+    proc_priority_t priority = PROC_PRIORITY_NORMAL;
+    if (argc >= 2) {
+        if (strcmp(argv[1], "low") == 0) {
+            priority = PROC_PRIORITY_LOW;
+        } else if (strcmp(argv[1], "high") == 0) {
+            priority = PROC_PRIORITY_HIGH;
+        }
+    }
+    
+    /* Nobody waits for it: once killed it is freed, not left a zombie */
+    int pid = process_create("spinner", spinner_process, priority);
+    if (pid > 0) process_detach((uint32_t)pid);
+    if (pid < 0) {
+        vga_set_color(vga_color(VGA_COLOR_RED, VGA_COLOR_BLACK));
+        vga_printf("Failed to create process (error %d)\n", pid);
+    } else {
+        vga_set_color(vga_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK));
+        vga_printf("Started process %d\n", pid);
+    }
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+}
+
+/* Built-in: kill - terminate a process */
+void cmd_kill(int argc, char* argv[]) {
+    if (argc < 2) {
+        vga_puts("Usage: kill <pid>\n");
+        return;
+    }
+    
+    if (process_kill((uint32_t)atoi(argv[1])) == 0) {
+        vga_set_color(vga_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK));
+        vga_printf("Killed process %s\n", argv[1]);
+    } else {
+        vga_set_color(vga_color(VGA_COLOR_RED, VGA_COLOR_BLACK));
+        vga_printf("Cannot kill process %s\n", argv[1]);
+    }
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+}
+
+/* SMP benchmark state: work per job */
+static volatile uint32_t bench_iterations = 0;
+
+/* CPU-bound job: a fixed number of LCG steps, no shared state */
+static void bench_worker(void) {
+    volatile uint32_t x = process_getpid();
+    for (uint32_t i = 0; i < bench_iterations; i++) {
+        x = x * 1103515245 + 12345;
+    }
+}
+
+/* Built-in: smpbench - run 1..N CPU-bound jobs at once and report scaling */
+void cmd_smpbench(int argc, char* argv[]) {
+    uint32_t millions = (argc >= 2) ? (uint32_t)atoi(argv[1]) : 20;
+    if (millions == 0) millions = 1;
+    bench_iterations = millions * 1000000;
+    
+    int cpus = smp_cpu_count();
+    vga_set_color(vga_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
+    vga_printf("\n  %d CPU(s) online, %dM iterations per job\n\n", cpus, millions);
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("  Jobs  Time(ms)  Jobs/s  Speedup\n");
+    vga_puts("  ====  ========  ======  =======\n");
+    
+    uint32_t base_ms = 0;
+    for (int jobs = 1; jobs <= cpus; jobs++) {
+        uint32_t start = timer_get_uptime_ms();
+        
+        int pids[SMP_MAX_CPUS];
+        int started = 0;
+        for (int i = 0; i < jobs; i++) {
+            int pid = process_create("bench", bench_worker, PROC_PRIORITY_NORMAL);
+            if (pid > 0) pids[started++] = pid;
+        }
+        
+        /* Reap each job; we sleep meanwhile, so they get every CPU including ours */
+        for (int i = 0; i < started; i++) {
+            process_wait(pids[i], NULL);
+        }
+        
+        uint32_t elapsed = timer_get_uptime_ms() - start;
+        if (elapsed == 0) elapsed = 1;
+        if (jobs == 1) base_ms = elapsed;
+        
+        /* Speedup = work done per unit time relative to one job, in hundredths */
+        uint32_t speedup = (base_ms * started * 100) / elapsed;
+        
+        vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_printf("  %-5d %-9d %-7d ", started, elapsed, (started * 1000) / elapsed);
+        vga_set_color(vga_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK));
+        vga_printf("%d.%d%dx\n", speedup / 100, (speedup / 10) % 10, speedup % 10);
+    }
+    
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_putchar('\n');
+}
+
+/* Built-in: sched - show the fair class tuning, or set its granularity */
+void cmd_sched(int argc, char* argv[]) {
+    if (argc >= 2) {
+        scheduler_set_granularity((uint32_t)atoi(argv[1]));
+    }
+    
+    vga_set_color(vga_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
+    vga_puts("\n  Fair scheduling class\n");
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_printf("  Latency period:      %d ms\n", SCHED_LATENCY_MS);
+    vga_printf("  Minimum granularity: %d ms\n", scheduler_get_granularity());
+    vga_puts("  Weights:             low 335, normal 1024, high 3121\n");
+    vga_puts("  Realtime processes run round-robin ahead of the fair class\n\n");
+}
+
+/* 64-bit counter clamped for printing */
+static uint32_t clamp32(uint64_t value) {
+    return value > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)value;
+}
+
+/* Built-in: locks - show lock contention statistics [reset] */
+void cmd_locks(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        lock_stats_reset();
+        vga_puts("Lock statistics cleared\n");
+        return;
+    }
+    
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("\n  Lock        Acquired   Contended  Spins       Max hold (cycles)\n");
+    vga_puts("  ==========  =========  =========  ==========  =================\n");
+    
+    for (lock_stats_t* st = lock_stats_first(); st; st = st->next) {
+        vga_set_color(vga_color(st->contended ? VGA_COLOR_YELLOW : VGA_COLOR_LIGHT_GREY,
+                                VGA_COLOR_BLACK));
+        vga_printf("  %-11s %-10u %-10u %-11u %u\n", st->name, st->acquisitions,
+                   st->contended, clamp32(st->spins), clamp32(st->max_hold_cycles));
+    }
+    
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_putchar('\n');
+}
+
+/* Upper bound of the histogram bucket holding the median call */
+static uint32_t syscall_median(const syscall_stats_t* st) {
+    uint32_t seen = 0;
+    for (uint32_t b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+        seen += st->histogram[b];
+        if (seen * 2 >= st->calls) {
+            return b < 31 ? (2u << b) : 0xFFFFFFFF;
+        }
+    }
+    return 0;
+}
+
+/* One system call's latency histogram as bars */
+static void syscall_show_histogram(uint32_t num) {
+    syscall_stats_t st;
+    syscall_get_stats(num, &st);
+    
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_printf("\n  %s: %u calls, %u errors\n\n", syscall_name(num), st.calls, st.errors);
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    if (st.calls == 0) return;
+    
+    uint32_t peak = 0;
+    for (uint32_t b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+        if (st.histogram[b] > peak) peak = st.histogram[b];
+    }
+    
+    for (uint32_t b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+        if (st.histogram[b] == 0) continue;
+        uint32_t width = (uint32_t)udiv64((uint64_t)st.histogram[b] * 40, peak, NULL);
+        vga_printf("  < 2^%-2u %-10u ", b + 1, st.histogram[b]);
+        vga_set_color(vga_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
+        for (uint32_t i = 0; i < (width ? width : 1); i++) {
+            vga_putchar('#');
+        }
+        vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_putchar('\n');
+    }
+    vga_putchar('\n');
+}
+
+/* Built-in: syscalls - per-call counts and latency [reset | <name>] */
+void cmd_syscalls(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        syscall_stats_reset();
+        vga_puts("System call statistics cleared\n");
+        return;
+    }
+    if (argc >= 2) {
+        for (uint32_t num = 0; num < syscall_count(); num++) {
+            const char* name = syscall_name(num);
+            if (name && strcmp(name, argv[1]) == 0) {
+                syscall_show_histogram(num);
+                return;
+            }
+        }
+        vga_printf("Unknown system call: %s\n", argv[1]);
+        return;
+    }
+    
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("\n  Call            Calls      Errors     Mean (cycles)  Median <\n");
+    vga_puts("  ==============  =========  =========  =============  ==========\n");
+    
+    bool any = false;
+    for (uint32_t num = 0; num < syscall_count(); num++) {
+        syscall_stats_t st;
+        if (!syscall_get_stats(num, &st) || st.calls == 0) continue;
+        any = true;
+        
+        vga_set_color(vga_color(st.errors ? VGA_COLOR_YELLOW : VGA_COLOR_LIGHT_GREY,
+                                VGA_COLOR_BLACK));
+        vga_printf("  %-15s %-10u %-10u %-14u %u\n", syscall_name(num), st.calls, st.errors,
+                   clamp32(udiv64(st.cycles, st.calls, NULL)), syscall_median(&st));
+    }
+    
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    if (!any) vga_puts("  (no system calls since boot or the last reset)\n");
+    vga_puts("\n  'syscalls <name>' shows one call's latency histogram\n\n");
+}
+
+/* Built-in: ipc - open pipes and shared memory segments */
+void cmd_ipc(int argc, char* argv[]) {
+    UNUSED(argc); UNUSED(argv);
+    
+    pipe_stats_t ps;
+    pipe_get_stats(&ps);
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("\n  Pipes\n");
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_printf("  Open:         %u of %u\n", ps.open, PIPE_MAX);
+    vga_printf("  Copied:       %u bytes\n", ps.bytes_copied);
+    vga_printf("  Pages lent:   %u (%u KB written without a copy)\n",
+               ps.pages_lent, ps.pages_lent * (PAGE_SIZE / 1024));
+    
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("\n  ID  Segment                           Size     Refs  Maps\n");
+    vga_puts("  ==  ================================  =======  ====  ====\n");
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    
+    bool any = false;
+    for (int id = 0; id < SHM_MAX_SEGMENTS; id++) {
+        shm_info_t info;
+        if (!shm_get_info(id, &info)) continue;
+        any = true;
+        vga_printf("  %-3d %-33s %-8u %-5u %u\n", id, info.name, info.size, info.refs, info.maps);
+    }
+    if (!any) vga_puts("  (no shared memory segments)\n");
+    vga_puts("\n");
+}
+
+/* Built-in: stacks - stack pool usage and per-process peaks [reserve <n>] */
+void cmd_stacks(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "reserve") == 0) {
+        stack_pool_set_reserve((uint32_t)atoi(argv[2]));
+    }
+    
+    stack_pool_stats_t st;
+    stack_pool_get_stats(&st);
+    
+    vga_set_color(vga_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
+    vga_printf("\n  Stack pool: %u slots of %u bytes, each above a guard page\n",
+               st.slots, PROCESS_STACK_SIZE);
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_printf("  In use %u, ready %u (reserve %u), awaiting repaint %u\n",
+               st.in_use, st.ready, st.reserve, st.dirty);
+    vga_printf("  Allocations %u, served ready %u, heap fallbacks %u\n",
+               st.allocs, st.ready_hits, st.fallbacks);
+    vga_printf("  Deepest freed stack: %u bytes\n", st.peak_used);
+    
+    /* Peak use of freed stacks, in eighths of the stack size */
+    vga_puts("  Freed by peak:");
+    for (int i = 0; i < STACK_HISTOGRAM_BUCKETS; i++) {
+        vga_printf(" %u", st.histogram[i]);
+    }
+    vga_puts("  (1/8 .. 8/8)\n");
+    
+    int max = process_count();
+    proc_info_t* info = (proc_info_t*)kmalloc(sizeof(proc_info_t) * max);
+    if (!info) return;
+    int count = process_list(info, max);
+    
+    vga_set_color(vga_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("\n  PID  Name             Peak (bytes)\n");
+    vga_puts("  ===  ====             ============\n");
+    
+    for (int i = 0; i < count; i++) {
+        if (!info[i].stack) continue;
+        
+        /* A snapshot: the process may exit while we read its stack */
+        uint32_t used = stack_high_water(info[i].stack);
+        vga_set_color(vga_color(used * 4 >= PROCESS_STACK_SIZE * 3 ? VGA_COLOR_YELLOW
+                                                                  : VGA_COLOR_LIGHT_GREY,
+                                VGA_COLOR_BLACK));
+        vga_printf("  %-4d %-16s %u\n", info[i].pid, info[i].name, used);
+    }
+    kfree(info);
+    
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_putchar('\n');
+}
+
+/* Program thread for `run`: becomes the program, or exits with exec's error */
+static int run_program(void* arg) {
+    char** args = (char**)arg;
+    return process_exec(args[0], args);
+}
+
+/* Built-in: run - load an ELF program from a file and wait for it */
+void cmd_run(int argc, char* argv[]) {
+    if (argc < 2) {
+        vga_puts("Usage: run <program> [args...]\n");
+        return;
+    }
+    
+    /* Stays valid until the program exits: we wait for it here */
+    char* args[SHELL_MAX_ARGS + 1];
+    for (int i = 1; i < argc; i++) {
+        args[i - 1] = argv[i];
+    }
+    args[argc - 1] = NULL;
+    
+    int pid = kthread_create(argv[1], run_program, args, PROC_PRIORITY_NORMAL);
+    if (pid < 0) {
+        vga_set_color(vga_color(VGA_COLOR_RED, VGA_COLOR_BLACK));
+        vga_printf("Failed to create process (error %d)\n", pid);
+        vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        return;
+    }
+    
+    int status = 0;
+    if (process_wait(pid, &status) < 0) return;
+    
+    vga_set_color(vga_color(status == 0 ? VGA_COLOR_GREEN : VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    vga_printf("Process %d exited with status %d\n", pid, status);
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+}
+
+/* Null-syscall benchmark, run in ring 3 (kernel/usercode.asm) */
+extern uint8_t sysbench_start[];
+extern uint8_t sysbench_end[];
+
+static int run_sysbench(void* arg) {
+    char** args = (char**)arg;
+    return process_exec_code(args[0], sysbench_start, sysbench_end - sysbench_start, args);
+}
+
+/* Built-in: sysbench - round-trip cost of int 0x80 and SYSENTER */
+void cmd_sysbench(int argc, char* argv[]) {
+    UNUSED(argc); UNUSED(argv);
+    
+    /* A second argument tells the program it may use SYSENTER */
+    char name[] = "sysbench";
+    char fast[] = "sysenter";
+    char* args[] = { name, syscall_fast_available() ? fast : NULL, NULL };
+    
+    int pid = kthread_create(name, run_sysbench, args, PROC_PRIORITY_NORMAL);
+    if (pid < 0) {
+        vga_set_color(vga_color(VGA_COLOR_RED, VGA_COLOR_BLACK));
+        vga_printf("Failed to create process (error %d)\n", pid);
+        vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        return;
+    }
+    
+    int status = 0;
+    if (process_wait(pid, &status) < 0) return;
+    if (status < 0 && status > -0x10000) {
+        vga_printf("Benchmark failed (error %d)\n", status);
+        return;
+    }
+    
+    uint32_t result = (uint32_t)status;
+    vga_puts("Null system call (getpid) round trip from ring 3:\n");
+    vga_printf("  int 0x80:  %u cycles\n", result >> 16);
+    if (syscall_fast_available()) {
+        vga_printf("  SYSENTER:  %u cycles\n", result & 0xFFFF);
+    } else {
+        vga_puts("  SYSENTER:  not supported by this CPU\n");
+    }
+}
+
 /* Initialize shell */
 void shell_init(void) {
     num_commands = 0;
@@ -551,7 +1199,20 @@ void shell_init(void) {
     shell_register_command("rm", "Delete a file", cmd_rm);
     shell_register_command("cat", "Display file content", cmd_cat);
     shell_register_command("write", "Write to a file", cmd_write);
+    shell_register_command("snapshot", "Snapshot filesystem [drop]", cmd_snapshot);
+    shell_register_command("rollback", "Roll back to snapshot", cmd_rollback);
     shell_register_command("ps", "List processes", cmd_ps);
+    shell_register_command("top", "Live CPU usage by process", cmd_top);
+    shell_register_command("spawn", "Start a demo process [low|high]", cmd_spawn);
+    shell_register_command("kill", "Terminate a process", cmd_kill);
+    shell_register_command("smpbench", "CPU scaling benchmark [millions]", cmd_smpbench);
+    shell_register_command("locks", "Lock contention statistics [reset]", cmd_locks);
+    shell_register_command("sched", "Scheduler tuning [granularity ms]", cmd_sched);
+    shell_register_command("stacks", "Stack pool and peak stack use [reserve n]", cmd_stacks);
+    shell_register_command("run", "Run an ELF program [args]", cmd_run);
+    shell_register_command("sysbench", "int 0x80 vs SYSENTER round trip", cmd_sysbench);
+    shell_register_command("syscalls", "System call counts and latency [reset|name]", cmd_syscalls);
+    shell_register_command("ipc", "Pipes and shared memory segments", cmd_ipc);
 }
 
 /* Main shell loop */
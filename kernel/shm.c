@@ -0,0 +1,222 @@
+/*
+ * NightOS - Shared Memory Implementation
+ * 
+ * A segment is a fixed set of pool frames, allocated and zeroed when it
+ * is created. Mapping one adds a VMA_SHM area to the program, and its
+ * pages are filled on first touch with the segment's own frames,
+ * writable and never copy-on-write, so every mapping (a forked child's
+ * included) sees the same memory. The segment holds a reference on
+ * each frame, and is itself held by its open ids and by every area
+ * mapping it; the last of those frees the frames.
+ * 
+ * Each process keeps a bit per id it has open (shm_ids), holding one
+ * reference however often it opens the segment. Only those ids can be
+ * closed or mapped by it; fork hands the child the parent's ids with
+ * a reference each, and exit drops whatever is still open.
+ */
+
+#include "../include/shm.h"
+#include "../include/vmm.h"
+#include "../include/process.h"
+#include "../include/sync.h"
+#include "../include/errno.h"
+#include "../include/string.h"
+
+static shm_segment_t segments[SHM_MAX_SEGMENTS];
+static spinlock_t shm_lock;
+
+/* Initialize the segment table */
+void shm_init(void) {
+    spin_lock_init(&shm_lock, "shm");
+    memset(segments, 0, sizeof(segments));
+}
+
+/* Segment id if it is in use, else NULL (shm_lock held) */
+static shm_segment_t* shm_lookup(int id) {
+    if (id < 0 || id >= SHM_MAX_SEGMENTS || !segments[id].refs) return NULL;
+    return &segments[id];
+}
+
+/* Bit of an id in a process's shm_ids */
+static inline uint32_t shm_bit(int id) {
+    return 1u << id;
+}
+
+/* Segment id if the calling process has it open, else NULL (shm_lock held) */
+static shm_segment_t* shm_held(int id) {
+    shm_segment_t* seg = shm_lookup(id);
+    if (!seg || !(process_current()->shm_ids & shm_bit(id))) return NULL;
+    return seg;
+}
+
+/* Drop a reference, freeing the frames with the last (shm_lock held) */
+static void shm_release(shm_segment_t* seg) {
+    if (--seg->refs) return;
+    
+    for (uint32_t i = 0; i < seg->pages; i++) {
+        frame_put(seg->frames[i]);
+    }
+    seg->pages = 0;
+    seg->name[0] = '\0';
+}
+
+/* Open the segment called name, creating it if there is none */
+int shm_open(const char* name, uint32_t size) {
+    if (!name[0] || strlen(name) >= SHM_NAME_MAX || size > SHM_MAX_PAGES * PAGE_SIZE) {
+        return -EINVAL;
+    }
+    uint32_t pages = ALIGN(size, PAGE_SIZE) / PAGE_SIZE;
+    process_t* self = process_current();
+    
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    shm_segment_t* free_slot = NULL;
+    for (int i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        shm_segment_t* seg = &segments[i];
+        if (!seg->refs) {
+            if (!free_slot) free_slot = seg;
+            continue;
+        }
+        if (strcmp(seg->name, name) != 0) continue;
+        
+        int result = i;
+        if (pages > seg->pages) {
+            result = -EINVAL;
+        } else if (!(self->shm_ids & shm_bit(i))) {
+            seg->refs++;
+            self->shm_ids |= shm_bit(i);
+        }
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return result;
+    }
+    
+    int result;
+    if (!pages) {
+        result = -ENOENT;
+    } else if (!free_slot) {
+        result = -ENFILE;
+    } else {
+        shm_segment_t* seg = free_slot;
+        result = (int)(seg - segments);
+        for (seg->pages = 0; seg->pages < pages; seg->pages++) {
+            uint32_t frame = frame_alloc();
+            if (!frame) {
+                result = -ENOMEM;
+                break;
+            }
+            memset((void*)frame, 0, PAGE_SIZE);
+            seg->frames[seg->pages] = frame;
+        }
+        
+        if (result < 0) {
+            while (seg->pages) {
+                frame_put(seg->frames[--seg->pages]);
+            }
+        } else {
+            strncpy(seg->name, name, SHM_NAME_MAX);
+            seg->refs = 1;
+            seg->maps = 0;
+            self->shm_ids |= shm_bit(result);
+        }
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+    return result;
+}
+
+/* Drop an id the caller has open; mappings keep the segment alive */
+int shm_close(int id) {
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    shm_segment_t* seg = shm_held(id);
+    if (seg) {
+        process_current()->shm_ids &= ~shm_bit(id);
+        shm_release(seg);
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+    return seg ? 0 : -EBADF;
+}
+
+/* A forked child has ids (a shm_ids mask) open as well as its parent */
+void shm_fork(uint32_t ids) {
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    for (int i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (ids & shm_bit(i)) segments[i].refs++;
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/* Drop every id in ids, for a process that is exiting */
+void shm_release_ids(uint32_t ids) {
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    for (int i = 0; i < SHM_MAX_SEGMENTS; i++) {
+        if (ids & shm_bit(i)) shm_release(&segments[i]);
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/* Map a segment read-write into the calling program */
+int shm_map(int id) {
+    mm_t* mm = process_current()->mm;
+    if (!mm) return -EINVAL;
+    
+    /* Hold it while the area is added, in case its id is closed meanwhile */
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    shm_segment_t* seg = shm_held(id);
+    if (seg) seg->refs++;
+    spin_unlock_irqrestore(&shm_lock, flags);
+    if (!seg) return -EBADF;
+    
+    int result = -ENOMEM;
+    uint32_t size = seg->pages * PAGE_SIZE;
+    uint32_t addr = mm_find_gap(mm, SHM_MAP_BASE, size);
+    if (addr) {
+        vm_area_t area;
+        memset(&area, 0, sizeof(area));
+        area.start = addr;
+        area.end = addr + size;
+        area.flags = VMA_READ | VMA_WRITE | VMA_SHM;
+        area.shm = seg;
+        result = mm_add_area(mm, &area);
+        if (result >= 0) result = (int)addr;
+    }
+    
+    flags = spin_lock_irqsave(&shm_lock);
+    shm_release(seg);
+    spin_unlock_irqrestore(&shm_lock, flags);
+    return result;
+}
+
+/* Information on segment id; false if it is not open */
+bool shm_get_info(int id, shm_info_t* info) {
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    shm_segment_t* seg = shm_lookup(id);
+    if (seg) {
+        memcpy(info->name, seg->name, SHM_NAME_MAX);
+        info->size = seg->pages * PAGE_SIZE;
+        info->refs = seg->refs;
+        info->maps = seg->maps;
+    }
+    spin_unlock_irqrestore(&shm_lock, flags);
+    return seg != NULL;
+}
+
+/* ========== Address Space Hooks ========== */
+
+/* An area now maps seg (mm_add_area) */
+void shm_get(shm_segment_t* seg) {
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    seg->refs++;
+    seg->maps++;
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/* An area mapping seg is gone (mm_destroy) */
+void shm_put(shm_segment_t* seg) {
+    uint32_t flags = spin_lock_irqsave(&shm_lock);
+    seg->maps--;
+    shm_release(seg);
+    spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/* Frame backing page index of a segment */
+uint32_t shm_frame(const shm_segment_t* seg, uint32_t index) {
+    return seg->frames[index];
+}
@@ -0,0 +1,260 @@
+/*
+ * NightOS - Symmetric Multiprocessing Implementation
+ * 
+ * CPUs are found in the ACPI MADT and started one at a time with the
+ * INIT-SIPI-SIPI sequence. Each AP runs a small real-mode trampoline
+ * (kernel/ap_boot.asm) into ap_main, loads its own GDT and TSS, and
+ * adopts its boot stack as its idle process. Legacy IRQs stay on the
+ * BSP; every AP schedules from its local APIC timer.
+ */
+
+#include "../include/smp.h"
+#include "../include/config.h"
+#include "../include/apic.h"
+#include "../include/idt.h"
+#include "../include/process.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+#include "../include/timer.h"
+#include "../include/fpu.h"
+#include "../include/paging.h"
+#include "../include/stackpool.h"
+#include "../include/syscall.h"
+
+/* CPU table; entry 0 is the bootstrap processor */
+static cpu_t cpus[SMP_MAX_CPUS];
+static int cpu_count = 1;
+
+/* APIC timer counts per PIT tick, so every CPU ticks at TIMER_FREQUENCY */
+static uint32_t lapic_counts = 0;
+
+/* Trampoline image and its parameter slots (kernel/ap_boot.asm) */
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_stack[];
+extern uint8_t ap_trampoline_cpu[];
+extern uint8_t ap_trampoline_entry[];
+
+/* ========== ACPI Tables ========== */
+
+/* Root System Description Pointer (ACPI 1.0 part) */
+typedef struct {
+    char signature[8];                  /* "RSD PTR " */
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+} __attribute__((packed)) acpi_rsdp_t;
+
+/* Common header of every system description table */
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header_t;
+
+/* Multiple APIC Description Table; variable-length entries follow */
+typedef struct {
+    acpi_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+#define MADT_ENTRY_LAPIC    0
+#define MADT_LAPIC_ENABLED  0x1
+
+/* Bytes of a table sum to zero */
+static bool acpi_checksum_ok(const void* table, uint32_t length) {
+    const uint8_t* bytes = (const uint8_t*)table;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+/* Scan a physical range on 16-byte boundaries for the RSDP */
+static acpi_rsdp_t* acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + sizeof(acpi_rsdp_t) <= end; addr += 16) {
+        acpi_rsdp_t* rsdp = (acpi_rsdp_t*)addr;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 &&
+            acpi_checksum_ok(rsdp, sizeof(acpi_rsdp_t))) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+/* RSDP lives in the first KB of the EBDA or in the BIOS ROM area */
+static acpi_rsdp_t* acpi_find_rsdp(void) {
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t*)0x40E) << 4;
+    acpi_rsdp_t* rsdp = NULL;
+    
+    if (ebda) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(0xE0000, 0x100000);
+    }
+    return rsdp;
+}
+
+/* Collect enabled local APIC IDs from the MADT; returns how many */
+static int madt_find_cpus(uint32_t* apic_ids, int max, uint32_t* lapic_address) {
+    acpi_rsdp_t* rsdp = acpi_find_rsdp();
+    if (!rsdp) return 0;
+    
+    acpi_header_t* rsdt = (acpi_header_t*)rsdp->rsdt_address;
+    if (memcmp(rsdt->signature, "RSDT", 4) != 0) return 0;
+    
+    uint32_t* tables = (uint32_t*)(rsdt + 1);
+    uint32_t ntables = (rsdt->length - sizeof(acpi_header_t)) / 4;
+    
+    for (uint32_t i = 0; i < ntables; i++) {
+        acpi_madt_t* madt = (acpi_madt_t*)tables[i];
+        if (memcmp(madt->header.signature, "APIC", 4) != 0) continue;
+        if (!acpi_checksum_ok(madt, madt->header.length)) continue;
+        
+        *lapic_address = madt->lapic_address;
+        
+        int count = 0;
+        uint8_t* entry = (uint8_t*)(madt + 1);
+        uint8_t* end = (uint8_t*)madt + madt->header.length;
+        while (entry + 2 <= end && entry[1] >= 2) {
+            /* Type 0: ACPI processor ID, APIC ID, flags */
+            if (entry[0] == MADT_ENTRY_LAPIC && count < max &&
+                (*(uint32_t*)(entry + 4) & MADT_LAPIC_ENABLED)) {
+                apic_ids[count++] = entry[3];
+            }
+            entry += entry[1];
+        }
+        return count;
+    }
+    return 0;
+}
+
+/* ========== AP Start-up ========== */
+
+/* Local APIC timer: the scheduling tick of an AP */
+static void lapic_timer_callback(registers_t* regs) {
+    UNUSED(regs);
+    this_cpu()->ticks++;
+    scheduler_tick();
+}
+
+/* C entry point of an application processor (kernel/ap_boot.asm) */
+void ap_main(cpu_t* cpu) {
+    gdt_init_cpu(cpu);
+    paging_init_cpu();
+    idt_reload();
+    lapic_init(0);
+    fpu_init_cpu();
+    syscall_init_cpu();
+    
+    /* This stack becomes our idle process; the BSP may continue now */
+    scheduler_init_cpu(cpu->boot_stack);
+    cpu->online = true;
+    
+    lapic_timer_start(lapic_counts);
+    __asm__ volatile("sti");
+    
+    while (1) {
+        stack_pool_refill();
+        __asm__ volatile("hlt");
+    }
+}
+
+/* Start one AP and wait for it to come online; false on timeout */
+static bool smp_boot_ap(cpu_t* cpu) {
+    cpu->boot_stack = stack_alloc();
+    if (!cpu->boot_stack) return false;
+    
+    /* Fill in the trampoline's parameter slots */
+    uint8_t* page = (uint8_t*)AP_TRAMPOLINE_ADDR;
+    uint32_t stack_top = (uint32_t)(cpu->boot_stack + PROCESS_STACK_SIZE) & ~0xF;
+    *(uint32_t*)(page + (ap_trampoline_stack - ap_trampoline)) = stack_top;
+    *(uint32_t*)(page + (ap_trampoline_cpu - ap_trampoline)) = (uint32_t)cpu;
+    *(uint32_t*)(page + (ap_trampoline_entry - ap_trampoline)) = (uint32_t)ap_main;
+    
+    /* INIT, wait 10ms, then STARTUP; a second STARTUP if the first was missed */
+    lapic_send_init(cpu->apic_id);
+    msleep(10);
+    
+    for (int attempt = 0; attempt < 2 && !cpu->online; attempt++) {
+        lapic_send_startup(cpu->apic_id, (uint8_t)(AP_TRAMPOLINE_ADDR >> 12));
+        
+        uint32_t start = timer_get_ticks();
+        while (!cpu->online && timer_get_ticks() - start < TIMER_FREQUENCY / 10) {
+            __asm__ volatile("pause");
+        }
+    }
+    
+    if (!cpu->online) {
+        stack_free(cpu->boot_stack);
+        cpu->boot_stack = NULL;
+    }
+    return cpu->online;
+}
+
+/* ========== Public Interface ========== */
+
+/* Set up the bootstrap CPU's GDT and per-CPU data (first thing at boot) */
+void smp_early_init(void) {
+    memset(cpus, 0, sizeof(cpus));
+    
+    cpu_t* bsp = &cpus[0];
+    bsp->self = bsp;
+    bsp->id = 0;
+    bsp->online = true;
+    gdt_init_cpu(bsp);
+    
+    cpu_count = 1;
+}
+
+/* Find the other CPUs in the ACPI MADT and start them (timer must run) */
+void smp_init(void) {
+    uint32_t apic_ids[SMP_MAX_CPUS];
+    uint32_t lapic_address = 0;
+    
+    int found = madt_find_cpus(apic_ids, SMP_MAX_CPUS, &lapic_address);
+    if (found <= 1) return;
+    
+    lapic_init(lapic_address);
+    cpus[0].apic_id = lapic_id();
+    
+    lapic_counts = lapic_timer_calibrate();
+    register_interrupt_handler(LAPIC_TIMER_VECTOR, lapic_timer_callback);
+    
+    memcpy((void*)AP_TRAMPOLINE_ADDR, ap_trampoline,
+           (uint32_t)(ap_trampoline_end - ap_trampoline));
+    
+    for (int i = 0; i < found && cpu_count < SMP_MAX_CPUS; i++) {
+        if (apic_ids[i] == cpus[0].apic_id) continue;
+        
+        cpu_t* cpu = &cpus[cpu_count];
+        cpu->self = cpu;
+        cpu->id = cpu_count;
+        cpu->apic_id = apic_ids[i];
+        
+        if (smp_boot_ap(cpu)) {
+            cpu_count++;
+        }
+    }
+}
+
+/* Number of CPUs that are scheduling */
+int smp_cpu_count(void) {
+    return cpu_count;
+}
+
+/* CPU table entry, or NULL if that CPU is not online */
+cpu_t* smp_cpu(uint32_t id) {
+    if (id >= SMP_MAX_CPUS || !cpus[id].online) return NULL;
+    return &cpus[id];
+}
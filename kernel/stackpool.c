@@ -0,0 +1,199 @@
+/*
+ * NightOS - Process Stack Pool Implementation
+ * 
+ * The stack region is divided into slots of one unmapped guard page
+ * followed by the stack, so running off the bottom of a stack faults
+ * instead of corrupting its neighbour. Stacks are painted with a
+ * canary; the first word that no longer holds it marks how deep the
+ * stack has ever been used. A freed stack goes on the dirty list in
+ * O(1), since it is freed under the scheduler lock; idle CPUs later
+ * measure its peak and repaint only the part that was used, keeping
+ * up to `reserve` stacks ready for process creation. When every slot
+ * is taken, stacks come from the heap without a guard.
+ */
+
+#include "../include/stackpool.h"
+#include "../include/config.h"
+#include "../include/paging.h"
+#include "../include/process.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+#include "../include/sync.h"
+
+#define SLOT_SIZE       (PAGE_SIZE + PROCESS_STACK_SIZE)
+#define POOL_SLOTS      (STACK_POOL_SIZE / SLOT_SIZE)
+#define STACK_WORDS     (PROCESS_STACK_SIZE / sizeof(uint32_t))
+
+/* Free slots: painted ones, and freed ones still to be measured */
+static uint16_t ready_list[POOL_SLOTS];
+static uint16_t dirty_list[POOL_SLOTS];
+static uint32_t ready_count = 0;
+static uint32_t dirty_count = 0;
+static uint32_t next_fresh = 0;         /* Slots below this have been handed out */
+
+static stack_pool_stats_t stats;
+static spinlock_t pool_lock;
+
+/* ========== Helpers ========== */
+
+static inline uint8_t* slot_stack(uint32_t slot) {
+    return (uint8_t*)(STACK_POOL_BASE + slot * SLOT_SIZE + PAGE_SIZE);
+}
+
+/* Slot of a pool stack, or -1 for a heap fallback */
+static int stack_slot(const uint8_t* stack) {
+    uint32_t offset = (uint32_t)stack - STACK_POOL_BASE;
+    if ((uint32_t)stack < STACK_POOL_BASE || offset >= POOL_SLOTS * SLOT_SIZE) return -1;
+    return (int)(offset / SLOT_SIZE);
+}
+
+/* Paint the top `used` bytes of a stack (the part below was never touched) */
+static void stack_paint(uint8_t* stack, uint32_t used) {
+    uint32_t* words = (uint32_t*)stack;
+    for (uint32_t i = STACK_WORDS - used / sizeof(uint32_t); i < STACK_WORDS; i++) {
+        words[i] = STACK_CANARY;
+    }
+}
+
+/* Measure a freed stack and add its peak to the statistics; returns it */
+static uint32_t record_peak(const uint8_t* stack) {
+    uint32_t used = stack_high_water(stack);
+    uint32_t bucket = used * STACK_HISTOGRAM_BUCKETS / PROCESS_STACK_SIZE;
+    if (bucket >= STACK_HISTOGRAM_BUCKETS) bucket = STACK_HISTOGRAM_BUCKETS - 1;
+    
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    if (used > stats.peak_used) stats.peak_used = used;
+    stats.histogram[bucket]++;
+    spin_unlock_irqrestore(&pool_lock, flags);
+    return used;
+}
+
+/* ========== Pool ========== */
+
+/* Carve the stack region into guarded slots (paging must be on) */
+void stack_pool_init(void) {
+    spin_lock_init(&pool_lock, "stackpool");
+    memset(&stats, 0, sizeof(stats));
+    stats.slots = POOL_SLOTS;
+    stats.reserve = STACK_POOL_RESERVE;
+    
+    /* No other CPU runs yet, so nobody holds a stale TLB entry for these */
+    for (uint32_t slot = 0; slot < POOL_SLOTS; slot++) {
+        paging_set_present(STACK_POOL_BASE + slot * SLOT_SIZE, false);
+    }
+    
+    stack_pool_refill();
+}
+
+/* A painted PROCESS_STACK_SIZE stack, or NULL if memory is exhausted */
+uint8_t* stack_alloc(void) {
+    uint8_t* stack = NULL;
+    bool recycled = false;
+    
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    stats.allocs++;
+    if (ready_count) {
+        stack = slot_stack(ready_list[--ready_count]);
+        stats.ready_hits++;
+        stats.in_use++;
+        spin_unlock_irqrestore(&pool_lock, flags);
+        return stack;
+    }
+    
+    if (dirty_count) {
+        stack = slot_stack(dirty_list[--dirty_count]);
+        recycled = true;
+    } else if (next_fresh < POOL_SLOTS) {
+        stack = slot_stack(next_fresh++);
+    } else {
+        stats.fallbacks++;
+    }
+    if (stack) stats.in_use++;
+    spin_unlock_irqrestore(&pool_lock, flags);
+    
+    if (!stack) {
+        stack = (uint8_t*)kmalloc(PROCESS_STACK_SIZE);
+        if (!stack) return NULL;
+    }
+    
+    /* Nobody else can see the stack now, so measure and paint unlocked */
+    stack_paint(stack, recycled ? record_peak(stack) : PROCESS_STACK_SIZE);
+    return stack;
+}
+
+/* Return a stack; cheap enough to call with the scheduler lock held */
+void stack_free(uint8_t* stack) {
+    if (!stack) return;
+    
+    int slot = stack_slot(stack);
+    if (slot < 0) {
+        record_peak(stack);
+        kfree(stack);
+        return;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    dirty_list[dirty_count++] = (uint16_t)slot;
+    stats.in_use--;
+    spin_unlock_irqrestore(&pool_lock, flags);
+}
+
+/* Repaint freed stacks until the reserve is ready (idle loops) */
+void stack_pool_refill(void) {
+    while (ready_count < stats.reserve) {
+        uint32_t flags = spin_lock_irqsave(&pool_lock);
+        
+        /* Prefer recycled stacks; fall back to untouched slots */
+        int slot = -1;
+        bool recycled = false;
+        if (ready_count >= stats.reserve) {
+            /* Another CPU filled it meanwhile */
+        } else if (dirty_count) {
+            slot = dirty_list[--dirty_count];
+            recycled = true;
+        } else if (next_fresh < POOL_SLOTS) {
+            slot = (int)next_fresh++;
+        }
+        spin_unlock_irqrestore(&pool_lock, flags);
+        if (slot < 0) return;
+        
+        /* The slot is ours alone until it is listed as ready */
+        uint8_t* stack = slot_stack(slot);
+        stack_paint(stack, recycled ? record_peak(stack) : PROCESS_STACK_SIZE);
+        
+        flags = spin_lock_irqsave(&pool_lock);
+        ready_list[ready_count++] = (uint16_t)slot;
+        spin_unlock_irqrestore(&pool_lock, flags);
+    }
+}
+
+/* Free stacks to keep painted and ready */
+void stack_pool_set_reserve(uint32_t reserve) {
+    stats.reserve = reserve > POOL_SLOTS ? POOL_SLOTS : reserve;
+}
+
+/* Deepest use of a live stack so far, in bytes */
+uint32_t stack_high_water(const uint8_t* stack) {
+    const uint32_t* words = (const uint32_t*)stack;
+    uint32_t i = 0;
+    while (i < STACK_WORDS && words[i] == STACK_CANARY) {
+        i++;
+    }
+    return (STACK_WORDS - i) * sizeof(uint32_t);
+}
+
+/* True if addr lies in the guard page below a pool stack */
+bool stack_is_guard(uint32_t addr) {
+    if (addr < STACK_POOL_BASE || addr >= STACK_POOL_BASE + POOL_SLOTS * SLOT_SIZE) {
+        return false;
+    }
+    return (addr - STACK_POOL_BASE) % SLOT_SIZE < PAGE_SIZE;
+}
+
+void stack_pool_get_stats(stack_pool_stats_t* out) {
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    *out = stats;
+    out->ready = ready_count;
+    out->dirty = dirty_count;
+    spin_unlock_irqrestore(&pool_lock, flags);
+}
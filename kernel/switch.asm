@@ -0,0 +1,74 @@
+; NightOS - Context Switch (Assembly)
+; Saves the callee-saved registers of one task and resumes another,
+; and starts programs loaded by process_exec
+
+[BITS 32]
+
+; Handle MinGW naming convention (underscore prefix for C symbols)
+%ifdef MINGW
+global _context_switch, _exec_enter
+%define context_switch _context_switch
+%define exec_enter _exec_enter
+%else
+global context_switch, exec_enter
+%endif
+
+; ============================================
+; void context_switch(cpu_context_t** old, cpu_context_t* new, uint32_t cr3)
+;
+; Pushes a cpu_context_t onto the current stack, stores its address
+; in *old, then switches to the stack at new and pops that context.
+; The final ret lands wherever the new task last called in from, or
+; in its entry trampoline if it has never run. The incoming task's
+; page directory is loaded on the way, if it differs from ours.
+; ============================================
+context_switch:
+    mov eax, [esp + 4]          ; old
+    mov edx, [esp + 8]          ; new
+    mov ecx, [esp + 12]         ; cr3
+    
+    ; Save outgoing task (layout must match cpu_context_t)
+    pushfd
+    push ebp
+    push ebx
+    push esi
+    push edi
+    mov [eax], esp
+    
+    ; Change address spaces only if we must: a load flushes the TLB
+    mov eax, cr3
+    cmp eax, ecx
+    je .same_space
+    mov cr3, ecx
+.same_space:
+    mov esp, edx
+    
+    ; Restore incoming task
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    popfd
+    
+    ret
+
+; ============================================
+; void exec_enter(uint32_t esp, uint32_t entry)
+;
+; Drops to ring 3 at entry on the user stack process_exec built,
+; with interrupts on. Kernel entries come back in on this CPU's
+; tss.esp0, which exec_finish pointed at the process's kernel stack.
+; ============================================
+exec_enter:
+    mov eax, [esp + 8]          ; entry
+    mov ecx, [esp + 4]          ; user esp
+    mov dx, 0x23                ; User data, RPL 3
+    mov ds, dx
+    mov es, dx
+    push dword 0x23             ; ss
+    push ecx                    ; esp
+    push dword 0x202            ; eflags: IF
+    push dword 0x1B             ; cs: user code, RPL 3
+    push eax                    ; eip
+    xor ebp, ebp
+    iret
@@ -12,6 +12,17 @@
 #include "../include/process.h"
 #include "../include/fs.h"
 #include "../include/rtc.h"
+#include "../include/ioring.h"
+#include "../include/futex.h"
+#include "../include/errno.h"
+#include "../include/gdt.h"
+#include "../include/smp.h"
+#include "../include/io.h"
+#include "../include/vdso.h"
+#include "../include/string.h"
+#include "../include/uaccess.h"
+#include "../include/pipe.h"
+#include "../include/shm.h"
 
 /* System call table */
 typedef int (*syscall_fn_t)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
@@ -22,6 +33,9 @@ static int sys_write_handler(uint32_t fd, uint32_t buf, uint32_t count, uint32_t
 static int sys_read_handler(uint32_t fd, uint32_t buf, uint32_t count, uint32_t, uint32_t);
 static int sys_open_handler(uint32_t path, uint32_t flags, uint32_t, uint32_t, uint32_t);
 static int sys_close_handler(uint32_t fd, uint32_t, uint32_t, uint32_t, uint32_t);
+static int sys_fork_handler(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+static int sys_exec_handler(uint32_t path, uint32_t argv, uint32_t, uint32_t, uint32_t);
+static int sys_wait_handler(uint32_t status, uint32_t, uint32_t, uint32_t, uint32_t);
 static int sys_getpid_handler(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
 static int sys_sleep_handler(uint32_t ms, uint32_t, uint32_t, uint32_t, uint32_t);
 static int sys_time_handler(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
@@ -29,6 +43,15 @@ static int sys_malloc_handler(uint32_t size, uint32_t, uint32_t, uint32_t, uint3
 static int sys_free_handler(uint32_t ptr, uint32_t, uint32_t, uint32_t, uint32_t);
 static int sys_yield_handler(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
 static int sys_kill_handler(uint32_t pid, uint32_t sig, uint32_t, uint32_t, uint32_t);
+static int sys_ioring_setup_handler(uint32_t flags, uint32_t, uint32_t, uint32_t, uint32_t);
+static int sys_ioring_enter_handler(uint32_t ring, uint32_t n, uint32_t, uint32_t, uint32_t);
+static int sys_ioring_destroy_handler(uint32_t ring, uint32_t, uint32_t, uint32_t, uint32_t);
+static int sys_futex_handler(uint32_t addr, uint32_t op, uint32_t val, uint32_t timeout, uint32_t);
+static int sys_batch_handler(uint32_t reqs, uint32_t count, uint32_t flags, uint32_t, uint32_t);
+static int sys_pipe_handler(uint32_t fds, uint32_t, uint32_t, uint32_t, uint32_t);
+static int sys_shm_open_handler(uint32_t name, uint32_t size, uint32_t, uint32_t, uint32_t);
+static int sys_shm_close_handler(uint32_t id, uint32_t, uint32_t, uint32_t, uint32_t);
+static int sys_shm_map_handler(uint32_t id, uint32_t, uint32_t, uint32_t, uint32_t);
 
 /* System call table */
 static syscall_fn_t syscall_table[] = {
@@ -37,6 +60,9 @@ static syscall_fn_t syscall_table[] = {
     [SYS_READ]   = sys_read_handler,
     [SYS_OPEN]   = sys_open_handler,
     [SYS_CLOSE]  = sys_close_handler,
+    [SYS_FORK]   = sys_fork_handler,
+    [SYS_EXEC]   = sys_exec_handler,
+    [SYS_WAIT]   = sys_wait_handler,
     [SYS_GETPID] = sys_getpid_handler,
     [SYS_SLEEP]  = sys_sleep_handler,
     [SYS_TIME]   = sys_time_handler,
@@ -44,35 +70,196 @@ static syscall_fn_t syscall_table[] = {
     [SYS_FREE]   = sys_free_handler,
     [SYS_YIELD]  = sys_yield_handler,
     [SYS_KILL]   = sys_kill_handler,
+    [SYS_IORING_SETUP]   = sys_ioring_setup_handler,
+    [SYS_IORING_ENTER]   = sys_ioring_enter_handler,
+    [SYS_IORING_DESTROY] = sys_ioring_destroy_handler,
+    [SYS_FUTEX]          = sys_futex_handler,
+    [SYS_BATCH]          = sys_batch_handler,
+    [SYS_PIPE]           = sys_pipe_handler,
+    [SYS_SHM_OPEN]       = sys_shm_open_handler,
+    [SYS_SHM_CLOSE]      = sys_shm_close_handler,
+    [SYS_SHM_MAP]        = sys_shm_map_handler,
 };
 
 #define NUM_SYSCALLS (sizeof(syscall_table) / sizeof(syscall_table[0]))
 
-/* Syscall interrupt handler */
-static void syscall_isr(registers_t* regs) {
-    uint32_t syscall_num = regs->eax;
+static const char* const syscall_names[NUM_SYSCALLS] = {
+    [SYS_EXIT]   = "exit",
+    [SYS_WRITE]  = "write",
+    [SYS_READ]   = "read",
+    [SYS_OPEN]   = "open",
+    [SYS_CLOSE]  = "close",
+    [SYS_FORK]   = "fork",
+    [SYS_EXEC]   = "exec",
+    [SYS_WAIT]   = "wait",
+    [SYS_GETPID] = "getpid",
+    [SYS_SLEEP]  = "sleep",
+    [SYS_TIME]   = "time",
+    [SYS_MALLOC] = "malloc",
+    [SYS_FREE]   = "free",
+    [SYS_YIELD]  = "yield",
+    [SYS_KILL]   = "kill",
+    [SYS_IORING_SETUP]   = "ioring_setup",
+    [SYS_IORING_ENTER]   = "ioring_enter",
+    [SYS_IORING_DESTROY] = "ioring_destroy",
+    [SYS_FUTEX]          = "futex",
+    [SYS_BATCH]          = "batch",
+    [SYS_PIPE]           = "pipe",
+    [SYS_SHM_OPEN]       = "shm_open",
+    [SYS_SHM_CLOSE]      = "shm_close",
+    [SYS_SHM_MAP]        = "shm_map",
+};
+
+/*
+ * Per-CPU counters, [cpu * NUM_SYSCALLS + num], so dispatches on
+ * different CPUs never share a cache line. Allocated at init; NULL
+ * (nothing recorded) if that failed.
+ */
+static syscall_stats_t* syscall_stats = NULL;
+
+/* Charge one completed call to this CPU's counters */
+static void syscall_account(uint32_t num, int result, uint64_t cycles) {
+    uint32_t elapsed = cycles > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)cycles;
+    uint32_t bucket = elapsed ? 31 - __builtin_clz(elapsed) : 0;
+    
+    /* We may have slept and moved; count wherever we finished */
+    uint32_t flags = irq_save();
+    syscall_stats_t* st = &syscall_stats[smp_cpu_id() * NUM_SYSCALLS + num];
+    st->calls++;
+    if (result < 0) st->errors++;
+    st->cycles += cycles;
+    st->histogram[bucket]++;
+    irq_restore(flags);
+}
+
+/* Dispatch a system call by number */
+int syscall_dispatch(uint32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                     uint32_t arg4, uint32_t arg5) {
+    if (num >= NUM_SYSCALLS || !syscall_table[num]) {
+        return -1;  /* Invalid syscall */
+    }
+    
+    uint64_t start = rdtsc();
+    int result = syscall_table[num](arg1, arg2, arg3, arg4, arg5);
+    if (syscall_stats) {
+        syscall_account(num, result, rdtsc() - start);
+    }
+    return result;
+}
+
+/* ========== Statistics ========== */
+
+uint32_t syscall_count(void) {
+    return NUM_SYSCALLS;
+}
+
+const char* syscall_name(uint32_t num) {
+    return num < NUM_SYSCALLS ? syscall_names[num] : NULL;
+}
+
+/* Every CPU's counters for num added up; false if num is not a system call */
+bool syscall_get_stats(uint32_t num, syscall_stats_t* stats) {
+    if (num >= NUM_SYSCALLS || !syscall_table[num]) return false;
     
-    if (syscall_num >= NUM_SYSCALLS || !syscall_table[syscall_num]) {
-        regs->eax = -1;  /* Invalid syscall */
-        return;
+    memset(stats, 0, sizeof(syscall_stats_t));
+    if (!syscall_stats) return true;
+    
+    for (uint32_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        const syscall_stats_t* st = &syscall_stats[cpu * NUM_SYSCALLS + num];
+        stats->calls += st->calls;
+        stats->errors += st->errors;
+        stats->cycles += st->cycles;
+        for (uint32_t b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+            stats->histogram[b] += st->histogram[b];
+        }
     }
+    return true;
+}
+
+/* Zero every counter (calls in flight may still land in the new totals) */
+void syscall_stats_reset(void) {
+    if (!syscall_stats) return;
+    memset(syscall_stats, 0, SMP_MAX_CPUS * NUM_SYSCALLS * sizeof(syscall_stats_t));
+}
+
+/* SYSENTER works on this CPU model */
+static bool sysenter_ok = false;
+
+/* Entry point for SYSENTER (kernel/isr.asm) */
+extern void sysenter_entry(void);
+
+/* Syscall interrupt handler */
+static void syscall_isr(registers_t* regs) {
+    /* fork copies the caller's frame */
+    process_current()->syscall_frame = regs;
     
     /* Call handler with arguments from registers */
-    int ret = syscall_table[syscall_num](
+    regs->eax = syscall_dispatch(
+        regs->eax,  /* syscall number */
         regs->ebx,  /* arg1 */
         regs->ecx,  /* arg2 */
         regs->edx,  /* arg3 */
         regs->esi,  /* arg4 */
         regs->edi   /* arg5 */
     );
+}
+
+/*
+ * SYSENTER handler, called from sysenter_entry with a frame shaped like
+ * int 0x80's. arg2 and arg3 are fetched from the user stack into it, so
+ * from here on the two paths are the same, down to a forked child
+ * leaving through iret instead of SYSEXIT.
+ */
+void sysenter_handler(registers_t* regs) {
+    uint32_t acct = acct_enter(ACCT_KERNEL, true);
     
-    regs->eax = ret;
+    uint32_t args[2];
+    if (copy_from_user(args, (const void*)regs->useresp, sizeof(args)) < 0) {
+        regs->eax = -EFAULT;
+    } else {
+        regs->ecx = args[0];
+        regs->edx = args[1];
+        syscall_isr(regs);
+    }
+    
+    acct_exit(acct);
+    process_exit_if_killed(regs);
 }
 
 /* Initialize system calls */
 void syscall_init(void) {
     /* Register syscall interrupt handler (INT 0x80) */
     register_interrupt_handler(SYSCALL_INT, syscall_isr);
+    
+    syscall_stats = (syscall_stats_t*)kcalloc(SMP_MAX_CPUS * NUM_SYSCALLS, sizeof(syscall_stats_t));
+    
+    /* Family 6 before model 3 stepping 3 sets SEP without having it */
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    uint32_t family = (eax >> 8) & 0xF;
+    uint32_t model = (eax >> 4) & 0xF;
+    uint32_t stepping = eax & 0xF;
+    sysenter_ok = (edx & CPUID_EDX_SEP) &&
+                  !(family == 6 && model < 3 && stepping < 3);
+    syscall_init_cpu();
+}
+
+/*
+ * SYSENTER loads esp from an MSR and nothing else, so point it at this
+ * CPU's tss.esp0: the entry stub loads the real kernel stack from there,
+ * and the scheduler keeps it current as it would for an interrupt
+ */
+void syscall_init_cpu(void) {
+    if (!sysenter_ok) return;
+    
+    cpu_t* cpu = this_cpu();
+    wrmsr(MSR_SYSENTER_CS, GDT_KERNEL_CODE);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)&cpu->tss.esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+}
+
+bool syscall_fast_available(void) {
+    return sysenter_ok;
 }
 
 /* ========== System Call Implementations ========== */
@@ -83,37 +270,83 @@ static int sys_exit_handler(uint32_t code, uint32_t a2, uint32_t a3, uint32_t a4
     return 0;
 }
 
+/* Kernel stacks are small: user buffers pass through this much at a time */
+#define SYSCALL_CHUNK   128
+
+/* Copy a path argument in; 0, -EFAULT or -EINVAL if it is too long */
+static int path_from_user(char* path, uint32_t user_path) {
+    int length = strncpy_from_user(path, (const char*)user_path, USER_PATH_MAX);
+    if (length < 0) return length;
+    return length == USER_PATH_MAX ? -EINVAL : 0;
+}
+
 static int sys_write_handler(uint32_t fd, uint32_t buf, uint32_t count, uint32_t a4, uint32_t a5) {
     UNUSED(a4); UNUSED(a5);
     
-    if (fd == 1 || fd == 2) {  /* stdout or stderr */
-        const char* str = (const char*)buf;
-        for (uint32_t i = 0; i < count && str[i]; i++) {
-            vga_putchar(str[i]);
-        }
-        return count;
+    if (pipe_is_fd(fd)) {  /* Copies straight from the caller's buffer */
+        return pipe_write(fd, (const void*)buf, count);
     }
     
-    /* File write */
-    return fs_write(fd - 3, (void*)buf, count);
+    char chunk[SYSCALL_CHUNK];
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t size = MIN(count - done, SYSCALL_CHUNK);
+        if (copy_from_user(chunk, (const char*)buf + done, size) < 0) {
+            return done ? (int)done : -EFAULT;
+        }
+        
+        if (fd == 1 || fd == 2) {  /* stdout or stderr, up to a NUL */
+            for (uint32_t i = 0; i < size; i++) {
+                if (!chunk[i]) return count;
+                vga_putchar(chunk[i]);
+            }
+            done += size;
+            continue;
+        }
+        
+        /* File write */
+        int written = fs_write(fd - 3, chunk, size);
+        if (written < 0) return done ? (int)done : written;
+        done += written;
+        if ((uint32_t)written < size) break;
+    }
+    return done;
 }
 
 static int sys_read_handler(uint32_t fd, uint32_t buf, uint32_t count, uint32_t a4, uint32_t a5) {
     UNUSED(a4); UNUSED(a5);
     
+    if (pipe_is_fd(fd)) {
+        return pipe_read(fd, (void*)buf, count);
+    }
+    
     if (fd == 0) {  /* stdin */
         /* Would read from keyboard buffer */
         return 0;
     }
     
     /* File read */
-    return fs_read(fd - 3, (void*)buf, count);
+    char chunk[SYSCALL_CHUNK];
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t size = MIN(count - done, SYSCALL_CHUNK);
+        int got = fs_read(fd - 3, chunk, size);
+        if (got < 0) return done ? (int)done : got;
+        if (got > 0 && copy_to_user((char*)buf + done, chunk, got) < 0) return -EFAULT;
+        done += got;
+        if ((uint32_t)got < size) break;
+    }
+    return done;
 }
 
 static int sys_open_handler(uint32_t path, uint32_t flags, uint32_t a3, uint32_t a4, uint32_t a5) {
     UNUSED(a3); UNUSED(a4); UNUSED(a5);
     
-    int handle = fs_open((const char*)path, flags);
+    char name[USER_PATH_MAX];
+    int result = path_from_user(name, path);
+    if (result < 0) return result;
+    
+    int handle = fs_open(name, flags);
     if (handle >= 0) {
         return handle + 3;  /* Offset by stdin/stdout/stderr */
     }
@@ -124,11 +357,38 @@ static int sys_close_handler(uint32_t fd, uint32_t a2, uint32_t a3, uint32_t a4,
     UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
     
     if (fd <= 2) return -1;  /* Can't close std streams */
+    if (pipe_is_fd(fd)) return pipe_close(fd);
     
     fs_close(fd - 3);
     return 0;
 }
 
+static int sys_fork_handler(uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a1); UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    return process_fork(process_current()->syscall_frame);
+}
+
+/* argv is read from the caller's memory by process_exec itself */
+static int sys_exec_handler(uint32_t path, uint32_t argv, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    
+    char name[USER_PATH_MAX];
+    int result = path_from_user(name, path);
+    if (result < 0) return result;
+    return process_exec(name, (char* const*)argv);
+}
+
+static int sys_wait_handler(uint32_t status, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    
+    int code = 0;
+    int pid = process_wait(-1, &code);
+    if (pid >= 0 && status && copy_to_user((int*)status, &code, sizeof(code)) < 0) {
+        return -EFAULT;
+    }
+    return pid;
+}
+
 static int sys_getpid_handler(uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
     UNUSED(a1); UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
     return process_getpid();
@@ -145,13 +405,19 @@ static int sys_time_handler(uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4,
     return timer_get_seconds();
 }
 
+/*
+ * The kernel heap is supervisor-only and kfree trusts its pointer, so
+ * only kernel threads may use it; programs manage their own memory
+ */
 static int sys_malloc_handler(uint32_t size, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
     UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    if (process_current()->mm) return 0;        /* NULL */
     return (int)kmalloc(size);
 }
 
 static int sys_free_handler(uint32_t ptr, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
     UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    if (process_current()->mm) return -EINVAL;
     kfree((void*)ptr);
     return 0;
 }
@@ -167,6 +433,105 @@ static int sys_kill_handler(uint32_t pid, uint32_t sig, uint32_t a3, uint32_t a4
     return process_kill(pid);
 }
 
+static int sys_ioring_setup_handler(uint32_t flags, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    return (int)ioring_setup(flags);
+}
+
+static int sys_ioring_enter_handler(uint32_t ring, uint32_t n, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    return ioring_enter((io_ring_t*)ring, n);
+}
+
+static int sys_ioring_destroy_handler(uint32_t ring, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    return ioring_destroy((io_ring_t*)ring);
+}
+
+static int sys_futex_handler(uint32_t addr, uint32_t op, uint32_t val, uint32_t timeout, uint32_t a5) {
+    UNUSED(a5);
+    
+    if (!access_ok((const void*)addr, sizeof(uint32_t))) return -EFAULT;
+    
+    switch (op) {
+        case FUTEX_WAIT:
+            return futex_wait((volatile uint32_t*)addr, val, timeout);
+        case FUTEX_WAKE:
+            return futex_wake((volatile uint32_t*)addr, val);
+        default:
+            return -EINVAL;
+    }
+}
+
+/*
+ * Each record goes through syscall_dispatch as if trapped on its own.
+ * fork is refused, since the child would resume from the batch's trap
+ * with the rest of the batch undone, and so is a nested batch.
+ */
+static int sys_batch_handler(uint32_t reqs, uint32_t count, uint32_t flags, uint32_t a4, uint32_t a5) {
+    UNUSED(a4); UNUSED(a5);
+    
+    if (count > BATCH_MAX || (flags & ~BATCH_STOP_ON_ERROR)) return -EINVAL;
+    
+    syscall_req_t* user_req = (syscall_req_t*)reqs;
+    uint32_t done = 0;
+    while (done < count) {
+        syscall_req_t req;
+        if (copy_from_user(&req, user_req, sizeof(req)) < 0) return done ? (int)done : -EFAULT;
+        
+        int result;
+        if (req.num == SYS_FORK || req.num == SYS_BATCH) {
+            result = -EINVAL;
+        } else {
+            result = syscall_dispatch(req.num, req.args[0], req.args[1], req.args[2],
+                                      req.args[3], req.args[4]);
+        }
+        if (copy_to_user(&user_req->result, &result, sizeof(result)) < 0) return -EFAULT;
+        user_req++;
+        done++;
+        
+        if (result < 0 && (flags & BATCH_STOP_ON_ERROR)) break;
+    }
+    return done;
+}
+
+/* ========== Pipes and Shared Memory ========== */
+
+static int sys_pipe_handler(uint32_t fds, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    
+    int pair[2];
+    int result = pipe_create(pair);
+    if (result < 0) return result;
+    
+    if (copy_to_user((int*)fds, pair, sizeof(pair)) < 0) {
+        pipe_close(pair[0]);
+        pipe_close(pair[1]);
+        return -EFAULT;
+    }
+    return 0;
+}
+
+static int sys_shm_open_handler(uint32_t name, uint32_t size, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    
+    char segment[SHM_NAME_MAX];
+    int length = strncpy_from_user(segment, (const char*)name, SHM_NAME_MAX);
+    if (length < 0) return length;
+    if (length == SHM_NAME_MAX) return -EINVAL;
+    return shm_open(segment, size);
+}
+
+static int sys_shm_close_handler(uint32_t id, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    return shm_close((int)id);
+}
+
+static int sys_shm_map_handler(uint32_t id, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+    UNUSED(a2); UNUSED(a3); UNUSED(a4); UNUSED(a5);
+    return shm_map((int)id);
+}
+
 /* Public syscall wrappers */
 void sys_exit(int code) {
     syscall1(SYS_EXIT, code);
@@ -188,8 +553,21 @@ int sys_close(int fd) {
     return syscall1(SYS_CLOSE, fd);
 }
 
+int sys_fork(void) {
+    return syscall0(SYS_FORK);
+}
+
+int sys_exec(const char* path, char* const argv[]) {
+    return syscall2(SYS_EXEC, (uint32_t)path, (uint32_t)argv);
+}
+
+int sys_wait(int* status) {
+    return syscall1(SYS_WAIT, (uint32_t)status);
+}
+
+/* Read from the vDSO page: no trap */
 uint32_t sys_getpid(void) {
-    return syscall0(SYS_GETPID);
+    return vdso_getpid();
 }
 
 void sys_sleep(uint32_t ms) {
@@ -197,7 +575,9 @@ void sys_sleep(uint32_t ms) {
 }
 
 uint32_t sys_time(void) {
-    return syscall0(SYS_TIME);
+    vdso_clock_t clock;
+    vdso_read_clock(&clock);
+    return clock.ticks / clock.tick_hz;
 }
 
 void* sys_malloc(uint32_t size) {
@@ -215,3 +595,40 @@ void sys_yield(void) {
 int sys_kill(uint32_t pid, int signal) {
     return syscall2(SYS_KILL, pid, signal);
 }
+
+io_ring_t* sys_ioring_setup(uint32_t flags) {
+    return (io_ring_t*)syscall1(SYS_IORING_SETUP, flags);
+}
+
+int sys_ioring_enter(io_ring_t* ring, uint32_t to_submit) {
+    return syscall2(SYS_IORING_ENTER, (uint32_t)ring, to_submit);
+}
+
+int sys_ioring_destroy(io_ring_t* ring) {
+    return syscall1(SYS_IORING_DESTROY, (uint32_t)ring);
+}
+
+int sys_futex(volatile uint32_t* addr, uint32_t op, uint32_t val, uint32_t timeout_ms) {
+    return syscall4(SYS_FUTEX, (uint32_t)addr, op, val, timeout_ms);
+}
+
+int sys_batch(syscall_req_t* reqs, uint32_t count, uint32_t flags) {
+    return syscall3(SYS_BATCH, (uint32_t)reqs, count, flags);
+}
+
+int sys_pipe(int fds[2]) {
+    return syscall1(SYS_PIPE, (uint32_t)fds);
+}
+
+int sys_shm_open(const char* name, uint32_t size) {
+    return syscall2(SYS_SHM_OPEN, (uint32_t)name, size);
+}
+
+int sys_shm_close(int id) {
+    return syscall1(SYS_SHM_CLOSE, id);
+}
+
+void* sys_shm_map(int id) {
+    int addr = syscall1(SYS_SHM_MAP, id);
+    return addr < 0 ? NULL : (void*)addr;
+}
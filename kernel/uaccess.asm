@@ -0,0 +1,100 @@
+; NightOS - User Memory Access (Assembly)
+; The only instructions that touch memory a program handed us. Each
+; one that may fault has an entry in uaccess_ex_table: the page fault
+; handler resumes at its fixup, which reports how far the copy got.
+
+[BITS 32]
+
+; Handle MinGW naming convention (underscore prefix for C symbols)
+%ifdef MINGW
+global _uaccess_copy, _uaccess_strncpy
+global _uaccess_ex_table, _uaccess_ex_table_end
+%define uaccess_copy _uaccess_copy
+%define uaccess_strncpy _uaccess_strncpy
+%define uaccess_ex_table _uaccess_ex_table
+%define uaccess_ex_table_end _uaccess_ex_table_end
+%else
+global uaccess_copy, uaccess_strncpy
+global uaccess_ex_table, uaccess_ex_table_end
+%endif
+
+; ============================================
+; uint32_t uaccess_copy(void* dst, const void* src, uint32_t size)
+;
+; rep movsd for the bulk, rep movsb for the tail. Returns the number
+; of bytes not copied: 0, or what was left when a page fault stopped
+; it (ecx still counts the remainder then).
+; ============================================
+uaccess_copy:
+    push esi
+    push edi
+    mov edi, [esp + 12]         ; dst
+    mov esi, [esp + 16]         ; src
+    mov edx, [esp + 20]         ; size
+    cld
+    mov ecx, edx
+    shr ecx, 2
+copy_dwords:
+    rep movsd
+    mov ecx, edx
+    and ecx, 3
+copy_bytes:
+    rep movsb
+    xor eax, eax
+copy_done:
+    pop edi
+    pop esi
+    ret
+
+copy_dwords_fault:
+    and edx, 3                  ; The tail was never started
+    lea eax, [edx + ecx * 4]
+    jmp copy_done
+
+copy_bytes_fault:
+    mov eax, ecx
+    jmp copy_done
+
+; ============================================
+; int uaccess_strncpy(char* dst, const char* src, uint32_t size)
+;
+; Copies up to size bytes, stopping after a NUL. Returns the string's
+; length, size if there was no NUL in range, or -1 on a fault.
+; ============================================
+uaccess_strncpy:
+    push esi
+    push edi
+    mov edi, [esp + 12]         ; dst
+    mov esi, [esp + 16]         ; src
+    mov ecx, [esp + 20]         ; size
+    xor edx, edx
+strncpy_loop:
+    cmp edx, ecx
+    jae strncpy_done
+strncpy_load:
+    mov al, [esi + edx]
+    mov [edi + edx], al
+    test al, al
+    jz strncpy_done
+    inc edx
+    jmp strncpy_loop
+strncpy_done:
+    mov eax, edx
+strncpy_out:
+    pop edi
+    pop esi
+    ret
+
+strncpy_fault:
+    mov eax, -1
+    jmp strncpy_out
+
+; ============================================
+; Exception table: faulting instruction, where to resume
+; ============================================
+align 4
+uaccess_ex_table:
+    dd copy_dwords, copy_dwords_fault
+    dd copy_bytes, copy_bytes_fault
+    dd strncpy_load, strncpy_fault
+uaccess_ex_table_end:
@@ -0,0 +1,69 @@
+/*
+ * NightOS - User Memory Access Implementation
+ * 
+ * The copies themselves are in kernel/uaccess.asm, next to the table
+ * of their faulting instructions.
+ */
+
+#include "../include/uaccess.h"
+#include "../include/process.h"
+#include "../include/paging.h"
+#include "../include/errno.h"
+
+/* An instruction that may fault on a program's pointer, and where to go if it does */
+typedef struct {
+    uint32_t insn;
+    uint32_t fixup;
+} uaccess_entry_t;
+
+/* kernel/uaccess.asm */
+extern uint32_t uaccess_copy(void* dst, const void* src, uint32_t size);
+extern int uaccess_strncpy(char* dst, const char* src, uint32_t size);
+extern const uaccess_entry_t uaccess_ex_table[];
+extern const uaccess_entry_t uaccess_ex_table_end[];
+
+bool access_ok(const void* addr, uint32_t size) {
+    process_t* proc = process_current();
+    if (!proc || !proc->mm) return true;
+    
+    uint32_t start = (uint32_t)addr;
+    return start >= USER_BASE && start <= USER_TOP && size <= USER_TOP - start;
+}
+
+int copy_from_user(void* dst, const void* src, uint32_t size) {
+    if (!access_ok(src, size)) return -EFAULT;
+    return uaccess_copy(dst, src, size) ? -EFAULT : 0;
+}
+
+int copy_to_user(void* dst, const void* src, uint32_t size) {
+    if (!access_ok(dst, size)) return -EFAULT;
+    return uaccess_copy(dst, src, size) ? -EFAULT : 0;
+}
+
+int strncpy_from_user(char* dst, const char* src, uint32_t size) {
+    if (!access_ok(src, 1)) return -EFAULT;
+    
+    /* The string may end anywhere; only its first byte was checked */
+    uint32_t limit = size;
+    process_t* proc = process_current();
+    if (proc && proc->mm && limit > USER_TOP - (uint32_t)src) {
+        limit = USER_TOP - (uint32_t)src;
+    }
+    
+    int length = uaccess_strncpy(dst, src, limit);
+    if (length < 0) return -EFAULT;
+    return (uint32_t)length == limit ? (int)size : length;
+}
+
+/* Page fault in one of the copy routines: resume at its fixup; false if not ours */
+bool uaccess_fixup(registers_t* regs) {
+    if (regs->cs & 3) return false;
+    
+    for (const uaccess_entry_t* entry = uaccess_ex_table; entry < uaccess_ex_table_end; entry++) {
+        if (entry->insn == regs->eip) {
+            regs->eip = entry->fixup;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,101 @@
+; NightOS - Built-in Programs (Assembly)
+; Position-independent ring 3 code that the kernel copies into a fresh
+; address space with process_exec_code, for measurements that have to
+; start from user mode
+
+[BITS 32]
+
+SYS_GETPID      equ 5               ; Must match syscall.h
+SYSBENCH_CALLS  equ 10000
+
+; Handle MinGW naming convention (underscore prefix for C symbols)
+%ifdef MINGW
+global _sysbench_start
+global _sysbench_end
+%define sysbench_start _sysbench_start
+%define sysbench_end _sysbench_end
+%else
+global sysbench_start
+global sysbench_end
+%endif
+
+; ============================================
+; int sysbench(int argc, char* argv[])
+;
+; Times SYSBENCH_CALLS getpid round trips through int 0x80, then as
+; many through SYSENTER if argc > 1 (the shell passes an extra
+; argument when the CPU has it). Exits with the average cycles per
+; call of each, clamped to 16 bits: (int 0x80 << 16) | SYSENTER.
+; ============================================
+sysbench_start:
+    push ebp
+    push ebx
+    push esi
+    push edi
+
+    ; Nothing here may depend on where it was loaded
+    call .base
+.base:
+    pop ebp
+
+    ; int 0x80 keeps every register but eax
+    mov ebx, SYSBENCH_CALLS
+    rdtsc
+    mov esi, eax
+    mov edi, edx
+.int80_loop:
+    mov eax, SYS_GETPID
+    int 0x80
+    dec ebx
+    jnz .int80_loop
+    call .average
+    push eax
+
+    xor eax, eax
+    cmp dword [esp + 24], 1     ; argc, past the saved registers and result
+    jle .done
+
+    ; SYSENTER as sysenter3 makes it: arg2 and arg3 on the stack, ecx
+    ; pointing at them, edx holding the return address
+    mov ebx, SYSBENCH_CALLS
+    rdtsc
+    mov esi, eax
+    mov edi, edx
+.sysenter_loop:
+    mov eax, SYS_GETPID
+    lea edx, [ebp + .sysenter_ret - .base]
+    push edx
+    push ecx
+    mov ecx, esp
+    sysenter
+.sysenter_ret:
+    add esp, 8
+    dec ebx
+    jnz .sysenter_loop
+    call .average
+
+.done:
+    pop ecx
+    shl ecx, 16
+    or eax, ecx
+
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
+; Cycles since edi:esi over SYSBENCH_CALLS, at most 0xFFFF, in eax
+.average:
+    rdtsc
+    sub eax, esi
+    sbb edx, edi
+    mov ecx, SYSBENCH_CALLS
+    div ecx
+    cmp eax, 0xFFFF
+    jbe .fits
+    mov eax, 0xFFFF
+.fits:
+    ret
+
+sysbench_end:
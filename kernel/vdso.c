@@ -0,0 +1,54 @@
+/*
+ * NightOS - vDSO Data Page Implementation
+ * 
+ * The page is an ordinary pool frame that every address space maps
+ * read-only (see mm_map_vdso) and the kernel writes through its
+ * identity mapping. The clock has a single writer, the BSP's tick, so
+ * a bare sequence count is enough to let readers spot a torn copy.
+ * The per-CPU PID slots are written only by their own CPU while it
+ * switches, with interrupts off.
+ */
+
+#include "../include/vdso.h"
+#include "../include/vmm.h"
+#include "../include/timer.h"
+#include "../include/string.h"
+
+static vdso_data_t* vdso = NULL;
+static uint32_t vdso_page = 0;
+
+/* Allocate and clear the page (after vmm_init) */
+void vdso_init(void) {
+    vdso_page = frame_alloc();          /* Held by the kernel for good */
+    if (!vdso_page) return;
+    
+    memset((void*)vdso_page, 0, PAGE_SIZE);
+    vdso = (vdso_data_t*)vdso_page;
+    vdso->tick_hz = TIMER_FREQUENCY;
+}
+
+uint32_t vdso_frame(void) {
+    return vdso_page;
+}
+
+/* Publish a tick (BSP only, so the sequence needs no writer lock) */
+void vdso_tick(uint32_t ticks, uint64_t tsc, uint32_t tsc_per_tick) {
+    if (!vdso) return;
+    
+    vdso->sequence++;
+    __asm__ volatile("" : : : "memory");
+    vdso->ticks = ticks;
+    vdso->tsc_per_tick = tsc_per_tick;
+    vdso->tick_tsc = tsc;
+    __asm__ volatile("" : : : "memory");
+    vdso->sequence++;
+}
+
+/* Publish the process this CPU is about to run */
+void vdso_switch(uint32_t cpu, uint32_t pid) {
+    if (!vdso) return;
+    
+    vdso->cpus[cpu].switches++;
+    __asm__ volatile("" : : : "memory");
+    vdso->cpus[cpu].pid = pid;
+}
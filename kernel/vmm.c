@@ -0,0 +1,511 @@
+/*
+ * NightOS - Virtual Memory Implementation
+ * 
+ * A program's page directory is a copy of the kernel's with a private
+ * user region. Nothing there is mapped until it is touched: the page
+ * fault handler finds the area covering the address and fills a fresh
+ * frame with zeroes and whatever part of the executable belongs there.
+ * fork shares every frame, turning writable pages read-only and marking
+ * them PAGE_COW; the first write to one copies it, or simply makes it
+ * writable again once nobody else holds the frame. Only the owning
+ * process changes its address space, and a CPU reloads CR3 whenever it
+ * switches to another one, so no TLB shootdowns are ever needed.
+ */
+
+#include "../include/vmm.h"
+#include "../include/elf.h"
+#include "../include/config.h"
+#include "../include/errno.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+#include "../include/process.h"
+#include "../include/sync.h"
+#include "../include/vga.h"
+#include "../include/vdso.h"
+#include "../include/uaccess.h"
+#include "../include/shm.h"
+
+#define FRAME_COUNT         (FRAME_POOL_SIZE / PAGE_SIZE)
+#define FRAME_INDEX(f)      (((f) - FRAME_POOL_BASE) / PAGE_SIZE)
+
+#define USER_PDE_FIRST      PAGE_DIR_INDEX(USER_BASE)
+#define USER_PDE_END        PAGE_DIR_INDEX(USER_TOP)
+
+/* Page fault error code bits */
+#define PF_PRESENT          0x01        /* Protection fault, else page not present */
+#define PF_WRITE            0x02
+
+#define EFLAGS_IF           0x200
+
+/* Reference counts of pool frames; free ones are stacked by index */
+static uint16_t frame_refs[FRAME_COUNT];
+static uint16_t free_frames[FRAME_COUNT];
+static uint32_t free_count = 0;
+static uint32_t shared_frames = 0;
+static spinlock_t frame_lock;
+
+/* Address spaces waiting for mm_create to destroy them */
+static mm_t* dead_mms = NULL;
+static spinlock_t dead_lock;
+
+/* ========== Frames ========== */
+
+/* Set up the frame pool (paging must be on) */
+void vmm_init(void) {
+    spin_lock_init(&frame_lock, "frames");
+    spin_lock_init(&dead_lock, "dead mms");
+    memset(frame_refs, 0, sizeof(frame_refs));
+    
+    /* Lowest frames on top of the stack */
+    for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+        free_frames[i] = (uint16_t)(FRAME_COUNT - 1 - i);
+    }
+    free_count = FRAME_COUNT;
+    shared_frames = 0;
+}
+
+/* A frame with one reference, or 0 when the pool is exhausted */
+uint32_t frame_alloc(void) {
+    uint32_t frame = 0;
+    
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    if (free_count) {
+        uint32_t index = free_frames[--free_count];
+        frame_refs[index] = 1;
+        frame = FRAME_POOL_BASE + index * PAGE_SIZE;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return frame;
+}
+
+void frame_get(uint32_t frame) {
+    uint32_t index = FRAME_INDEX(frame);
+    
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    if (frame_refs[index]++ == 1) shared_frames++;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/* Drop a reference; the frame is free again after the last */
+void frame_put(uint32_t frame) {
+    uint32_t index = FRAME_INDEX(frame);
+    
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    uint32_t refs = --frame_refs[index];
+    if (refs == 1) {
+        shared_frames--;
+    } else if (refs == 0) {
+        free_frames[free_count++] = (uint16_t)index;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * True if a frame might be held elsewhere. Only a holder can add
+ * references (by forking or lending the page to a pipe), so a frame we
+ * hold alone stays ours.
+ */
+static inline bool frame_shared(uint32_t frame) {
+    return frame_refs[FRAME_INDEX(frame)] > 1;
+}
+
+void frame_get_stats(frame_stats_t* stats) {
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    stats->total = FRAME_COUNT;
+    stats->free = free_count;
+    stats->shared = shared_frames;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/* ========== Page Tables ========== */
+
+/* Entry mapping vaddr in mm, allocating its page table if asked */
+static uint32_t* mm_pte(mm_t* mm, uint32_t vaddr, bool create) {
+    uint32_t* pde = &mm->directory[PAGE_DIR_INDEX(vaddr)];
+    
+    if (!(*pde & PAGE_PRESENT)) {
+        if (!create) return NULL;
+        
+        uint32_t table = frame_alloc();
+        if (!table) return NULL;
+        memset((void*)table, 0, PAGE_SIZE);
+        *pde = table | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
+    }
+    
+    uint32_t* table = (uint32_t*)(*pde & PAGE_FRAME_MASK);
+    return &table[PAGE_TABLE_INDEX(vaddr)];
+}
+
+/* Replace a present entry, dropping its TLB entry if mm is loaded here */
+static void mm_set_pte(mm_t* mm, uint32_t* pte, uint32_t vaddr, uint32_t value) {
+    *pte = value;
+    if (read_cr3() == (uint32_t)mm->directory) {
+        invlpg(vaddr);
+    }
+}
+
+/* Entry bits for a page of an area */
+static inline uint32_t area_pte_flags(const vm_area_t* area) {
+    return PAGE_PRESENT | PAGE_USER | ((area->flags & VMA_WRITE) ? PAGE_WRITE : 0);
+}
+
+/* Back a page with a new frame: zeroes plus any bytes from the file */
+static int fill_page(mm_t* mm, vm_area_t* area, uint32_t page) {
+    uint32_t frame;
+    if (area->flags & VMA_VDSO) {
+        /* Read-only, so never copied on write */
+        frame = vdso_frame();
+        if (!frame) return -ENOMEM;
+        frame_get(frame);
+    } else if (area->flags & VMA_SHM) {
+        /* The segment's own page, which every mapping writes in place */
+        frame = shm_frame(area->shm, (page - area->start) / PAGE_SIZE);
+        frame_get(frame);
+    } else if (area->flags & VMA_PINNED) {
+        /* Mapped up front by mm_map_frame; there is nothing to fill it with */
+        return -EFAULT;
+    } else {
+        frame = frame_alloc();
+        if (!frame) return -ENOMEM;
+        memset((void*)frame, 0, PAGE_SIZE);
+    }
+    
+    if (area->image) {
+        uint32_t from = MAX(page, area->file_vaddr);
+        uint32_t to = MIN(page + PAGE_SIZE, area->file_vaddr + area->file_size);
+        if (from < to) {
+            int read = image_read(area->image, area->file_offset + (from - area->file_vaddr),
+                                  (uint8_t*)frame + (from - page), to - from);
+            if (read < 0) {
+                frame_put(frame);
+                return read;
+            }
+        }
+    }
+    
+    uint32_t* pte = mm_pte(mm, page, true);
+    if (!pte) {
+        frame_put(frame);
+        return -ENOMEM;
+    }
+    *pte = frame | area_pte_flags(area);
+    mm->resident++;
+    mm->faults++;
+    return 0;
+}
+
+/* First write to a shared page: copy it, or take it over if it is ours alone */
+static int cow_break(mm_t* mm, uint32_t* pte, uint32_t page) {
+    uint32_t frame = *pte & PAGE_FRAME_MASK;
+    uint32_t bits = (*pte & ~(PAGE_FRAME_MASK | PAGE_COW)) | PAGE_WRITE;
+    
+    if (!frame_shared(frame)) {
+        mm_set_pte(mm, pte, page, frame | bits);
+        return 0;
+    }
+    
+    uint32_t copy = frame_alloc();
+    if (!copy) return -ENOMEM;
+    memcpy((void*)copy, (void*)frame, PAGE_SIZE);
+    mm_set_pte(mm, pte, page, copy | bits);
+    frame_put(frame);
+    mm->cow_copies++;
+    return 0;
+}
+
+/* Writable frame behind a page of mm, filling or unsharing it first; 0 on failure */
+static uint32_t mm_writable_frame(mm_t* mm, uint32_t page) {
+    vm_area_t* area = mm_find_area(mm, page);
+    if (!area || !(area->flags & VMA_WRITE)) return 0;
+    
+    uint32_t* pte = mm_pte(mm, page, false);
+    if (!pte || !(*pte & PAGE_PRESENT)) {
+        if (fill_page(mm, area, page) < 0) return 0;
+        pte = mm_pte(mm, page, false);
+    } else if (*pte & PAGE_COW) {
+        if (cow_break(mm, pte, page) < 0) return 0;
+    }
+    return *pte & PAGE_FRAME_MASK;
+}
+
+/* ========== Address Spaces ========== */
+
+/* Destroy the address spaces handed to mm_destroy_later (process context) */
+static void mm_reap_dead(void) {
+    uint32_t flags = spin_lock_irqsave(&dead_lock);
+    mm_t* list = dead_mms;
+    dead_mms = NULL;
+    spin_unlock_irqrestore(&dead_lock, flags);
+    
+    while (list) {
+        mm_t* next = list->dead_next;
+        mm_destroy(list);
+        list = next;
+    }
+}
+
+/* An empty user region over the kernel mappings, or NULL */
+mm_t* mm_create(void) {
+    /* Their frames may be what we are about to need */
+    mm_reap_dead();
+    
+    mm_t* mm = (mm_t*)kcalloc(1, sizeof(mm_t));
+    if (!mm) return NULL;
+    
+    uint32_t directory = frame_alloc();
+    if (!directory) {
+        kfree(mm);
+        return NULL;
+    }
+    
+    /* Kernel entries never change after boot, so a copy stays in step */
+    mm->directory = (uint32_t*)directory;
+    memcpy(mm->directory, (const void*)paging_kernel_directory(), PAGE_SIZE);
+    for (uint32_t i = USER_PDE_FIRST; i < USER_PDE_END; i++) {
+        mm->directory[i] = 0;
+    }
+    return mm;
+}
+
+/* Free everything; mm must not be loaded on any CPU */
+void mm_destroy(mm_t* mm) {
+    for (uint32_t i = USER_PDE_FIRST; i < USER_PDE_END; i++) {
+        uint32_t pde = mm->directory[i];
+        if (!(pde & PAGE_PRESENT)) continue;
+        
+        uint32_t* table = (uint32_t*)(pde & PAGE_FRAME_MASK);
+        for (uint32_t j = 0; j < PAGE_TABLE_ENTRIES; j++) {
+            if (table[j] & PAGE_PRESENT) {
+                frame_put(table[j] & PAGE_FRAME_MASK);
+            }
+        }
+        frame_put((uint32_t)table);
+    }
+    frame_put((uint32_t)mm->directory);
+    
+    while (mm->areas) {
+        vm_area_t* area = mm->areas;
+        mm->areas = area->next;
+        if (area->image) image_put(area->image);
+        if (area->shm) shm_put(area->shm);
+        kfree(area);
+    }
+    kfree(mm);
+}
+
+/* Queue mm for the next mm_create to destroy; safe under spinlocks */
+void mm_destroy_later(mm_t* mm) {
+    uint32_t flags = spin_lock_irqsave(&dead_lock);
+    mm->dead_next = dead_mms;
+    dead_mms = mm;
+    spin_unlock_irqrestore(&dead_lock, flags);
+}
+
+/* Add a copy of area (taking image and segment references); fails if it overlaps */
+int mm_add_area(mm_t* mm, const vm_area_t* area) {
+    if (area->start >= area->end || area->start < USER_BASE || area->end > USER_TOP ||
+        ((area->start | area->end) & ~PAGE_FRAME_MASK)) {
+        return -EINVAL;
+    }
+    
+    vm_area_t** link = &mm->areas;
+    while (*link && (*link)->end <= area->start) {
+        link = &(*link)->next;
+    }
+    if (*link && (*link)->start < area->end) return -EINVAL;
+    
+    vm_area_t* copy = (vm_area_t*)kmalloc(sizeof(vm_area_t));
+    if (!copy) return -ENOMEM;
+    *copy = *area;
+    copy->next = *link;
+    *link = copy;
+    
+    if (copy->image) image_get(copy->image);
+    if (copy->shm) shm_get(copy->shm);
+    return 0;
+}
+
+vm_area_t* mm_find_area(mm_t* mm, uint32_t addr) {
+    for (vm_area_t* area = mm->areas; area && area->start <= addr; area = area->next) {
+        if (addr < area->end) return area;
+    }
+    return NULL;
+}
+
+/* Lowest free run of size bytes at or above from, below the vDSO; 0 if none */
+uint32_t mm_find_gap(mm_t* mm, uint32_t from, uint32_t size) {
+    uint32_t addr = from;
+    for (vm_area_t* area = mm->areas; area; area = area->next) {
+        if (area->end <= addr) continue;
+        if (area->start >= addr + size) break;
+        addr = area->end;
+    }
+    return (addr + size <= VDSO_ADDR && addr + size > addr) ? addr : 0;
+}
+
+/* Map the vDSO page read-only at VDSO_ADDR, now rather than on first touch */
+int mm_map_vdso(mm_t* mm) {
+    vm_area_t area;
+    memset(&area, 0, sizeof(area));
+    area.start = VDSO_ADDR;
+    area.end = VDSO_ADDR + PAGE_SIZE;
+    area.flags = VMA_READ | VMA_VDSO;
+    
+    int result = mm_add_area(mm, &area);
+    if (result < 0) return result;
+    return fill_page(mm, mm_find_area(mm, VDSO_ADDR), VDSO_ADDR);
+}
+
+/* Map a frame the kernel shares with the program at page */
+int mm_map_frame(mm_t* mm, uint32_t page, uint32_t frame) {
+    vm_area_t area;
+    memset(&area, 0, sizeof(area));
+    area.start = page;
+    area.end = page + PAGE_SIZE;
+    area.flags = VMA_READ | VMA_WRITE | VMA_PINNED;
+    
+    int result = mm_add_area(mm, &area);
+    if (result < 0) return result;
+    
+    uint32_t* pte = mm_pte(mm, page, true);
+    if (!pte) return -ENOMEM;
+    frame_get(frame);
+    *pte = frame | area_pte_flags(&area);
+    mm->resident++;
+    return 0;
+}
+
+/* Copy into mm's memory; it need not be the loaded address space */
+int mm_copy_out(mm_t* mm, uint32_t dst, const void* src, uint32_t size) {
+    const uint8_t* from = (const uint8_t*)src;
+    
+    while (size) {
+        uint32_t page = dst & PAGE_FRAME_MASK;
+        uint32_t offset = dst - page;
+        uint32_t chunk = MIN(size, PAGE_SIZE - offset);
+        
+        /* Through the frame's identity mapping, not dst */
+        uint32_t frame = mm_writable_frame(mm, page);
+        if (!frame) return -EINVAL;
+        memcpy((uint8_t*)frame + offset, from, chunk);
+        
+        dst += chunk;
+        from += chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+/* Lend the frame behind a page to the kernel, making the page copy-on-write */
+uint32_t mm_lend_page(mm_t* mm, uint32_t page) {
+    vm_area_t* area = mm_find_area(mm, page);
+    if (!area || (area->flags & (VMA_SHM | VMA_PINNED))) return 0;
+    
+    uint32_t* pte = mm_pte(mm, page, false);
+    if (!pte || !(*pte & PAGE_PRESENT)) {
+        if (fill_page(mm, area, page) < 0) return 0;
+        pte = mm_pte(mm, page, false);
+    }
+    
+    /* Our next write copies the page instead of changing the frame */
+    if (*pte & PAGE_WRITE) {
+        mm_set_pte(mm, pte, page, (*pte & ~PAGE_WRITE) | PAGE_COW);
+    }
+    uint32_t frame = *pte & PAGE_FRAME_MASK;
+    frame_get(frame);
+    return frame;
+}
+
+/* Copy-on-write duplicate of the calling process's address space */
+mm_t* mm_clone(mm_t* parent) {
+    mm_t* child = mm_create();
+    if (!child) return NULL;
+    
+    bool ok = true;
+    for (vm_area_t* area = parent->areas; area && ok; area = area->next) {
+        if (mm_add_area(child, area) < 0) {
+            ok = false;
+            break;
+        }
+        
+        for (uint32_t page = area->start; page < area->end; page += PAGE_SIZE) {
+            uint32_t* pte = mm_pte(parent, page, false);
+            if (!pte) {
+                /* No table: skip to the next 4MB */
+                page |= PAGE_LARGE_SIZE - PAGE_SIZE;
+                continue;
+            }
+            if (!(*pte & PAGE_PRESENT)) continue;
+            
+            uint32_t* child_pte = mm_pte(child, page, true);
+            if (!child_pte) {
+                ok = false;
+                break;
+            }
+            
+            /* Shared memory stays shared: both sides write the same frame */
+            if ((*pte & PAGE_WRITE) && !(area->flags & (VMA_SHM | VMA_PINNED))) {
+                *pte = (*pte & ~PAGE_WRITE) | PAGE_COW;
+            }
+            frame_get(*pte & PAGE_FRAME_MASK);
+            *child_pte = *pte;
+            child->resident++;
+        }
+    }
+    
+    /* Our pages just lost write access (even if the copy failed part way) */
+    if (read_cr3() == (uint32_t)parent->directory) {
+        load_cr3((uint32_t)parent->directory);
+    }
+    
+    if (!ok) {
+        mm_destroy(child);
+        return NULL;
+    }
+    return child;
+}
+
+/* ========== Page Faults ========== */
+
+/* A program touched memory it may not, or memory ran out: it exits */
+static void vmm_kill(process_t* proc, const char* reason, uint32_t addr, registers_t* regs) {
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    vga_printf("\n  %s (PID %d): %s at 0x%x, EIP 0x%x\n",
+               proc->name, proc->pid, reason, addr, regs->eip);
+    vga_set_color(vga_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    process_exit(-1);
+}
+
+/* Page fault at addr: fill or copy the page if it is in one of our areas */
+bool vmm_handle_fault(registers_t* regs, uint32_t addr) {
+    process_t* proc = process_current();
+    if (!proc || !proc->mm || addr < USER_BASE || addr >= USER_TOP) return false;
+    mm_t* mm = proc->mm;
+    
+    bool write = (regs->err_code & PF_WRITE) != 0;
+    vm_area_t* area = mm_find_area(mm, addr);
+    if (!area || (write && !(area->flags & VMA_WRITE))) {
+        if (uaccess_fixup(regs)) return true;
+        vmm_kill(proc, "segmentation fault", addr, regs);
+    }
+    
+    /* Reading the executable may sleep; take interrupts if the faulter did */
+    if (regs->eflags & EFLAGS_IF) {
+        __asm__ volatile("sti");
+    }
+    
+    uint32_t page = addr & PAGE_FRAME_MASK;
+    uint32_t* pte = mm_pte(mm, page, false);
+    int result = 0;
+    if (!pte || !(*pte & PAGE_PRESENT)) {
+        result = fill_page(mm, area, page);
+    } else if (write && (*pte & PAGE_COW)) {
+        result = cow_break(mm, pte, page);
+    }
+    
+    __asm__ volatile("cli");
+    if (result < 0 && !uaccess_fixup(regs)) {
+        vmm_kill(proc, result == -ENOMEM ? "out of memory" : "page-in failed", addr, regs);
+    }
+    return true;
+}
@@ -0,0 +1,207 @@
+/*
+ * NightOS - Kernel Work Queue Implementation
+ * 
+ * Each queue is drained by a kernel thread that sleeps on the queue's
+ * wait queue while it is empty. queue_work only links the item in and
+ * wakes the worker, so it is cheap enough for IRQ handlers. Delayed
+ * work waits on a list sorted by expiry that the timer tick checks
+ * from the front. One IRQ-safe lock covers every queue and the
+ * delayed list.
+ */
+
+#include "../include/workqueue.h"
+#include "../include/timer.h"
+#include "../include/string.h"
+#include "../include/io.h"
+#include "../include/sync.h"
+
+/* Queue table */
+static workqueue_t queues[WORKQUEUE_MAX];
+static workqueue_t* system_wq = NULL;
+
+/* Delayed work, earliest expiry first */
+static work_t* delayed_list = NULL;
+
+static spinlock_t wq_lock;
+
+/* Append work to a queue and wake its worker (wq_lock held) */
+static void wq_insert(workqueue_t* wq, work_t* work) {
+    work->wq = wq;
+    work->next = NULL;
+    work->state = WORK_QUEUED;
+    
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    
+    wake_up(&wq->more_work);
+}
+
+/* Worker thread: run items in order, sleep while there are none */
+static int worker_thread(void* arg) {
+    workqueue_t* wq = (workqueue_t*)arg;
+    
+    while (1) {
+        wait_event(wq->more_work, wq->head != NULL);
+        
+        uint32_t flags = spin_lock_irqsave(&wq_lock);
+        
+        /* Cancelled between the wake-up and here */
+        work_t* work = wq->head;
+        if (!work) {
+            spin_unlock_irqrestore(&wq_lock, flags);
+            continue;
+        }
+        
+        wq->head = work->next;
+        if (!wq->head) wq->tail = NULL;
+        work->next = NULL;
+        work->state = WORK_IDLE;
+        
+        spin_unlock_irqrestore(&wq_lock, flags);
+        
+        work->func(work);
+        wq->executed++;
+    }
+    
+    return 0;
+}
+
+/* Initialize work queues and start the system "events" queue */
+void workqueue_init(void) {
+    memset(queues, 0, sizeof(queues));
+    delayed_list = NULL;
+    spin_lock_init(&wq_lock, "workqueue");
+    
+    system_wq = workqueue_create("events", PROC_PRIORITY_NORMAL);
+}
+
+/* Create a queue with its own worker thread at the given priority */
+workqueue_t* workqueue_create(const char* name, proc_priority_t priority) {
+    uint32_t flags = spin_lock_irqsave(&wq_lock);
+    
+    workqueue_t* wq = NULL;
+    for (int i = 0; i < WORKQUEUE_MAX; i++) {
+        if (!queues[i].in_use) {
+            wq = &queues[i];
+            break;
+        }
+    }
+    if (!wq) {
+        spin_unlock_irqrestore(&wq_lock, flags);
+        return NULL;
+    }
+    
+    memset(wq, 0, sizeof(workqueue_t));
+    strncpy(wq->name, name, WORKQUEUE_NAME_LEN - 1);
+    
+    char thread_name[PROCESS_NAME_LEN] = "kworker/";
+    strncpy(thread_name + 8, name, PROCESS_NAME_LEN - 9);
+    
+    /* The worker can't take a job before worker_pid is set: we hold wq_lock */
+    int pid = kthread_create(thread_name, worker_thread, wq, priority);
+    if (pid < 0) {
+        spin_unlock_irqrestore(&wq_lock, flags);
+        return NULL;
+    }
+    wq->worker_pid = (uint32_t)pid;
+    wq->in_use = true;
+    
+    spin_unlock_irqrestore(&wq_lock, flags);
+    
+    /* Nobody waits for a worker; one that is killed is freed at once */
+    process_detach((uint32_t)pid);
+    return wq;
+}
+
+/* Shared queue for short, non-urgent work */
+workqueue_t* system_workqueue(void) {
+    return system_wq;
+}
+
+/* Queue work; false if it is already pending */
+bool queue_work(workqueue_t* wq, work_t* work) {
+    if (!wq || !work) return false;
+    
+    uint32_t flags = spin_lock_irqsave(&wq_lock);
+    if (work->state != WORK_IDLE) {
+        spin_unlock_irqrestore(&wq_lock, flags);
+        return false;
+    }
+    
+    wq_insert(wq, work);
+    spin_unlock_irqrestore(&wq_lock, flags);
+    return true;
+}
+
+/* Queue work once delay_ms has passed; false if it is already pending */
+bool queue_delayed_work(workqueue_t* wq, work_t* work, uint32_t delay_ms) {
+    if (!wq || !work) return false;
+    
+    uint32_t ticks = (delay_ms * TIMER_FREQUENCY + 999) / 1000;
+    if (ticks == 0) return queue_work(wq, work);
+    
+    uint32_t flags = spin_lock_irqsave(&wq_lock);
+    if (work->state != WORK_IDLE) {
+        spin_unlock_irqrestore(&wq_lock, flags);
+        return false;
+    }
+    
+    work->wq = wq;
+    work->expires = timer_get_ticks() + ticks;
+    work->state = WORK_DELAYED;
+    
+    work_t** link = &delayed_list;
+    while (*link && (int32_t)((*link)->expires - work->expires) <= 0) {
+        link = &(*link)->next;
+    }
+    work->next = *link;
+    *link = work;
+    
+    spin_unlock_irqrestore(&wq_lock, flags);
+    return true;
+}
+
+/* Take pending work off its queue or timer; true if it was pending */
+bool cancel_work(work_t* work) {
+    uint32_t flags = spin_lock_irqsave(&wq_lock);
+    bool was_pending = work->state != WORK_IDLE;
+    
+    if (work->state == WORK_DELAYED) {
+        for (work_t** link = &delayed_list; *link; link = &(*link)->next) {
+            if (*link == work) {
+                *link = work->next;
+                break;
+            }
+        }
+    } else if (work->state == WORK_QUEUED) {
+        workqueue_t* wq = work->wq;
+        work_t* prev = NULL;
+        for (work_t* w = wq->head; w; prev = w, w = w->next) {
+            if (w == work) {
+                if (prev) prev->next = w->next; else wq->head = w->next;
+                if (wq->tail == w) wq->tail = prev;
+                break;
+            }
+        }
+    }
+    
+    work->next = NULL;
+    work->state = WORK_IDLE;
+    spin_unlock_irqrestore(&wq_lock, flags);
+    return was_pending;
+}
+
+/* Move expired delayed work onto its queue (timer interrupt) */
+void workqueue_tick(uint32_t now) {
+    spin_lock(&wq_lock);
+    while (delayed_list && (int32_t)(now - delayed_list->expires) >= 0) {
+        work_t* work = delayed_list;
+        delayed_list = work->next;
+        wq_insert(work->wq, work);
+    }
+    spin_unlock(&wq_lock);
+}
@@ -1,17 +1,21 @@
 /*
  * NightOS - Memory Management Implementation
  * 
- * Simple heap allocator for kernel memory
+ * Simple heap allocator for kernel memory. One IRQ-safe lock covers
+ * the block list and statistics, since every CPU and IRQ handler
+ * allocates from the same heap.
  */
 
 #include "../include/memory.h"
 #include "../include/string.h"
+#include "../include/sync.h"
 
 /* Heap state */
 static uint8_t* heap_start = (uint8_t*)HEAP_START;
 static uint8_t* heap_end = (uint8_t*)HEAP_END;
 static heap_block_t* free_list = NULL;
 static bool heap_initialized = false;
+static spinlock_t heap_lock;
 
 /* Memory statistics */
 static memory_stats_t mem_stats = {0};
@@ -31,6 +35,7 @@ void memory_init(void) {
     mem_stats.allocations = 0;
     mem_stats.frees = 0;
     
+    spin_lock_init(&heap_lock, "heap");
     heap_initialized = true;
 }
 
@@ -74,10 +79,13 @@ void* kmalloc(size_t size) {
     /* Align size to 8 bytes */
     size = ALIGN_UP(size, 8);
     
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    
     /* Find suitable block */
     heap_block_t* block = find_best_fit(size);
     
     if (!block) {
+        spin_unlock_irqrestore(&heap_lock, flags);
         return NULL;  /* Out of memory */
     }
     
@@ -92,6 +100,8 @@ void* kmalloc(size_t size) {
     mem_stats.free_memory -= block->size + sizeof(heap_block_t);
     mem_stats.allocations++;
     
+    spin_unlock_irqrestore(&heap_lock, flags);
+    
     /* Return pointer to usable memory (after header) */
     return (void*)((uint8_t*)block + sizeof(heap_block_t));
 }
@@ -167,6 +177,8 @@ void kfree(void* ptr) {
     /* Get block header */
     heap_block_t* block = (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
     
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    
     /* Mark as free */
     block->free = true;
     
@@ -177,12 +189,16 @@ void kfree(void* ptr) {
     
     /* Merge adjacent free blocks */
     coalesce();
+    
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 /* Get memory statistics */
 void memory_get_stats(memory_stats_t* stats) {
     if (stats) {
+        uint32_t flags = spin_lock_irqsave(&heap_lock);
         *stats = mem_stats;
+        spin_unlock_irqrestore(&heap_lock, flags);
     }
 }
 
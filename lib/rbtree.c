@@ -0,0 +1,264 @@
+/*
+ * NightOS - Red-Black Tree Implementation
+ * 
+ * Classic parent-pointer red-black tree with NULL leaves. Insertion
+ * and removal rebalance with at most three rotations.
+ */
+
+#include "../include/rbtree.h"
+
+/* ========== Helpers ========== */
+
+/* Point parent (or the root) at new instead of old */
+static void rb_replace_child(rb_tree_t* tree, rb_node_t* parent,
+                             rb_node_t* old, rb_node_t* new_node) {
+    if (!parent) {
+        tree->root = new_node;
+    } else if (parent->left == old) {
+        parent->left = new_node;
+    } else {
+        parent->right = new_node;
+    }
+}
+
+static void rb_rotate_left(rb_tree_t* tree, rb_node_t* x) {
+    rb_node_t* y = x->right;
+    rb_node_t* parent = x->parent;
+    
+    x->right = y->left;
+    if (y->left) y->left->parent = x;
+    
+    y->parent = parent;
+    rb_replace_child(tree, parent, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+static void rb_rotate_right(rb_tree_t* tree, rb_node_t* x) {
+    rb_node_t* y = x->left;
+    rb_node_t* parent = x->parent;
+    
+    x->left = y->right;
+    if (y->right) y->right->parent = x;
+    
+    y->parent = parent;
+    rb_replace_child(tree, parent, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+static inline bool rb_is_red(const rb_node_t* node) {
+    return node && node->red;
+}
+
+/* ========== Insertion ========== */
+
+void rb_init(rb_tree_t* tree) {
+    tree->root = NULL;
+    tree->leftmost = NULL;
+}
+
+/* Link a node in order and restore the red-black properties */
+void rb_insert(rb_tree_t* tree, rb_node_t* node, rb_less_t less) {
+    rb_node_t** link = &tree->root;
+    rb_node_t* parent = NULL;
+    bool leftmost = true;
+    
+    while (*link) {
+        parent = *link;
+        if (less(node, parent)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+    
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->red = true;
+    *link = node;
+    if (leftmost) tree->leftmost = node;
+    
+    /* A red node with a red parent: recolor up, or rotate once or twice */
+    rb_node_t* p;
+    while ((p = node->parent) && p->red) {
+        rb_node_t* g = p->parent;           /* Exists: the root is black */
+        
+        if (p == g->left) {
+            rb_node_t* uncle = g->right;
+            if (rb_is_red(uncle)) {
+                p->red = false;
+                uncle->red = false;
+                g->red = true;
+                node = g;
+                continue;
+            }
+            if (node == p->right) {
+                rb_rotate_left(tree, p);
+                node = p;
+                p = node->parent;
+            }
+            p->red = false;
+            g->red = true;
+            rb_rotate_right(tree, g);
+        } else {
+            rb_node_t* uncle = g->left;
+            if (rb_is_red(uncle)) {
+                p->red = false;
+                uncle->red = false;
+                g->red = true;
+                node = g;
+                continue;
+            }
+            if (node == p->left) {
+                rb_rotate_right(tree, p);
+                node = p;
+                p = node->parent;
+            }
+            p->red = false;
+            g->red = true;
+            rb_rotate_left(tree, g);
+        }
+    }
+    tree->root->red = false;
+}
+
+/* ========== Removal ========== */
+
+/* x (possibly NULL) under parent is one black short; push the deficit up */
+static void rb_erase_fixup(rb_tree_t* tree, rb_node_t* x, rb_node_t* parent) {
+    while (x != tree->root && !rb_is_red(x)) {
+        if (x == parent->left) {
+            rb_node_t* w = parent->right;
+            if (w->red) {
+                w->red = false;
+                parent->red = true;
+                rb_rotate_left(tree, parent);
+                w = parent->right;
+            }
+            if (!rb_is_red(w->left) && !rb_is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (!rb_is_red(w->right)) {
+                    w->left->red = false;
+                    w->red = true;
+                    rb_rotate_right(tree, w);
+                    w = parent->right;
+                }
+                w->red = parent->red;
+                parent->red = false;
+                w->right->red = false;
+                rb_rotate_left(tree, parent);
+                x = tree->root;
+            }
+        } else {
+            rb_node_t* w = parent->left;
+            if (w->red) {
+                w->red = false;
+                parent->red = true;
+                rb_rotate_right(tree, parent);
+                w = parent->left;
+            }
+            if (!rb_is_red(w->left) && !rb_is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (!rb_is_red(w->left)) {
+                    w->right->red = false;
+                    w->red = true;
+                    rb_rotate_left(tree, w);
+                    w = parent->left;
+                }
+                w->red = parent->red;
+                parent->red = false;
+                w->left->red = false;
+                rb_rotate_right(tree, parent);
+                x = tree->root;
+            }
+        }
+    }
+    if (x) x->red = false;
+}
+
+/* Unlink a node and restore the red-black properties */
+void rb_erase(rb_tree_t* tree, rb_node_t* node) {
+    if (tree->leftmost == node) {
+        tree->leftmost = rb_next(node);
+    }
+    
+    rb_node_t* child;
+    rb_node_t* parent;
+    bool removed_red;
+    
+    if (node->left && node->right) {
+        /* Two children: the in-order successor takes node's place */
+        rb_node_t* succ = node->right;
+        while (succ->left) {
+            succ = succ->left;
+        }
+        
+        child = succ->right;
+        removed_red = succ->red;
+        
+        if (succ->parent == node) {
+            parent = succ;
+        } else {
+            parent = succ->parent;
+            if (child) child->parent = parent;
+            parent->left = child;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+        
+        succ->parent = node->parent;
+        succ->left = node->left;
+        succ->red = node->red;
+        node->left->parent = succ;
+        rb_replace_child(tree, node->parent, node, succ);
+    } else {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        removed_red = node->red;
+        
+        if (child) child->parent = parent;
+        rb_replace_child(tree, parent, node, child);
+    }
+    
+    if (!removed_red) {
+        rb_erase_fixup(tree, child, parent);
+    }
+}
+
+/* ========== Traversal ========== */
+
+/* In-order successor, or NULL after the last node */
+rb_node_t* rb_next(const rb_node_t* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (rb_node_t*)node;
+    }
+    
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+/* Largest node, or NULL if the tree is empty */
+rb_node_t* rb_last(const rb_tree_t* tree) {
+    rb_node_t* node = tree->root;
+    if (!node) return NULL;
+    
+    while (node->right) {
+        node = node->right;
+    }
+    return node;
+}
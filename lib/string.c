@@ -194,3 +194,17 @@ int atoi(const char* str) {
     
     return sign * result;
 }
+
+uint64_t udiv64(uint64_t dividend, uint32_t divisor, uint32_t* remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quot_high = high / divisor;
+    uint32_t rem = high % divisor;
+    uint32_t quot_low;
+    
+    /* rem < divisor, so the low quotient fits in 32 bits and divl can't fault */
+    __asm__("divl %4" : "=a"(quot_low), "=d"(rem) : "a"(low), "d"(rem), "rm"(divisor));
+    
+    if (remainder) *remainder = rem;
+    return ((uint64_t)quot_high << 32) | quot_low;
+}
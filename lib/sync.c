@@ -0,0 +1,290 @@
+/*
+ * NightOS - Synchronization Primitives Implementation
+ * 
+ * Every spinning lock disables preemption while held so a holder is
+ * never switched out with a waiter spinning on the same CPU. Mutexes,
+ * semaphores and condition variables instead put waiters to sleep on
+ * a wait queue. Statistics are written only by the holder, so they
+ * need no locking of their own.
+ */
+
+#include "../include/sync.h"
+#include "../include/io.h"
+#include "../include/process.h"
+
+/* Registered locks, newest first */
+static lock_stats_t* lock_registry = NULL;
+static spinlock_t registry_lock;
+
+#define EFLAGS_IF 0x200
+
+/* ========== Statistics ========== */
+
+/* Name a lock and list it for `locks` */
+static void stats_register(lock_stats_t* stats, const char* name) {
+    stats->name = name;
+    
+    uint32_t flags = spin_lock_irqsave(&registry_lock);
+    stats->next = lock_registry;
+    lock_registry = stats;
+    spin_unlock_irqrestore(&registry_lock, flags);
+}
+
+/* Record an acquisition that spun `spins` times before succeeding */
+static inline void stats_acquired(lock_stats_t* stats, uint32_t spins) {
+    stats->acquisitions++;
+    if (spins) {
+        stats->contended++;
+        stats->spins += spins;
+    }
+    stats->acquired_at = rdtsc();
+}
+
+/* Record a release, keeping the longest hold */
+static inline void stats_released(lock_stats_t* stats) {
+    uint64_t held = rdtsc() - stats->acquired_at;
+    if (held > stats->max_hold_cycles) {
+        stats->max_hold_cycles = held;
+    }
+}
+
+/* First registered lock; follow ->next for the rest */
+lock_stats_t* lock_stats_first(void) {
+    return lock_registry;
+}
+
+/* Zero every registered lock's counters */
+void lock_stats_reset(void) {
+    for (lock_stats_t* s = lock_registry; s; s = s->next) {
+        s->acquisitions = 0;
+        s->contended = 0;
+        s->spins = 0;
+        s->max_hold_cycles = 0;
+    }
+}
+
+/* ========== Preemption ========== */
+
+/* Re-enable preemption; reschedules if a tick asked to meanwhile */
+void preempt_enable(void) {
+    preempt_enable_no_resched();
+    
+    uint32_t eflags;
+    __asm__ volatile("pushfl; popl %0" : "=r"(eflags));
+    if (preempt_count() == 0 && (eflags & EFLAGS_IF)) {
+        preempt_schedule();
+    }
+}
+
+/* ========== Spinlocks ========== */
+
+void spin_lock_init(spinlock_t* lock, const char* name) {
+    lock->locked = 0;
+    stats_register(&lock->stats, name);
+}
+
+void spin_lock(spinlock_t* lock) {
+    uint32_t spins = 0;
+    
+    preempt_disable();
+    while (__sync_lock_test_and_set(&lock->locked, 1)) {
+        /* Spin on a plain read so the cache line stays shared */
+        while (lock->locked) {
+            __asm__ volatile("pause");
+            spins++;
+        }
+    }
+    stats_acquired(&lock->stats, spins);
+}
+
+bool spin_trylock(spinlock_t* lock) {
+    preempt_disable();
+    if (__sync_lock_test_and_set(&lock->locked, 1)) {
+        preempt_enable();
+        return false;
+    }
+    stats_acquired(&lock->stats, 0);
+    return true;
+}
+
+void spin_unlock(spinlock_t* lock) {
+    stats_released(&lock->stats);
+    __sync_lock_release(&lock->locked);
+    preempt_enable();
+}
+
+uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    stats_released(&lock->stats);
+    __sync_lock_release(&lock->locked);
+    irq_restore(flags);
+    preempt_enable();
+}
+
+/* ========== Ticket Locks ========== */
+
+void ticket_lock_init(ticket_lock_t* lock, const char* name) {
+    lock->next = 0;
+    lock->serving = 0;
+    stats_register(&lock->stats, name);
+}
+
+void ticket_lock(ticket_lock_t* lock) {
+    uint32_t spins = 0;
+    
+    preempt_disable();
+    uint32_t ticket = __sync_fetch_and_add(&lock->next, 1);
+    while (lock->serving != ticket) {
+        __asm__ volatile("pause");
+        spins++;
+    }
+    stats_acquired(&lock->stats, spins);
+}
+
+void ticket_unlock(ticket_lock_t* lock) {
+    stats_released(&lock->stats);
+    __asm__ volatile("" : : : "memory");
+    lock->serving++;                    /* Only the holder writes it */
+    preempt_enable();
+}
+
+uint32_t ticket_lock_irqsave(ticket_lock_t* lock) {
+    uint32_t flags = irq_save();
+    ticket_lock(lock);
+    return flags;
+}
+
+void ticket_unlock_irqrestore(ticket_lock_t* lock, uint32_t flags) {
+    stats_released(&lock->stats);
+    __asm__ volatile("" : : : "memory");
+    lock->serving++;
+    irq_restore(flags);
+    preempt_enable();
+}
+
+/* ========== Sequence Locks ========== */
+
+void seqlock_init(seqlock_t* sl, const char* name) {
+    sl->sequence = 0;
+    spin_lock_init(&sl->lock, name);
+}
+
+/* Writers exclude each other and IRQs on this CPU */
+uint32_t write_seqlock(seqlock_t* sl) {
+    uint32_t flags = spin_lock_irqsave(&sl->lock);
+    sl->sequence++;
+    __asm__ volatile("" : : : "memory");
+    return flags;
+}
+
+void write_sequnlock(seqlock_t* sl, uint32_t flags) {
+    __asm__ volatile("" : : : "memory");
+    sl->sequence++;
+    spin_unlock_irqrestore(&sl->lock, flags);
+}
+
+/* ========== Mutexes ========== */
+
+void mutex_init(mutex_t* mutex, const char* name) {
+    mutex->locked = 0;
+    mutex->owner = NULL;
+    wait_queue_init(&mutex->waiters);
+    stats_register(&mutex->stats, name);
+}
+
+void mutex_lock(mutex_t* mutex) {
+    uint32_t sleeps = 0;
+    
+    while (__sync_lock_test_and_set(&mutex->locked, 1)) {
+        wait_event_exclusive(mutex->waiters, !mutex->locked);
+        sleeps++;
+    }
+    mutex->owner = process_current();
+    stats_acquired(&mutex->stats, sleeps);
+}
+
+bool mutex_trylock(mutex_t* mutex) {
+    if (__sync_lock_test_and_set(&mutex->locked, 1)) {
+        return false;
+    }
+    mutex->owner = process_current();
+    stats_acquired(&mutex->stats, 0);
+    return true;
+}
+
+void mutex_unlock(mutex_t* mutex) {
+    stats_released(&mutex->stats);
+    mutex->owner = NULL;
+    __sync_lock_release(&mutex->locked);
+    
+    /* Order the release before the waiter check; prepare_to_wait pairs with it */
+    __sync_synchronize();
+    if (wait_queue_active(&mutex->waiters)) {
+        wake_up(&mutex->waiters);
+    }
+}
+
+/* ========== Semaphores ========== */
+
+void semaphore_init(semaphore_t* sem, int32_t count) {
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+}
+
+bool semaphore_trydown(semaphore_t* sem) {
+    int32_t count;
+    while ((count = sem->count) > 0) {
+        if (__sync_bool_compare_and_swap(&sem->count, count, count - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void semaphore_down(semaphore_t* sem) {
+    while (!semaphore_trydown(sem)) {
+        wait_event_exclusive(sem->waiters, sem->count > 0);
+    }
+}
+
+void semaphore_up(semaphore_t* sem) {
+    __sync_fetch_and_add(&sem->count, 1);   /* Locked: also a full barrier */
+    if (wait_queue_active(&sem->waiters)) {
+        wake_up(&sem->waiters);
+    }
+}
+
+/* ========== Condition Variables ========== */
+
+void condvar_init(condvar_t* cv) {
+    cv->sequence = 0;
+    wait_queue_init(&cv->waiters);
+}
+
+/* A signal between the unlock and the sleep still ends the wait */
+void condvar_wait(condvar_t* cv, mutex_t* mutex) {
+    uint32_t seq = cv->sequence;
+    
+    mutex_unlock(mutex);
+    wait_event_exclusive(cv->waiters, cv->sequence != seq);
+    mutex_lock(mutex);
+}
+
+void condvar_signal(condvar_t* cv) {
+    __sync_fetch_and_add(&cv->sequence, 1);
+    if (wait_queue_active(&cv->waiters)) {
+        wake_up(&cv->waiters);
+    }
+}
+
+void condvar_broadcast(condvar_t* cv) {
+    __sync_fetch_and_add(&cv->sequence, 1);
+    if (wait_queue_active(&cv->waiters)) {
+        wake_up_all(&cv->waiters);
+    }
+}
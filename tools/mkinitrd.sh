@@ -0,0 +1,71 @@
+#!/bin/sh
+# NightOS - Initramfs Builder
+#
+# Packs a host directory into a ustar archive, appends it to the OS
+# image and patches its location into the boot sector so the
+# bootloader can load it at boot (see load_initrd in boot/boot.asm).
+#
+# Usage: tools/mkinitrd.sh <image> <directory>
+
+set -e
+
+IMAGE="$1"
+DIR="$2"
+
+# Must match boot/boot.asm
+INITRD_MAX_SECTORS=512
+INITRD_LBA_OFFSET=504
+INITRD_SECTORS_OFFSET=508
+
+if [ -z "$IMAGE" ] || [ -z "$DIR" ]; then
+    echo "Usage: $0 <image> <directory>"
+    exit 1
+fi
+
+if [ ! -d "$DIR" ]; then
+    echo "No initramfs directory '$DIR', skipping."
+    exit 0
+fi
+
+ARCHIVE="$IMAGE.initrd"
+
+# Blocking factor 1 keeps the archive sector-sized instead of 10KB records
+tar --format=ustar -b 1 -C "$DIR" -cf "$ARCHIVE" .
+
+IMAGE_SIZE=$(wc -c < "$IMAGE")
+ARCHIVE_SIZE=$(wc -c < "$ARCHIVE")
+LBA=$(( (IMAGE_SIZE + 511) / 512 ))
+SECTORS=$(( (ARCHIVE_SIZE + 511) / 512 ))
+
+if [ "$SECTORS" -gt "$INITRD_MAX_SECTORS" ]; then
+    echo "ERROR: initramfs is $SECTORS sectors (max $INITRD_MAX_SECTORS)"
+    rm -f "$ARCHIVE"
+    exit 1
+fi
+
+# Append the archive on a sector boundary
+PADDING=$((LBA * 512 - IMAGE_SIZE))
+if [ "$PADDING" -gt 0 ]; then
+    dd if=/dev/zero bs=1 count="$PADDING" >> "$IMAGE" 2>/dev/null
+fi
+cat "$ARCHIVE" >> "$IMAGE"
+rm -f "$ARCHIVE"
+
+# Write a little-endian value of N bytes at a byte offset in the image
+patch_le() {
+    value=$1
+    count=$2
+    offset=$3
+    bytes=""
+    while [ "$count" -gt 0 ]; do
+        bytes="$bytes$(printf '\\%03o' $((value & 255)))"
+        value=$((value >> 8))
+        count=$((count - 1))
+    done
+    printf "$bytes" | dd of="$IMAGE" bs=1 seek="$offset" conv=notrunc 2>/dev/null
+}
+
+patch_le "$LBA" 4 "$INITRD_LBA_OFFSET"
+patch_le "$SECTORS" 2 "$INITRD_SECTORS_OFFSET"
+
+echo "Initramfs: $SECTORS sectors at LBA $LBA"